@@ -25,8 +25,26 @@ typedef enum key_type {
     ESP_SECURE_CERT_HMAC_ENCRYPTED_KEY, /* Encrypted key type */
     ESP_SECURE_CERT_HMAC_DERIVED_ECDSA_KEY, /* HMAC-derived ECDSA key type. */
     ESP_SECURE_CERT_ECDSA_PERIPHERAL_KEY, /* ECDSA peripheral key type. */
+    ESP_SECURE_CERT_DS_PERIPHERAL_KEY, /* Key used through the DS peripheral */
 } esp_secure_cert_key_type_t;
 
+/**
+@brief The credentials needed to set up a TLS connection, obtained with esp_secure_cert_get_bundle.
+*/
+typedef struct esp_secure_cert_bundle {
+    char *device_cert; /* Device cert */
+    uint32_t device_cert_len; /* Length of the device cert */
+    char *ca_cert; /* CA cert, NULL if the partition has none */
+    uint32_t ca_cert_len; /* Length of the CA cert */
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+    char *priv_key; /* Private key, NULL for ESP_SECURE_CERT_ECDSA_PERIPHERAL_KEY */
+    uint32_t priv_key_len; /* Length of the private key */
+#else
+    esp_ds_data_ctx_t *ds_ctx; /* DS context */
+#endif
+    esp_secure_cert_key_type_t priv_key_type; /* Type of the private key */
+} esp_secure_cert_bundle_t;
+
 /* @info
  * Init the esp_secure_cert nvs partition
  *
@@ -74,6 +92,26 @@ esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len);
  */
 esp_err_t esp_secure_cert_free_device_cert(char *buffer);
 
+/* @info
+ *  Copy the device cert from the esp_secure_cert partition into a buffer provided by the caller.
+ *
+ * @note
+ *      No memory is allocated, the buffer may be a static one.
+ *      Pass a NULL buffer and a cap of 0 to only query the length.
+ *
+ * @params
+ *      - buf(out)          The buffer to be filled with the device cert
+ *      - cap(in)           Size of the buffer in bytes
+ *      - len(out)          This value shall be filled with the length of the device cert,
+ *                          also when the buffer is too small
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_SIZE  The buffer is too small
+ *      - ESP_FAIL/other relevant esp error code
+ *                              On failure
+ */
+esp_err_t esp_secure_cert_get_device_cert_into(char *buf, uint32_t cap, uint32_t *len);
+
 /* @info
  *  Get the ca cert from the esp_secure_cert partition
  *
@@ -113,6 +151,27 @@ esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len);
  */
 esp_err_t esp_secure_cert_free_ca_cert(char *buffer);
 
+/* @info
+ *  Copy the ca cert from the esp_secure_cert partition into a buffer provided by the caller.
+ *
+ * @note
+ *      No memory is allocated, the buffer may be a static one.
+ *      If the ca cert is HMAC encrypted it is decrypted directly into the buffer.
+ *      Pass a NULL buffer and a cap of 0 to only query the length.
+ *
+ * @params
+ *      - buf(out)          The buffer to be filled with the ca cert
+ *      - cap(in)           Size of the buffer in bytes
+ *      - len(out)          This value shall be filled with the length of the ca cert,
+ *                          also when the buffer is too small
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_SIZE  The buffer is too small
+ *      - ESP_FAIL/other relevant esp error code
+ *                              On failure
+ */
+esp_err_t esp_secure_cert_get_ca_cert_into(char *buf, uint32_t cap, uint32_t *len);
+
 #ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
 /* @info
  *  Get the private key from the esp_secure_cert partition
@@ -153,6 +212,28 @@ esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len);
  */
 esp_err_t esp_secure_cert_free_priv_key(char *buffer);
 
+/* @info
+ *  Copy the private key from the esp_secure_cert partition into a buffer provided by the caller.
+ *
+ * @note
+ *      No memory is allocated for the key, the buffer may be a static one.
+ *      An HMAC encrypted key is decrypted and an HMAC derived ECDSA key is generated
+ *      directly into the buffer. The caller should zeroize the buffer once the key is no longer needed.
+ *      Pass a NULL buffer and a cap of 0 to only query the length.
+ *
+ * @params
+ *      - buf(out)          The buffer to be filled with the private key
+ *      - cap(in)           Size of the buffer in bytes
+ *      - len(out)          This value shall be filled with the length of the private key,
+ *                          also when the buffer is too small
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_SIZE  The buffer is too small
+ *      - ESP_FAIL/other relevant esp error code
+ *                              On failure
+ */
+esp_err_t esp_secure_cert_get_priv_key_into(char *buf, uint32_t cap, uint32_t *len);
+
 #else /* !CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
 /* @info
  *       This function returns the flash esp_ds_context which can then be
@@ -174,6 +255,43 @@ esp_ds_data_ctx_t *esp_secure_cert_get_ds_ctx(void);
 void esp_secure_cert_free_ds_ctx(esp_ds_data_ctx_t *ds_ctx);
 #endif /* CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
 
+/* @info
+ *  Get the device cert, the CA cert, the private key (or the DS context) and the private key type
+ *  from the esp_secure_cert partition in a single call.
+ *
+ * @note
+ *      The partition is located once for all of the credentials.
+ *      The CA cert is optional, ca_cert is set to NULL if the partition has none.
+ *      The memory is allocated as with the individual APIs,
+ *      the bundle must be freed with esp_secure_cert_free_bundle.
+ *
+ * @params
+ *      - bundle(out)       This value shall be filled with the credentials on successful completion
+ * @return
+ *      - ESP_OK    On success
+ *      - ESP_FAIL/other relevant esp error code
+ *                  On failure, nothing needs to be freed
+ */
+esp_err_t esp_secure_cert_get_bundle(esp_secure_cert_bundle_t *bundle);
+
+/*
+ * Free any internally allocated resources for the credentials of the bundle.
+ *
+ * @params
+ *      - bundle(in)        The bundle obtained through "esp_secure_cert_get_bundle" API.
+ *                          All of its fields are cleared.
+ */
+void esp_secure_cert_free_bundle(esp_secure_cert_bundle_t *bundle);
+
+#ifdef CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE
+/* @info
+ *  Zeroize and free the cached decrypted data, e.g. before the device goes to sleep.
+ *  Data still in use is zeroized and freed as soon as it is freed with the respective free API.
+ *  The next read decrypts the data again.
+ */
+void esp_secure_cert_clear_decrypted_cache(void);
+#endif
+
 #ifndef CONFIG_ESP_SECURE_CERT_SUPPORT_LEGACY_FORMATS
 
 /* @info
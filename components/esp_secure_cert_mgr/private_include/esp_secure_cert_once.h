@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Once-initialization of the data the component keeps till reboot
+ * (the partition mapping, the tlv index, the partition format, ...).
+ *
+ * Once initialized, the data is read with a single acquire load and no lock.
+ * The first caller claims the initialization with a compare-and-swap,
+ * callers racing it yield until it is complete.
+ */
+typedef uint8_t esp_secure_cert_once_t;
+
+#define ESP_SECURE_CERT_ONCE_PENDING    0   /* Not initialized yet, or the last attempt failed */
+#define ESP_SECURE_CERT_ONCE_RUNNING    1   /* A task is running the initialization */
+#define ESP_SECURE_CERT_ONCE_DONE       2   /* The data is initialized */
+
+/*
+ * @return
+ *      - true      The caller has to run the initialization and then call esp_secure_cert_once_end()
+ *      - false     The data is initialized
+ */
+static inline bool esp_secure_cert_once_begin(esp_secure_cert_once_t *once)
+{
+    esp_secure_cert_once_t state = __atomic_load_n(once, __ATOMIC_ACQUIRE);
+    while (state != ESP_SECURE_CERT_ONCE_DONE) {
+        if (state == ESP_SECURE_CERT_ONCE_PENDING) {
+            if (__atomic_compare_exchange_n(once, &state, ESP_SECURE_CERT_ONCE_RUNNING, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                return true;
+            }
+            continue;
+        }
+        /* Let the task running the initialization complete it */
+        vTaskDelay(1);
+        state = __atomic_load_n(once, __ATOMIC_ACQUIRE);
+    }
+    return false;
+}
+
+/*
+ * Publish the data initialized after esp_secure_cert_once_begin() returned true.
+ *
+ * @params
+ *      - done(in)  false if the initialization failed, the next caller tries again
+ */
+static inline void esp_secure_cert_once_end(esp_secure_cert_once_t *once, bool done)
+{
+    __atomic_store_n(once, done ? ESP_SECURE_CERT_ONCE_DONE : ESP_SECURE_CERT_ONCE_PENDING, __ATOMIC_RELEASE);
+}
@@ -37,6 +37,7 @@ typedef enum esp_secure_cert_tlv_type {
     ESP_SECURE_CERT_DS_CONTEXT_TLV,
     ESP_SECURE_CERT_HMAC_ECDSA_KEY_SALT,
     ESP_SECURE_CERT_TLV_SEC_CFG,
+    ESP_SECURE_CERT_TLV_DIRECTORY = 49,     /* Directory of the tlvs in the partition, see esp_secure_cert_tlv_dir_header_t */
     // Any new tlv types should be added above this
     ESP_SECURE_CERT_TLV_END = 50,
     //Custom data types
@@ -114,6 +115,38 @@ _Static_assert(sizeof(esp_secure_cert_tlv_footer_t) == 4, "TLV footer size shoul
  *
  */
 
+/*
+ * Directory of the tlvs in the partition
+ *
+ * The directory is optional. When present, it is the first tlv of the partition and
+ * its value is a esp_secure_cert_tlv_dir_header_t followed by one esp_secure_cert_tlv_dir_entry_t
+ * for each tlv stored after it, in the same order.
+ * It allows to seek to a tlv directly and to verify its crc only when it is first read.
+ * Readers which do not know the directory skip it as any other tlv, so the partition
+ * can still be read by them.
+ */
+#define ESP_SECURE_CERT_TLV_DIR_VERSION         1
+
+typedef struct esp_secure_cert_tlv_dir_header {
+    uint8_t version;                    /* Version of the directory format, ESP_SECURE_CERT_TLV_DIR_VERSION */
+    uint8_t entry_count;                /* Number of entries following the header */
+    uint8_t reserved[2];                /* Reserved bytes for future use, the value currently should be 0x0 */
+} __attribute__((packed)) esp_secure_cert_tlv_dir_header_t;
+
+typedef struct esp_secure_cert_tlv_dir_entry {
+    uint16_t type;                      /* Type of the tlv */
+    uint8_t flags;                      /* Flags of the tlv */
+    uint8_t reserved;                   /* Reserved byte for future use, the value currently should be 0x0 */
+    uint32_t offset;                    /* Offset of the tlv header from the start of the partition */
+    uint16_t length;                    /* Length of the data of the tlv */
+    uint8_t reserved2[2];               /* Reserved bytes for future use, the value currently should be 0x0 */
+    uint32_t crc;                       /* crc stored in the footer of the tlv */
+} __attribute__((packed)) esp_secure_cert_tlv_dir_entry_t;
+
+_Static_assert(sizeof(esp_secure_cert_tlv_dir_header_t) == 4, "TLV directory header size should be 4 bytes");
+
+_Static_assert(sizeof(esp_secure_cert_tlv_dir_entry_t) == 16, "TLV directory entry size should be 16 bytes");
+
 typedef struct esp_secure_cert_tlv_sec_cfg {
     uint8_t priv_key_efuse_id; /* eFuse key id in which the private key is stored */
     uint8_t reserved[39];       /* Reserving 39 bytes for future use */
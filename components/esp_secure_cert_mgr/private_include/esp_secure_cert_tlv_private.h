@@ -6,6 +6,7 @@
 #pragma once
 #include "esp_secure_cert_config.h"
 #include "esp_secure_cert_tlv_config.h"
+#include "esp_secure_cert_read.h"
 
 #ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
 #include "rsa_sign_alt.h"
@@ -19,6 +20,9 @@
  * @note
  * The mapping is done only once and function shall
  * simply return same address in case of successive calls.
+ * The first call also builds the index of the tlvs in the partition
+ * and verifies their crc. For a partition with a tlv directory the index
+ * is read from the directory and the crc of a tlv is verified on first lookup.
  **/
 const void *esp_secure_cert_get_mapped_addr(void);
 
@@ -26,6 +30,8 @@ const void *esp_secure_cert_get_mapped_addr(void);
  * Find the offset of tlv structure of given type in the esp_secure_cert partition
  *
  * Note: This API also validates the crc of the respective tlv before returning the offset
+ * For the address returned by esp_secure_cert_get_mapped_addr() the tlv is looked up
+ * in the index, without walking the partition or computing the crc again.
  * @input
  * esp_secure_cert_addr     Memory mapped address of the esp_secure_cert partition
  * type                     Type of the tlv structure.
@@ -53,6 +59,35 @@ esp_err_t esp_secure_cert_find_tlv(const void *esp_secure_cert_addr, esp_secure_
  */
 esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, char **buffer, uint32_t *len);
 
+/*
+ *  Write the data of a TLV into a buffer provided by the caller.
+ *  Encrypted data is decrypted and the HMAC derived ECDSA key is generated
+ *  straight into the buffer, without allocating memory for it.
+ *
+ * @params
+ *      - buf(out)      The buffer, may be NULL if cap is 0
+ *      - cap(in)       Size of the buffer in bytes
+ *      - len(out)      Length of the data, also set when the buffer is too small
+ * @return
+ *      - ESP_OK                On success
+ *      - ESP_ERR_INVALID_SIZE  The buffer is smaller than len
+ *      - ESP_FAIL/other relevant esp error code
+ *                              On failure
+ */
+esp_err_t esp_secure_cert_tlv_get_into(esp_secure_cert_tlv_type_t type, char *buf, uint32_t cap, uint32_t *len);
+
+/*
+ * Release a buffer returned by esp_secure_cert_tlv_get_addr() that is held
+ * in the cache of decrypted data. Once the buffer is no longer in use and its
+ * lifetime is over, the data is zeroized and freed.
+ * The retained HMAC derived ECDSA key is kept till reboot.
+ * @return
+ *       - true if the buffer belongs to the cache or is the retained key,
+ *         it must not be freed by the caller
+ *       - false otherwise
+ */
+bool esp_secure_cert_tlv_release(const char *buffer);
+
 /*
  * Identify if esp_secure_cert partition of type TLV is present.
  * @return
@@ -61,6 +96,13 @@ esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, char **b
  */
 bool esp_secure_cert_is_tlv_partition(void);
 
+/*
+ * Get the credentials of the bundle from the esp_secure_cert partition of type TLV.
+ * The partition is mapped once and the private key header is read once for both the key and its type.
+ * On failure the credentials read so far are freed.
+ */
+esp_err_t esp_secure_cert_tlv_get_bundle(esp_secure_cert_bundle_t *bundle);
+
 #ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
 /* @info
  *       This function returns the flash esp_ds_context which can then be
@@ -16,6 +16,7 @@
 #include "esp_secure_cert_tlv_config.h"
 #include "esp_secure_cert_tlv_private.h"
 #include "esp_heap_caps.h"
+#include "esp_secure_cert_once.h"
 
 #if __has_include("esp_idf_version.h")
 #include "esp_idf_version.h"
@@ -60,6 +61,7 @@ static const esp_partition_t *esp_secure_cert_find_partition(esp_partition_type_
     if (it != NULL) {
         current_partition_format = format;
         const esp_partition_t *part = esp_partition_get(it);
+        esp_partition_iterator_release(it);
         if (part == NULL) {
             ESP_LOGE(TAG, "Failed to get partition");
             return NULL;
@@ -71,12 +73,13 @@ static const esp_partition_t *esp_secure_cert_find_partition(esp_partition_type_
     return NULL;
 }
 
-static const esp_partition_t *esp_secure_cert_get_partition(void)
+/*
+ * Probe the supported partition formats in the order of preference.
+ * Sets the global variable current_partition_format.
+ */
+static const esp_partition_t *esp_secure_cert_detect_partition(void)
 {
-    static const esp_partition_t *part;
-    if (part != NULL) {
-        return part;
-    }
+    const esp_partition_t *part;
 
     // This switch case statement is added for increasing readability
     // The actual behaviour is a simple fall through
@@ -179,55 +182,225 @@ static const esp_partition_t *esp_secure_cert_get_partition(void)
     return NULL;
 }
 
-static void esp_secure_cert_get_partition_format(void)
+/*
+ * Get the esp_secure_cert partition, detecting it and its format on the first call.
+ *
+ * @note
+ * The detection is done only once, also when it fails, and the result is kept till reboot.
+ * Callers racing the first call wait for the detection to complete,
+ * later calls only read the cached result, without taking a lock.
+ */
+static const esp_partition_t *esp_secure_cert_get_partition(void)
 {
-    if (current_partition_format != ESP_SECURE_CERT_PF_INVALID) {
-        return;
+    static const esp_partition_t *part;
+    static esp_secure_cert_once_t detect_once;
+
+    if (!esp_secure_cert_once_begin(&detect_once)) {
+        return part;
     }
 
-    const esp_partition_t *part = esp_secure_cert_get_partition();
+    part = esp_secure_cert_detect_partition();
     if (part == NULL) {
         ESP_LOGE(TAG, "Failed to obtain the current partition and partition format");
         current_partition_format = ESP_SECURE_CERT_PF_INVALID;
     }
-    return;
+    esp_secure_cert_once_end(&detect_once, true);
+    return part;
 }
 
-static int nvs_get(const char *name_space, const char *key, char *value, size_t *len, size_t type)
+static void esp_secure_cert_get_partition_format(void)
 {
-    esp_err_t err;
-    nvs_handle_t handle;
+    (void) esp_secure_cert_get_partition();
+}
 
-    err = nvs_open_from_partition(nvs_partition_name, name_space, NVS_READONLY, &handle);
+/*
+ * Handle of the esp_secure_cert NVS namespace, opened on first use
+ * and kept open till reboot.
+ */
+static esp_err_t esp_secure_cert_nvs_get_handle(nvs_handle_t *handle)
+{
+    static nvs_handle_t nvs_handle;
+    static esp_secure_cert_once_t nvs_handle_once;
+    if (!esp_secure_cert_once_begin(&nvs_handle_once)) {
+        *handle = nvs_handle;
+        return ESP_OK;
+    }
+
+    esp_err_t err = nvs_open_from_partition(nvs_partition_name, nvs_namespace_name, NVS_READONLY, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Could not open NVS handle (0x%x)!", err);
+        esp_secure_cert_once_end(&nvs_handle_once, false);
         return err;
     }
+    esp_secure_cert_once_end(&nvs_handle_once, true);
+    *handle = nvs_handle;
+    return ESP_OK;
+}
+
+static esp_err_t nvs_read(nvs_handle_t handle, const char *key, char *value, size_t *len, size_t type)
+{
+    esp_err_t err;
+    uint8_t u8_value;
+    uint16_t u16_value;
 
     switch (type) {
     case NVS_STR:
-        err = nvs_get_str(handle, key, value, len);
-        break;
+        return nvs_get_str(handle, key, value, len);
     case NVS_BLOB:
-        err = nvs_get_blob(handle, key, value, len);
-        break;
+        return nvs_get_blob(handle, key, value, len);
     case NVS_U8:
-        err = nvs_get_u8(handle, key, (uint8_t *)value);
-        break;
+        err = nvs_get_u8(handle, key, &u8_value);
+        if (err == ESP_OK && value != NULL) {
+            memcpy(value, &u8_value, sizeof(u8_value));
+        }
+        *len = sizeof(u8_value);
+        return err;
     case NVS_U16:
-        err = nvs_get_u16(handle, key, (uint16_t *)value);
-        break;
+        err = nvs_get_u16(handle, key, &u16_value);
+        if (err == ESP_OK && value != NULL) {
+            memcpy(value, &u16_value, sizeof(u16_value));
+        }
+        *len = sizeof(u16_value);
+        return err;
     default:
         ESP_LOGE(TAG, "Invalid type of NVS data provided");
-        err = ESP_ERR_INVALID_ARG;
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+/* Keys prefetched into the NVS data cache */
+static const struct {
+    const char *key;
+    size_t type;
+} nvs_cache_keys[] = {
+    { ESP_SECURE_CERT_DEV_CERT, NVS_STR },
+    { ESP_SECURE_CERT_CA_CERT, NVS_STR },
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+    { ESP_SECURE_CERT_PRIV_KEY, NVS_STR },
+#else
+    { ESP_SECURE_CERT_CIPHERTEXT, NVS_BLOB },
+    { ESP_SECURE_CERT_IV, NVS_BLOB },
+    { ESP_SECURE_CERT_EFUSE_KEY_ID, NVS_U8 },
+    { ESP_SECURE_CERT_RSA_LEN, NVS_U16 },
+#endif
+};
+
+#define NVS_CACHE_KEY_COUNT     (sizeof(nvs_cache_keys) / sizeof(nvs_cache_keys[0]))
+
+typedef struct {
+    esp_err_t err;          /* Result of reading the key, ESP_OK if it is cached */
+    uint32_t offset;        /* Offset of the value in the cache data */
+    uint32_t len;           /* Length of the value, as nvs_get_str/nvs_get_blob report it */
+} nvs_cache_entry_t;
+
+/*
+ * The values of all the keys read in one pass and kept
+ * in a single allocation till reboot.
+ */
+static struct {
+    esp_secure_cert_once_t once;
+    char *data;
+    nvs_cache_entry_t entries[NVS_CACHE_KEY_COUNT];
+} nvs_cache;
+
+static void esp_secure_cert_nvs_cache_init(nvs_handle_t handle)
+{
+    size_t total_len = 0;
+    size_t len;
+
+    /* Tried only once, without the cache every access reads NVS */
+    if (!esp_secure_cert_once_begin(&nvs_cache.once)) {
+        return;
     }
 
+    /* Size every key first so that the values share one allocation */
+    for (size_t i = 0; i < NVS_CACHE_KEY_COUNT; i++) {
+        len = 0;
+        nvs_cache.entries[i].err = nvs_read(handle, nvs_cache_keys[i].key, NULL, &len, nvs_cache_keys[i].type);
+        if (nvs_cache.entries[i].err != ESP_OK) {
+            /* e.g. the CA cert is optional, the error is reported when it is read */
+            continue;
+        }
+        nvs_cache.entries[i].offset = total_len;
+        nvs_cache.entries[i].len = len;
+        /* Keep the integer values aligned */
+        total_len += (len + 3) & ~3;
+    }
+
+    nvs_cache.data = (char *)calloc(1, total_len ? total_len : 1);
+    if (nvs_cache.data == NULL) {
+        ESP_LOGW(TAG, "Not enough memory to cache the NVS data, reading it on every access");
+        esp_secure_cert_once_end(&nvs_cache.once, true);
+        return;
+    }
+
+    for (size_t i = 0; i < NVS_CACHE_KEY_COUNT; i++) {
+        if (nvs_cache.entries[i].err != ESP_OK) {
+            continue;
+        }
+        len = nvs_cache.entries[i].len;
+        nvs_cache.entries[i].err = nvs_read(handle, nvs_cache_keys[i].key, nvs_cache.data + nvs_cache.entries[i].offset, &len, nvs_cache_keys[i].type);
+    }
+    esp_secure_cert_once_end(&nvs_cache.once, true);
+}
+
+static const nvs_cache_entry_t *esp_secure_cert_nvs_cache_find(const char *key)
+{
+    if (nvs_cache.data == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < NVS_CACHE_KEY_COUNT; i++) {
+        if (strcmp(nvs_cache_keys[i].key, key) == 0) {
+            return &nvs_cache.entries[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Read a key of the esp_secure_cert namespace, with the semantics of nvs_get_str/nvs_get_blob:
+ * with value set to NULL only the required length is returned.
+ * Values are served from the NVS data cache, which is filled on the first call.
+ */
+static int nvs_get(const char *key, char *value, size_t *len, size_t type)
+{
+    esp_err_t err;
+    nvs_handle_t handle;
+    size_t int_len;
+
+    if (len == NULL) {
+        /* Integer reads do not pass a length */
+        len = &int_len;
+        int_len = (type == NVS_U16) ? sizeof(uint16_t) : sizeof(uint8_t);
+    }
+
+    err = esp_secure_cert_nvs_get_handle(&handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error (0x%02X) reading NVS data!", err);
         return err;
     }
 
-    nvs_close(handle);
+    esp_secure_cert_nvs_cache_init(handle);
+
+    const nvs_cache_entry_t *entry = esp_secure_cert_nvs_cache_find(key);
+    if (entry != NULL) {
+        err = entry->err;
+        if (err == ESP_OK && value != NULL) {
+            if (*len < entry->len) {
+                err = ESP_ERR_NVS_INVALID_LENGTH;
+            } else {
+                memcpy(value, nvs_cache.data + entry->offset, entry->len);
+            }
+        }
+        if (err == ESP_OK || err == ESP_ERR_NVS_INVALID_LENGTH) {
+            *len = entry->len;
+        }
+    } else {
+        err = nvs_read(handle, key, value, len, type);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (0x%02X) reading NVS data!", err);
+    }
     return err;
 }
 
@@ -246,53 +419,92 @@ esp_err_t esp_secure_cert_init_nvs_partition(void)
     }
 }
 
-static esp_err_t esp_secure_cert_read_raw_flash(const esp_partition_t *partition, uint32_t src_offset, void *dst, uint32_t size)
+/*
+ * Map the entire cust_flash partition and return the virtual address.
+ *
+ * @note
+ * The mapping is done only once and kept till reboot, all data
+ * is served from it instead of mapping a region per read.
+ */
+static const char *esp_secure_cert_get_cust_flash_addr(const esp_partition_t *partition)
 {
+    static const void *cust_flash_mapped_addr;
+    static esp_secure_cert_once_t cust_flash_mapped_once;
+    if (!esp_secure_cert_once_begin(&cust_flash_mapped_once)) {
+        return cust_flash_mapped_addr;
+    }
+
     /* Encrypted partitions need to be read via a cache mapping */
     const void *buf;
     spi_flash_mmap_handle_t handle;
     esp_err_t err;
 
-    err = esp_partition_mmap(partition, src_offset, size, SPI_FLASH_MMAP_DATA, &buf, &handle);
+    /* The mapping is never released, so the handle is not kept */
+    err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &buf, &handle);
     if (err != ESP_OK) {
-        return err;
+        ESP_LOGE(TAG, "Could not map the partition, returned %04X", err);
+        esp_secure_cert_once_end(&cust_flash_mapped_once, false);
+        return NULL;
     }
-    memcpy(dst, buf, size);
-    spi_flash_munmap(handle);
-    return ESP_OK;
+    cust_flash_mapped_addr = buf;
+    esp_secure_cert_once_end(&cust_flash_mapped_once, true);
+    return cust_flash_mapped_addr;
 }
 
 const void *esp_secure_cert_mmap(const esp_partition_t *partition, uint32_t src_offset, uint32_t size)
 {
-    /* Encrypted partitions need to be read via a cache mapping */
-    const void *buf;
-    spi_flash_mmap_handle_t handle;
-    esp_err_t err;
-
-    err = esp_partition_mmap(partition, src_offset, size, SPI_FLASH_MMAP_DATA, &buf, &handle);
-    if (err != ESP_OK) {
+    const char *mapped_addr = esp_secure_cert_get_cust_flash_addr(partition);
+    if (mapped_addr == NULL) {
+        return NULL;
+    }
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        ESP_LOGE(TAG, "Data at offset %"PRIu32" of length %"PRIu32" exceeds the partition", src_offset, size);
         return NULL;
     }
-    return buf;
+    return mapped_addr + src_offset;
 }
 
-static esp_err_t esp_secure_cert_read_metadata(esp_secure_cert_metadata *metadata, size_t offset, const esp_partition_t *part, uint32_t *data_len, uint32_t *data_crc)
+/*
+ * Read the metadata of the cust_flash partition once
+ * and keep it till reboot.
+ */
+static const esp_secure_cert_metadata *esp_secure_cert_get_metadata(const esp_partition_t *part)
 {
-    esp_err_t err;
-    err = esp_secure_cert_read_raw_flash(part, ESP_SECURE_CERT_METADATA_OFFSET, metadata, sizeof(esp_secure_cert_metadata));
-    if (err != ESP_OK) {
+    static esp_secure_cert_metadata metadata;
+    static esp_secure_cert_once_t metadata_once;
+    if (!esp_secure_cert_once_begin(&metadata_once)) {
+        return &metadata;
+    }
+
+    const void *buf = esp_secure_cert_mmap(part, ESP_SECURE_CERT_METADATA_OFFSET, sizeof(esp_secure_cert_metadata));
+    if (buf == NULL) {
         ESP_LOGE(TAG, "Could not read metadata.");
-        return ESP_FAIL;
+        esp_secure_cert_once_end(&metadata_once, false);
+        return NULL;
     }
+    memcpy(&metadata, buf, sizeof(esp_secure_cert_metadata));
 
-    if (metadata->magic_word != ESP_SECURE_CERT_METADATA_MAGIC_WORD) {
+    if (metadata.magic_word != ESP_SECURE_CERT_METADATA_MAGIC_WORD) {
         ESP_LOGE(TAG, "Metadata magic word does not match");
+        esp_secure_cert_once_end(&metadata_once, false);
+        return NULL;
+    }
+    esp_secure_cert_once_end(&metadata_once, true);
+    return &metadata;
+}
+
+static esp_err_t esp_secure_cert_read_metadata(const esp_secure_cert_metadata **metadata_out, size_t offset, const esp_partition_t *part, uint32_t *data_len, uint32_t *data_crc)
+{
+    esp_err_t err = ESP_OK;
+    const esp_secure_cert_metadata *metadata = esp_secure_cert_get_metadata(part);
+    if (metadata == NULL) {
         return ESP_FAIL;
     }
+    *metadata_out = metadata;
 
     switch (offset) {
     case ESP_SECURE_CERT_METADATA_OFFSET:
-        *data_len = sizeof(metadata);
+        *data_len = sizeof(*metadata);
         break;
     case ESP_SECURE_CERT_DEV_CERT_OFFSET:
         if (current_partition_format == ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY) {
@@ -342,7 +554,7 @@ static esp_err_t esp_secure_cert_read_metadata(esp_secure_cert_metadata *metadat
 static esp_err_t esp_secure_cert_get_addr(size_t offset, char **buffer, uint32_t *len)
 {
     esp_err_t err;
-    static esp_secure_cert_metadata metadata;
+    const esp_secure_cert_metadata *metadata;
     uint32_t data_len = 0;
     uint32_t data_crc = 0;
 
@@ -360,7 +572,7 @@ static esp_err_t esp_secure_cert_get_addr(size_t offset, char **buffer, uint32_t
 
     *len = data_len;
     *buffer = (char *)esp_secure_cert_mmap(part, offset, *len);
-    if (buffer == NULL) {
+    if (*buffer == NULL) {
         return ESP_FAIL;
     }
 
@@ -372,6 +584,58 @@ static esp_err_t esp_secure_cert_get_addr(size_t offset, char **buffer, uint32_t
     return ESP_OK;
 }
 
+/*
+ * Copy the data of a credential into the buffer of the caller, whatever the partition format
+ */
+static esp_err_t esp_secure_cert_get_into(esp_secure_cert_tlv_type_t type, size_t offset, const char *nvs_key, char *buf, uint32_t cap, uint32_t *len)
+{
+    esp_err_t ret;
+    char *addr;
+    size_t nvs_len;
+
+    if (len == NULL || (buf == NULL && cap != 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // This API sets the global variable current_partition_format
+    esp_secure_cert_get_partition_format();
+    switch (current_partition_format) {
+    case ESP_SECURE_CERT_PF_TLV:
+        return esp_secure_cert_tlv_get_into(type, buf, cap, len);
+
+    case ESP_SECURE_CERT_PF_CUST_FLASH:
+    case ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY:
+        ret = esp_secure_cert_get_addr(offset, &addr, len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (cap < *len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(buf, addr, *len);
+        return ESP_OK;
+
+    case ESP_SECURE_CERT_PF_NVS:
+        ret = nvs_get(nvs_key, NULL, &nvs_len, NVS_STR);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        *len = nvs_len;
+        if (cap < nvs_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        nvs_len = cap;
+        ret = nvs_get(nvs_key, buf, &nvs_len, NVS_STR);
+        *len = nvs_len;
+        return ret;
+
+    case ESP_SECURE_CERT_PF_INVALID:
+    default:
+        ESP_LOGE(TAG, "Invalid flash format");
+        return ESP_FAIL;
+    }
+}
+
 esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len)
 {
     // This API sets the global variable current_partition_format
@@ -386,7 +650,7 @@ esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len)
         return esp_secure_cert_get_addr(ESP_SECURE_CERT_DEV_CERT_OFFSET, buffer, len);;
 
     case ESP_SECURE_CERT_PF_NVS:
-        ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_DEV_CERT, NULL, (size_t *)len, NVS_STR);
+        ret = nvs_get(ESP_SECURE_CERT_DEV_CERT, NULL, (size_t *)len, NVS_STR);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to get device cert length from nvs");
             return ret;
@@ -398,7 +662,7 @@ esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len)
             return ESP_ERR_NO_MEM;
         }
 
-        return nvs_get(nvs_namespace_name, ESP_SECURE_CERT_DEV_CERT, *buffer, (size_t *)len, NVS_STR);
+        return nvs_get(ESP_SECURE_CERT_DEV_CERT, *buffer, (size_t *)len, NVS_STR);
 
     case ESP_SECURE_CERT_PF_INVALID:
     default:
@@ -411,8 +675,13 @@ esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len)
 esp_err_t esp_secure_cert_free_device_cert(char *buffer)
 {
     switch(current_partition_format) {
-    // fall through
     case ESP_SECURE_CERT_PF_TLV:
+        /* Hand a cached decrypted cert back to the cache */
+        esp_secure_cert_tlv_release(buffer);
+        return ESP_OK;
+        break;
+
+    // fall through
     case ESP_SECURE_CERT_PF_CUST_FLASH:
     case ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY:
         return ESP_OK;
@@ -428,6 +697,11 @@ esp_err_t esp_secure_cert_free_device_cert(char *buffer)
     }
 }
 
+esp_err_t esp_secure_cert_get_device_cert_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_get_into(ESP_SECURE_CERT_DEV_CERT_TLV, ESP_SECURE_CERT_DEV_CERT_OFFSET, ESP_SECURE_CERT_DEV_CERT, buf, cap, len);
+}
+
 esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len)
 {
     // This API sets the global variable current_partition_format
@@ -440,10 +714,10 @@ esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len)
 
     case ESP_SECURE_CERT_PF_CUST_FLASH:
     case ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY:
-        return esp_secure_cert_get_addr(ESP_SECURE_CERT_DEV_CERT_OFFSET, buffer, len);;
+        return esp_secure_cert_get_addr(ESP_SECURE_CERT_CA_CERT_OFFSET, buffer, len);
 
     case ESP_SECURE_CERT_PF_NVS:
-        ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_CA_CERT, NULL, (size_t *)len, NVS_STR);
+        ret = nvs_get(ESP_SECURE_CERT_CA_CERT, NULL, (size_t *)len, NVS_STR);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to get ca cert length from nvs");
             return ret;
@@ -454,7 +728,7 @@ esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len)
             ESP_LOGE(TAG, "Not enough memory for ca cert buffer");
             return ESP_ERR_NO_MEM;
         }
-        return nvs_get(nvs_namespace_name, ESP_SECURE_CERT_CA_CERT, *buffer, (size_t *)len, NVS_STR);
+        return nvs_get(ESP_SECURE_CERT_CA_CERT, *buffer, (size_t *)len, NVS_STR);
 
     case ESP_SECURE_CERT_PF_INVALID:
     default:
@@ -467,8 +741,13 @@ esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len)
 esp_err_t esp_secure_cert_free_ca_cert(char *buffer)
 {
     switch(current_partition_format) {
-    // fall through
     case ESP_SECURE_CERT_PF_TLV:
+        /* Hand a cached decrypted cert back to the cache */
+        esp_secure_cert_tlv_release(buffer);
+        return ESP_OK;
+        break;
+
+    // fall through
     case ESP_SECURE_CERT_PF_CUST_FLASH:
     case ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY:
         return ESP_OK;
@@ -484,6 +763,11 @@ esp_err_t esp_secure_cert_free_ca_cert(char *buffer)
     }
 }
 
+esp_err_t esp_secure_cert_get_ca_cert_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_get_into(ESP_SECURE_CERT_CA_CERT_TLV, ESP_SECURE_CERT_CA_CERT_OFFSET, ESP_SECURE_CERT_CA_CERT, buf, cap, len);
+}
+
 #ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
 esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
 {
@@ -500,7 +784,7 @@ esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
         return esp_secure_cert_get_addr(ESP_SECURE_CERT_PRIV_KEY_OFFSET, buffer, len);;
 
     case ESP_SECURE_CERT_PF_NVS:
-        ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_PRIV_KEY, NULL, (size_t *)len, NVS_STR);
+        ret = nvs_get(ESP_SECURE_CERT_PRIV_KEY, NULL, (size_t *)len, NVS_STR);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to get priv key length from nvs");
             return ret;
@@ -512,7 +796,7 @@ esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
             return ESP_ERR_NO_MEM;
         }
 
-        return nvs_get(nvs_namespace_name, ESP_SECURE_CERT_PRIV_KEY, *buffer, (size_t *)len, NVS_STR);
+        return nvs_get(ESP_SECURE_CERT_PRIV_KEY, *buffer, (size_t *)len, NVS_STR);
 
     case ESP_SECURE_CERT_PF_INVALID:
     default:
@@ -525,8 +809,13 @@ esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
 esp_err_t esp_secure_cert_free_priv_key(char *buffer)
 {
     switch(current_partition_format) {
-    // fall through
     case ESP_SECURE_CERT_PF_TLV:
+        /* Hand a cached decrypted key back to the cache */
+        esp_secure_cert_tlv_release(buffer);
+        return ESP_OK;
+        break;
+
+    // fall through
     case ESP_SECURE_CERT_PF_CUST_FLASH:
     case ESP_SECURE_CERT_PF_CUST_FLASH_LEGACY:
         return ESP_OK;
@@ -541,13 +830,18 @@ esp_err_t esp_secure_cert_free_priv_key(char *buffer)
         return ESP_FAIL;
     }
 }
+
+esp_err_t esp_secure_cert_get_priv_key_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_get_into(ESP_SECURE_CERT_PRIV_KEY_TLV, ESP_SECURE_CERT_PRIV_KEY_OFFSET, ESP_SECURE_CERT_PRIV_KEY, buf, cap, len);
+}
 #endif
 
 #ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
 static esp_err_t esp_secure_cert_read(size_t offset, unsigned char *buffer, uint32_t *len)
 {
     esp_err_t err;
-    static esp_secure_cert_metadata metadata;
+    const esp_secure_cert_metadata *metadata;
     uint32_t data_len = 0;
     uint32_t data_crc = 0;
 
@@ -575,15 +869,16 @@ static esp_err_t esp_secure_cert_read(size_t offset, unsigned char *buffer, uint
 
     /* If the requested offset belongs to the medatada, return the already read metadata */
     if (offset == ESP_SECURE_CERT_METADATA_OFFSET) {
-        memcpy(buffer, &metadata, sizeof(metadata));
+        memcpy(buffer, metadata, sizeof(*metadata));
         return ESP_OK;
     }
 
-    err = esp_secure_cert_read_raw_flash(part, offset, buffer, data_len);
-    if (err != ESP_OK) {
+    const void *data = esp_secure_cert_mmap(part, offset, data_len);
+    if (data == NULL) {
         ESP_LOGE(TAG, "Could not read data.");
         return ESP_FAIL;
     }
+    memcpy(buffer, data, data_len);
 
     uint32_t read_crc = esp_crc32_le(UINT32_MAX, (const uint8_t * )buffer, data_len);
     if (read_crc != data_crc) {
@@ -649,26 +944,26 @@ esp_ds_data_ctx_t *esp_secure_cert_get_ds_ctx(void)
 
     } else if (current_partition_format == ESP_SECURE_CERT_PF_NVS) {
         len = ESP_DS_C_LEN;
-        esp_ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_CIPHERTEXT, (char *) ds_data_ctx->esp_ds_data->c, (size_t *) &len, NVS_BLOB);
+        esp_ret = nvs_get(ESP_SECURE_CERT_CIPHERTEXT, (char *) ds_data_ctx->esp_ds_data->c, (size_t *) &len, NVS_BLOB);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "Error in reading ciphertext");
             goto exit;
         }
 
         len = ESP_DS_IV_LEN;
-        esp_ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_IV, (char *)ds_data_ctx->esp_ds_data->iv, (size_t *)&len, NVS_BLOB);
+        esp_ret = nvs_get(ESP_SECURE_CERT_IV, (char *)ds_data_ctx->esp_ds_data->iv, (size_t *)&len, NVS_BLOB);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "Error in reading initialization vector");
             goto exit;
         }
 
-        esp_ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_EFUSE_KEY_ID, (void *)&ds_data_ctx->efuse_key_id, 0, NVS_U8);
+        esp_ret = nvs_get(ESP_SECURE_CERT_EFUSE_KEY_ID, (void *)&ds_data_ctx->efuse_key_id, 0, NVS_U8);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "Error in reading efuse key id");
             goto exit;
         }
 
-        esp_ret = nvs_get(nvs_namespace_name, ESP_SECURE_CERT_RSA_LEN, (void *)&ds_data_ctx->rsa_length_bits, 0, NVS_U16);
+        esp_ret = nvs_get(ESP_SECURE_CERT_RSA_LEN, (void *)&ds_data_ctx->rsa_length_bits, 0, NVS_U16);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "Error in reading rsa key length");
             goto exit;
@@ -688,7 +983,9 @@ void esp_secure_cert_free_ds_ctx(esp_ds_data_ctx_t *ds_ctx)
 {
     esp_secure_cert_get_partition_format();
     if (current_partition_format == ESP_SECURE_CERT_PF_TLV) {
+        /* The DS data of the TLV format is read from flash */
         esp_secure_cert_tlv_free_ds_ctx(ds_ctx);
+        return;
     }
 
     if (ds_ctx != NULL) {
@@ -697,3 +994,56 @@ void esp_secure_cert_free_ds_ctx(esp_ds_data_ctx_t *ds_ctx)
     free(ds_ctx);
 }
 #endif
+
+esp_err_t esp_secure_cert_get_bundle(esp_secure_cert_bundle_t *bundle)
+{
+    esp_err_t err;
+
+    if (bundle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // This API sets the global variable current_partition_format
+    esp_secure_cert_get_partition_format();
+    if (current_partition_format == ESP_SECURE_CERT_PF_TLV) {
+        return esp_secure_cert_tlv_get_bundle(bundle);
+    }
+
+    memset(bundle, 0, sizeof(esp_secure_cert_bundle_t));
+    bundle->priv_key_type = ESP_SECURE_CERT_INVALID_KEY;
+    if (current_partition_format == ESP_SECURE_CERT_PF_INVALID) {
+        ESP_LOGE(TAG, "Invalid flash format");
+        return ESP_FAIL;
+    }
+
+    err = esp_secure_cert_get_device_cert(&bundle->device_cert, &bundle->device_cert_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading the device cert, returned %04X", err);
+        return err;
+    }
+
+    /* The CA cert is optional */
+    if (esp_secure_cert_get_ca_cert(&bundle->ca_cert, &bundle->ca_cert_len) != ESP_OK) {
+        bundle->ca_cert = NULL;
+        bundle->ca_cert_len = 0;
+    }
+
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+    err = esp_secure_cert_get_priv_key(&bundle->priv_key, &bundle->priv_key_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading the priv key, returned %04X", err);
+        esp_secure_cert_free_bundle(bundle);
+        return err;
+    }
+    /* The legacy formats only hold plain keys */
+    bundle->priv_key_type = ESP_SECURE_CERT_DEFAULT_FORMAT_KEY;
+#else
+    bundle->ds_ctx = esp_secure_cert_get_ds_ctx();
+    if (bundle->ds_ctx == NULL) {
+        esp_secure_cert_free_bundle(bundle);
+        return ESP_FAIL;
+    }
+    bundle->priv_key_type = ESP_SECURE_CERT_DS_PERIPHERAL_KEY;
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,1344 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+
+#if __has_include("esp_idf_version.h")
+#include "esp_idf_version.h"
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#include "esp_random.h"
+#else
+#include "esp_system.h"
+#endif
+
+#include "esp_rom_sys.h"
+#include "esp_efuse.h"
+#include "esp_efuse_table.h"
+#include "soc/soc_caps.h"
+#include "esp_fault.h"
+#include "esp_heap_caps.h"
+
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/version.h"
+
+#include "esp_secure_cert_read.h"
+#include "esp_secure_cert_tlv_config.h"
+#include "esp_secure_cert_tlv_private.h"
+#include "esp_secure_cert_crypto.h"
+#include "esp_secure_cert_once.h"
+
+#if SOC_HMAC_SUPPORTED
+#include "esp_hmac.h"
+#include "mbedtls/platform_util.h"
+#endif
+
+#if defined(CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE) || defined(CONFIG_ESP_SECURE_CERT_RETAIN_DERIVED_ECDSA_KEY)
+#include "freertos/FreeRTOS.h"
+#include "mbedtls/platform_util.h"
+#endif
+
+#ifdef CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE
+#include "esp_timer.h"
+#endif
+
+#if (MBEDTLS_VERSION_NUMBER < 0x03000000)
+/* mbedtls 2.x backward compatibility */
+#define MBEDTLS_2X_COMPAT 1
+/**
+ * Mbedtls-3.0 forward compatibility
+ */
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+#endif /* (MBEDTLS_VERSION_NUMBER < 0x03000000) */
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "spi_flash_mmap.h"
+#include "esp_memory_utils.h"
+#include "entropy_poll.h"
+#else
+#include "mbedtls/entropy_poll.h"
+#include "soc/soc_memory_layout.h"
+#endif
+
+#endif
+
+static const char *TAG = "esp_secure_cert_tlv";
+
+#define MIN_ALIGNMENT_REQUIRED 16
+
+/* Number of TLV types covered by the TLV index, types above are looked up by walking the partition */
+#define ESP_SECURE_CERT_TLV_INDEX_SIZE  (ESP_SECURE_CERT_USER_DATA_5 + 1)
+
+typedef enum esp_secure_cert_tlv_index_state {
+    ESP_SECURE_CERT_TLV_INDEX_ABSENT = 0,   /* No TLV of this type in the partition */
+    ESP_SECURE_CERT_TLV_INDEX_UNVERIFIED,   /* Listed in the TLV directory, the crc is verified on first use */
+    ESP_SECURE_CERT_TLV_INDEX_VALID,        /* The crc of the TLV was verified */
+    ESP_SECURE_CERT_TLV_INDEX_CRC_MISMATCH, /* The crc of the TLV does not match */
+} esp_secure_cert_tlv_index_state_t;
+
+/*
+ * Location of a TLV in the mapped esp_secure_cert partition
+ */
+typedef struct esp_secure_cert_tlv_index_entry {
+    uint32_t offset;                    /* Offset of the tlv header from the start of the partition */
+    uint16_t length;                    /* Length of the data */
+    uint8_t flags;                      /* Flags of the tlv */
+    uint8_t state;                      /* esp_secure_cert_tlv_index_state_t */
+} esp_secure_cert_tlv_index_entry_t;
+
+/*
+ * Directory of the TLVs in the esp_secure_cert partition, built once
+ * together with the mapping of the partition. The partition is read-only
+ * for the application, so the directory stays valid till reboot.
+ * Only the state of the entries verified on first lookup changes afterwards,
+ * it is updated atomically.
+ */
+typedef struct esp_secure_cert_tlv_index {
+    esp_secure_cert_tlv_index_entry_t entries[ESP_SECURE_CERT_TLV_INDEX_SIZE];
+    uint32_t end_offset;                /* Offset right after the last tlv */
+} esp_secure_cert_tlv_index_t;
+
+static esp_secure_cert_tlv_index_t s_tlv_index;
+
+
+#if SOC_HMAC_SUPPORTED
+static esp_err_t esp_secure_cert_hmac_based_decryption(char *in_buf, uint32_t len, char *output_buf);
+static esp_err_t esp_secure_cert_gen_ecdsa_key(char *output_buf, size_t buf_len);
+#define ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE  121
+#endif
+
+#if SOC_HMAC_SUPPORTED && defined(CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE)
+#define ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED 1
+/* Number of decrypted tlvs that can be cached at a time */
+#define ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS   4
+#define ESP_SECURE_CERT_DECRYPTED_CACHE_LIFETIME_US  ((int64_t)CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE_LIFETIME_S * 1000000)
+
+/*
+ * Decrypted data of a tlv, kept in internal RAM to skip
+ * the key derivation and decryption on later reads.
+ */
+typedef struct esp_secure_cert_decrypted_entry {
+    char *buffer;                       /* Decrypted data, NULL if the slot is free */
+    uint32_t len;                       /* Length of the decrypted data */
+    uint16_t type;                      /* Type of the tlv */
+    uint16_t users;                     /* Number of times the buffer was handed out and not freed yet */
+    int64_t expiry_us;                  /* esp_timer time after which the data is wiped once unused */
+} esp_secure_cert_decrypted_entry_t;
+
+static esp_secure_cert_decrypted_entry_t s_decrypted_cache[ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS];
+static portMUX_TYPE s_decrypted_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_decrypted_cache_timer;
+
+static bool esp_secure_cert_decrypted_cache_get(esp_secure_cert_tlv_type_t type, char **buffer, uint32_t *len);
+static char *esp_secure_cert_decrypted_cache_put(esp_secure_cert_tlv_type_t type, char *buffer, uint32_t len);
+static void esp_secure_cert_decrypted_cache_sweep(bool wipe_all);
+#endif
+
+#if SOC_HMAC_SUPPORTED && defined(CONFIG_ESP_SECURE_CERT_RETAIN_DERIVED_ECDSA_KEY)
+#define ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED 1
+/*
+ * The HMAC derived ECDSA key in DER format, kept till reboot
+ * as deriving it takes hundreds of milliseconds.
+ */
+static char s_derived_ecdsa_key[ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE];
+static bool s_derived_ecdsa_key_ready;
+static portMUX_TYPE s_derived_ecdsa_key_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+/* This is the mininum required flash address alignment in bytes to write to an encrypted flash partition */
+
+/*
+ * Size of a tlv including its header, padding and footer
+ */
+static size_t esp_secure_cert_tlv_total_len(const esp_secure_cert_tlv_header_t *tlv_header)
+{
+    uint8_t padding_length = MIN_ALIGNMENT_REQUIRED - (tlv_header->length % MIN_ALIGNMENT_REQUIRED);
+    padding_length = (padding_length == MIN_ALIGNMENT_REQUIRED) ? 0 : padding_length;
+    return sizeof(esp_secure_cert_tlv_header_t) + tlv_header->length + padding_length + sizeof(esp_secure_cert_tlv_footer_t);
+}
+
+/*
+ * Verify the crc stored in the footer of a tlv
+ */
+static bool esp_secure_cert_tlv_crc_is_valid(const esp_secure_cert_tlv_header_t *tlv_header)
+{
+    // crc_data_len = header_len + data_len + padding
+    size_t crc_data_len = esp_secure_cert_tlv_total_len(tlv_header) - sizeof(esp_secure_cert_tlv_footer_t);
+    uint32_t data_crc = esp_crc32_le(UINT32_MAX, (const uint8_t * )tlv_header, crc_data_len);
+    const esp_secure_cert_tlv_footer_t *tlv_footer = (const esp_secure_cert_tlv_footer_t *)((const uint8_t *)tlv_header + crc_data_len);
+    if (tlv_footer->crc != data_crc) {
+        ESP_LOGE(TAG, "Calculated crc = %04X does not match with crc"
+                 "read from esp_secure_cert partition = %04X", (unsigned int)data_crc, (unsigned int)tlv_footer->crc);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Fill the index from the tlv directory at the start of the partition, if there is one.
+ * Only the headers and footers of the listed tlvs are checked against the directory,
+ * the crc of their data is verified when they are first looked up.
+ * @return
+ *       - true if the index was filled from the directory
+ *       - false if there is no usable directory, the index is left empty
+ */
+static bool esp_secure_cert_load_tlv_directory(const void *esp_secure_cert_addr, size_t partition_size)
+{
+    const esp_secure_cert_tlv_header_t *dir_tlv = (const esp_secure_cert_tlv_header_t *)esp_secure_cert_addr;
+    if (partition_size < sizeof(esp_secure_cert_tlv_header_t) ||
+            dir_tlv->magic != ESP_SECURE_CERT_TLV_MAGIC || dir_tlv->type != ESP_SECURE_CERT_TLV_DIRECTORY) {
+        return false;
+    }
+
+    size_t dir_tlv_len = esp_secure_cert_tlv_total_len(dir_tlv);
+    const esp_secure_cert_tlv_dir_header_t *dir = (const esp_secure_cert_tlv_dir_header_t *)dir_tlv->value;
+    if (dir_tlv_len > partition_size || dir_tlv->length < sizeof(esp_secure_cert_tlv_dir_header_t) ||
+            !esp_secure_cert_tlv_crc_is_valid(dir_tlv)) {
+        ESP_LOGE(TAG, "tlv directory is corrupted, walking the partition instead");
+        return false;
+    }
+    if (dir->version != ESP_SECURE_CERT_TLV_DIR_VERSION ||
+            dir_tlv->length < sizeof(esp_secure_cert_tlv_dir_header_t) + dir->entry_count * sizeof(esp_secure_cert_tlv_dir_entry_t)) {
+        ESP_LOGW(TAG, "tlv directory version %d is not supported, walking the partition instead", dir->version);
+        return false;
+    }
+
+    const esp_secure_cert_tlv_dir_entry_t *dir_entries = (const esp_secure_cert_tlv_dir_entry_t *)(dir_tlv->value + sizeof(esp_secure_cert_tlv_dir_header_t));
+    s_tlv_index.entries[ESP_SECURE_CERT_TLV_DIRECTORY].length = dir_tlv->length;
+    s_tlv_index.entries[ESP_SECURE_CERT_TLV_DIRECTORY].flags = dir_tlv->flags;
+    s_tlv_index.entries[ESP_SECURE_CERT_TLV_DIRECTORY].state = ESP_SECURE_CERT_TLV_INDEX_VALID;
+    s_tlv_index.end_offset = dir_tlv_len;
+
+    for (int i = 0; i < dir->entry_count; i++) {
+        const esp_secure_cert_tlv_dir_entry_t *dir_entry = &dir_entries[i];
+        const esp_secure_cert_tlv_header_t *tlv_header = (const esp_secure_cert_tlv_header_t *)((const uint8_t *)esp_secure_cert_addr + dir_entry->offset);
+        size_t tlv_len = 0;
+        bool matches = dir_entry->offset >= dir_tlv_len &&
+                       dir_entry->offset <= partition_size - sizeof(esp_secure_cert_tlv_header_t) &&
+                       tlv_header->magic == ESP_SECURE_CERT_TLV_MAGIC &&
+                       tlv_header->type == dir_entry->type &&
+                       tlv_header->length == dir_entry->length &&
+                       tlv_header->flags == dir_entry->flags;
+        if (matches) {
+            tlv_len = esp_secure_cert_tlv_total_len(tlv_header);
+            matches = tlv_len <= partition_size - dir_entry->offset;
+        }
+        if (matches) {
+            const esp_secure_cert_tlv_footer_t *tlv_footer = (const esp_secure_cert_tlv_footer_t *)((const uint8_t *)tlv_header + tlv_len - sizeof(esp_secure_cert_tlv_footer_t));
+            matches = tlv_footer->crc == dir_entry->crc;
+        }
+        if (!matches) {
+            ESP_LOGE(TAG, "tlv directory entry %d does not match the partition, walking the partition instead", i);
+            memset(&s_tlv_index, 0, sizeof(s_tlv_index));
+            return false;
+        }
+
+        if (dir_entry->offset + tlv_len > s_tlv_index.end_offset) {
+            s_tlv_index.end_offset = dir_entry->offset + tlv_len;
+        }
+        if (dir_entry->type < ESP_SECURE_CERT_TLV_INDEX_SIZE &&
+                s_tlv_index.entries[dir_entry->type].state == ESP_SECURE_CERT_TLV_INDEX_ABSENT) {
+            esp_secure_cert_tlv_index_entry_t *entry = &s_tlv_index.entries[dir_entry->type];
+            entry->offset = dir_entry->offset;
+            entry->length = dir_entry->length;
+            entry->flags = dir_entry->flags;
+            entry->state = ESP_SECURE_CERT_TLV_INDEX_UNVERIFIED;
+        }
+    }
+    ESP_LOGD(TAG, "tlv index loaded from the directory, tlv data ends at offset %u", (unsigned int)s_tlv_index.end_offset);
+    return true;
+}
+
+/*
+ * Record where each type is found in the mapped partition.
+ * The index is loaded from the tlv directory if the partition has one. Otherwise
+ * the partition is walked once and the crc of every tlv is verified.
+ * Only the first tlv of a type is recorded, as the linear search would find it.
+ */
+static void esp_secure_cert_build_tlv_index(const void *esp_secure_cert_addr, size_t partition_size)
+{
+    uint32_t tlv_offset = 0;
+    memset(&s_tlv_index, 0, sizeof(s_tlv_index));
+    if (esp_secure_cert_load_tlv_directory(esp_secure_cert_addr, partition_size)) {
+        return;
+    }
+    while (tlv_offset + sizeof(esp_secure_cert_tlv_header_t) <= partition_size) {
+        const esp_secure_cert_tlv_header_t *tlv_header = (const esp_secure_cert_tlv_header_t *)((const uint8_t *)esp_secure_cert_addr + tlv_offset);
+        if (tlv_header->magic != ESP_SECURE_CERT_TLV_MAGIC) {
+            break;
+        }
+        size_t tlv_len = esp_secure_cert_tlv_total_len(tlv_header);
+        if (tlv_offset + tlv_len > partition_size) {
+            ESP_LOGE(TAG, "tlv of type %d at offset %u exceeds the partition", tlv_header->type, (unsigned int)tlv_offset);
+            break;
+        }
+        if (tlv_header->type < ESP_SECURE_CERT_TLV_INDEX_SIZE &&
+                s_tlv_index.entries[tlv_header->type].state == ESP_SECURE_CERT_TLV_INDEX_ABSENT) {
+            esp_secure_cert_tlv_index_entry_t *entry = &s_tlv_index.entries[tlv_header->type];
+            entry->offset = tlv_offset;
+            entry->length = tlv_header->length;
+            entry->flags = tlv_header->flags;
+            entry->state = esp_secure_cert_tlv_crc_is_valid(tlv_header) ?
+                           ESP_SECURE_CERT_TLV_INDEX_VALID : ESP_SECURE_CERT_TLV_INDEX_CRC_MISMATCH;
+        }
+        tlv_offset += tlv_len;
+    }
+    s_tlv_index.end_offset = tlv_offset;
+    ESP_LOGD(TAG, "tlv index built, tlv data ends at offset %u", (unsigned int)tlv_offset);
+}
+
+/*
+ * Map the entire esp_secure_cert partition
+ * and return the virtual address.
+ *
+ * @note
+ * The mapping is done only once and function shall
+ * simply return same address in case of successive calls.
+ * Tasks racing the first call wait for the mapping, later calls take no lock.
+ **/
+const void *esp_secure_cert_get_mapped_addr(void)
+{
+    // Once initialized, these variable shall contain valid data till reboot.
+    static const void *esp_secure_cert_mapped_addr;
+    static esp_secure_cert_once_t mapped_once;
+    if (!esp_secure_cert_once_begin(&mapped_once)) {
+        return esp_secure_cert_mapped_addr;
+    }
+
+    esp_partition_iterator_t it = esp_partition_find(ESP_SECURE_CERT_TLV_PARTITION_TYPE,
+                                  ESP_PARTITION_SUBTYPE_ANY, ESP_SECURE_CERT_TLV_PARTITION_NAME);
+    if (it == NULL) {
+        ESP_LOGE(TAG, "Partition not found.");
+        esp_secure_cert_once_end(&mapped_once, false);
+        return NULL;
+    }
+
+    const esp_partition_t *partition = esp_partition_get(it);
+    esp_partition_iterator_release(it);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "Could not get partition.");
+        esp_secure_cert_once_end(&mapped_once, false);
+        return NULL;
+    }
+
+    /* Encrypted partitions need to be read via a cache mapping */
+    spi_flash_mmap_handle_t handle;
+    esp_err_t err;
+
+    /* Map the entire partition */
+    const void *mapped_addr = NULL;
+    err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped_addr, &handle);
+    if (err != ESP_OK) {
+        esp_secure_cert_once_end(&mapped_once, false);
+        return NULL;
+    }
+    /* Publish the address only once the index is ready, lookups on it rely on the index */
+    esp_secure_cert_build_tlv_index(mapped_addr, partition->size);
+    esp_secure_cert_mapped_addr = mapped_addr;
+    esp_secure_cert_once_end(&mapped_once, true);
+    return esp_secure_cert_mapped_addr;
+}
+
+/*
+ * Find the tlv by walking the partition from its start
+ */
+static esp_err_t esp_secure_cert_find_tlv_linear(const void *esp_secure_cert_addr, esp_secure_cert_tlv_type_t type, void **tlv_address)
+{
+    /* start from the begining of the partition */
+    uint32_t tlv_offset = 0;
+    while (1) {
+        esp_secure_cert_tlv_header_t *tlv_header = (esp_secure_cert_tlv_header_t *)(esp_secure_cert_addr + tlv_offset);
+        ESP_LOGD(TAG, "Reading from offset of %u from base of esp_secure_cert", (unsigned int)tlv_offset);
+        if (tlv_header->magic != ESP_SECURE_CERT_TLV_MAGIC) {
+            if (type == ESP_SECURE_CERT_TLV_END) {
+                /* The invalid magic means last tlv read successfully was the last tlv structure present,
+                 * so send the end address of the tlv.
+                 * This address can be used to add a new tlv structure. */
+                *tlv_address = (void *) tlv_header;
+                return ESP_OK;
+            }
+            ESP_LOGD(TAG, "Unable to find tlv of type: %d", type);
+            ESP_LOGD(TAG, "Expected magic byte is %04X, obtained magic byte = %04X", ESP_SECURE_CERT_TLV_MAGIC, (unsigned int) tlv_header->magic);
+            return ESP_FAIL;
+        }
+        if (((esp_secure_cert_tlv_type_t)tlv_header->type) == type) {
+            *tlv_address = (void *) tlv_header;
+            if (!esp_secure_cert_tlv_crc_is_valid(tlv_header)) {
+                return ESP_FAIL;
+            }
+            ESP_LOGD(TAG, "tlv structure of type %d found and verified", type);
+            return ESP_OK;
+        } else {
+            tlv_offset = tlv_offset + esp_secure_cert_tlv_total_len(tlv_header);
+        }
+    }
+}
+
+/*
+ * Find the offset of tlv structure of given type in the esp_secure_cert partition
+ *
+ * Note: This API also validates the crc of the respective tlv before returning the offset
+ * The tlvs of the mapped esp_secure_cert partition are looked up in the index built
+ * when it was mapped, their crc was verified then, or on first lookup for partitions
+ * with a tlv directory. Other addresses are searched linearly.
+ * @input
+ * esp_secure_cert_addr     Memory mapped address of the esp_secure_cert partition
+ * type                     Type of the tlv structure.
+ *                          for calculating current crc for esp_secure_cert
+ *
+ * tlv_address              Void pointer to store tlv address
+ *
+ */
+esp_err_t esp_secure_cert_find_tlv(const void *esp_secure_cert_addr, esp_secure_cert_tlv_type_t type, void **tlv_address)
+{
+    if (esp_secure_cert_addr == NULL || esp_secure_cert_addr != esp_secure_cert_get_mapped_addr()) {
+        return esp_secure_cert_find_tlv_linear(esp_secure_cert_addr, type, tlv_address);
+    }
+
+    if (type == ESP_SECURE_CERT_TLV_END) {
+        *tlv_address = (void *)((const uint8_t *)esp_secure_cert_addr + s_tlv_index.end_offset);
+        return ESP_OK;
+    }
+
+    if ((unsigned int)type >= ESP_SECURE_CERT_TLV_INDEX_SIZE) {
+        return esp_secure_cert_find_tlv_linear(esp_secure_cert_addr, type, tlv_address);
+    }
+
+    esp_secure_cert_tlv_index_entry_t *entry = &s_tlv_index.entries[type];
+    uint8_t state = __atomic_load_n(&entry->state, __ATOMIC_RELAXED);
+    if (state == ESP_SECURE_CERT_TLV_INDEX_UNVERIFIED) {
+        /* Tasks verifying the same tlv at the same time come to the same result */
+        const esp_secure_cert_tlv_header_t *tlv_header = (const esp_secure_cert_tlv_header_t *)((const uint8_t *)esp_secure_cert_addr + entry->offset);
+        state = esp_secure_cert_tlv_crc_is_valid(tlv_header) ?
+                ESP_SECURE_CERT_TLV_INDEX_VALID : ESP_SECURE_CERT_TLV_INDEX_CRC_MISMATCH;
+        __atomic_store_n(&entry->state, state, __ATOMIC_RELAXED);
+    }
+
+    switch (state) {
+    case ESP_SECURE_CERT_TLV_INDEX_VALID:
+        *tlv_address = (void *)((const uint8_t *)esp_secure_cert_addr + entry->offset);
+        ESP_LOGD(TAG, "tlv structure of type %d found and verified", type);
+        return ESP_OK;
+    case ESP_SECURE_CERT_TLV_INDEX_CRC_MISMATCH:
+        *tlv_address = (void *)((const uint8_t *)esp_secure_cert_addr + entry->offset);
+        ESP_LOGE(TAG, "crc of tlv of type %d does not match", type);
+        return ESP_FAIL;
+    default:
+        ESP_LOGD(TAG, "Unable to find tlv of type: %d", type);
+        return ESP_FAIL;
+    }
+}
+
+/**
+
+@brief Retrieve the header of a specific ESP Secure Certificate TLV record.
+This function retrieves the header of a specific ESP Secure Certificate TLV record, identified by the type parameter. The tlv_header parameter is a pointer to a buffer where the header will be stored. The function returns ESP_OK if the header is successfully retrieved, otherwise it returns an error code.
+@param[in] type The type of the TLV record to retrieve the header for.
+@param[out] tlv_header The pointer at this location shall be updated with tlv_header pointer value.
+@return ESP_OK          Success
+        ESP_FAIL/
+        relevant error  Failure
+*/
+static esp_err_t esp_secure_cert_tlv_get_header(esp_secure_cert_tlv_type_t type, esp_secure_cert_tlv_header_t **tlv_header)
+{
+    esp_err_t err = ESP_FAIL;
+    char *esp_secure_cert_addr = (char *)esp_secure_cert_get_mapped_addr();
+    if (esp_secure_cert_addr == NULL) {
+        ESP_LOGE(TAG, "Error in obtaining esp_secure_cert memory mapped address");
+        return ESP_FAIL;
+    }
+    err = esp_secure_cert_find_tlv(esp_secure_cert_addr, type, (void **)tlv_header);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not find the tlv of type %d", type);
+        return err;
+    }
+    return err;
+}
+
+esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, char **buffer, uint32_t *len)
+{
+    esp_err_t err;
+    esp_secure_cert_tlv_header_t *tlv_header = NULL;
+    err = esp_secure_cert_tlv_get_header(type, &tlv_header);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not find header for TLV type %d", type);
+        return err;
+    }
+    *buffer = (char *)&tlv_header->value;
+    *len = tlv_header->length;
+
+    if (ESP_SECURE_CERT_IS_TLV_ENCRYPTED(tlv_header->flags)) {
+#if SOC_HMAC_SUPPORTED
+        ESP_LOGD(TAG, "TLV data is encrypted");
+#if ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED
+        if (esp_secure_cert_decrypted_cache_get(type, buffer, len)) {
+            ESP_LOGD(TAG, "Decrypted data of tlv type %d found in cache", type);
+            return ESP_OK;
+        }
+#endif
+        char *output_buf = (char *)heap_caps_calloc(1, sizeof(char) * (*len - HMAC_ENCRYPTION_TAG_LEN), MALLOC_CAP_INTERNAL);
+        if (output_buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory");
+            return ESP_ERR_NO_MEM;
+        }
+
+        err = esp_secure_cert_hmac_based_decryption(*buffer, *len, output_buf);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to decrypt the data");
+            free(output_buf);
+            return err;
+        }
+        ESP_FAULT_ASSERT(err == ESP_OK);
+        *buffer = output_buf;
+        *len =  *len - HMAC_ENCRYPTION_TAG_LEN;
+#if ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED
+        *buffer = esp_secure_cert_decrypted_cache_put(type, output_buf, *len);
+#endif
+#else
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+    } else if (ESP_SECURE_CERT_HMAC_ECDSA_KEY_DERIVATION(tlv_header->flags)) {
+#if SOC_HMAC_SUPPORTED
+        ESP_LOGD(TAG, "ECDSA private key shall be generated with help of HMAC");
+#if ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED
+        bool key_ready;
+        portENTER_CRITICAL(&s_derived_ecdsa_key_lock);
+        key_ready = s_derived_ecdsa_key_ready;
+        portEXIT_CRITICAL(&s_derived_ecdsa_key_lock);
+        if (key_ready) {
+            ESP_LOGD(TAG, "Using the ECDSA private key derived earlier");
+            *buffer = s_derived_ecdsa_key;
+            *len = ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE;
+            return ESP_OK;
+        }
+#endif
+        char *output_buf = (char *)heap_caps_calloc(1, sizeof(char) * (ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE), MALLOC_CAP_INTERNAL);
+        if (output_buf == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory");
+            return ESP_ERR_NO_MEM;
+        }
+        err = esp_secure_cert_gen_ecdsa_key(output_buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+        if (err != ESP_OK) {
+            free(output_buf);
+            ESP_LOGE(TAG, "Failed to generate ECDSA key, returned %04X", err);
+            return ESP_FAIL;
+        }
+        ESP_FAULT_ASSERT(err == ESP_OK);
+        *buffer = output_buf;
+        *len = ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE;
+#if ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED
+        /* Tasks deriving the key at the same time derive the same key, the first one keeps it */
+        portENTER_CRITICAL(&s_derived_ecdsa_key_lock);
+        if (!s_derived_ecdsa_key_ready) {
+            memcpy(s_derived_ecdsa_key, output_buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+            s_derived_ecdsa_key_ready = true;
+        }
+        portEXIT_CRITICAL(&s_derived_ecdsa_key_lock);
+        mbedtls_platform_zeroize(output_buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+        free(output_buf);
+        *buffer = s_derived_ecdsa_key;
+#endif
+#else
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+    } else {
+        ESP_LOGD(TAG, "TLV data is not encrypted");
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_tlv_get_into(esp_secure_cert_tlv_type_t type, char *buf, uint32_t cap, uint32_t *len)
+{
+    esp_err_t err;
+    esp_secure_cert_tlv_header_t *tlv_header = NULL;
+    uint32_t data_len;
+
+    if (len == NULL || (buf == NULL && cap != 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    err = esp_secure_cert_tlv_get_header(type, &tlv_header);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not find header for TLV type %d", type);
+        return err;
+    }
+
+    bool encrypted = ESP_SECURE_CERT_IS_TLV_ENCRYPTED(tlv_header->flags);
+    bool derived = ESP_SECURE_CERT_HMAC_ECDSA_KEY_DERIVATION(tlv_header->flags);
+#if SOC_HMAC_SUPPORTED
+    if (encrypted) {
+        if (tlv_header->length < HMAC_ENCRYPTION_TAG_LEN) {
+            return ESP_FAIL;
+        }
+        data_len = tlv_header->length - HMAC_ENCRYPTION_TAG_LEN;
+    } else if (derived) {
+        data_len = ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE;
+    } else {
+        data_len = tlv_header->length;
+    }
+#else
+    if (encrypted || derived) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    data_len = tlv_header->length;
+#endif
+
+    *len = data_len;
+    if (cap < data_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+#if SOC_HMAC_SUPPORTED
+    if (encrypted) {
+#if ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED
+        char *cached;
+        uint32_t cached_len;
+        if (esp_secure_cert_decrypted_cache_get(type, &cached, &cached_len)) {
+            memcpy(buf, cached, cached_len);
+            esp_secure_cert_tlv_release(cached);
+            return ESP_OK;
+        }
+#endif
+        /* Decrypt straight into the buffer of the caller */
+        err = esp_secure_cert_hmac_based_decryption((char *)tlv_header->value, tlv_header->length, buf);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to decrypt the data");
+            return err;
+        }
+        ESP_FAULT_ASSERT(err == ESP_OK);
+        return ESP_OK;
+    } else if (derived) {
+#if ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED
+        bool key_ready;
+        portENTER_CRITICAL(&s_derived_ecdsa_key_lock);
+        key_ready = s_derived_ecdsa_key_ready;
+        portEXIT_CRITICAL(&s_derived_ecdsa_key_lock);
+        if (key_ready) {
+            memcpy(buf, s_derived_ecdsa_key, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+            return ESP_OK;
+        }
+#endif
+        err = esp_secure_cert_gen_ecdsa_key(buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to generate ECDSA key, returned %04X", err);
+            return ESP_FAIL;
+        }
+        ESP_FAULT_ASSERT(err == ESP_OK);
+#if ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED
+        portENTER_CRITICAL(&s_derived_ecdsa_key_lock);
+        if (!s_derived_ecdsa_key_ready) {
+            memcpy(s_derived_ecdsa_key, buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+            s_derived_ecdsa_key_ready = true;
+        }
+        portEXIT_CRITICAL(&s_derived_ecdsa_key_lock);
+#endif
+        return ESP_OK;
+    }
+#endif
+    memcpy(buf, tlv_header->value, data_len);
+    return ESP_OK;
+}
+
+#if ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED
+/*
+ * Hand out the cached decrypted data of a tlv, unless it has expired
+ */
+static bool esp_secure_cert_decrypted_cache_get(esp_secure_cert_tlv_type_t type, char **buffer, uint32_t *len)
+{
+    bool found = false;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_decrypted_cache_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS; i++) {
+        esp_secure_cert_decrypted_entry_t *entry = &s_decrypted_cache[i];
+        if (entry->buffer != NULL && entry->type == type && now < entry->expiry_us) {
+            entry->users++;
+            *buffer = entry->buffer;
+            *len = entry->len;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_decrypted_cache_lock);
+    return found;
+}
+
+static void esp_secure_cert_decrypted_cache_timer_cb(void *arg)
+{
+    (void) arg;
+    esp_secure_cert_decrypted_cache_sweep(false);
+}
+
+/*
+ * Arm the timer that wipes the cached data once its lifetime is over
+ */
+static void esp_secure_cert_decrypted_cache_arm_timer(int64_t expiry_us)
+{
+    if (CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE_LIFETIME_S == 0) {
+        return;
+    }
+    if (s_decrypted_cache_timer == NULL) {
+        esp_timer_handle_t timer = NULL;
+        const esp_timer_create_args_t timer_args = {
+            .callback = esp_secure_cert_decrypted_cache_timer_cb,
+            .name = "esp_secure_cert_cache",
+        };
+        if (esp_timer_create(&timer_args, &timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create the timer of the decrypted data cache");
+            return;
+        }
+        portENTER_CRITICAL(&s_decrypted_cache_lock);
+        if (s_decrypted_cache_timer == NULL) {
+            s_decrypted_cache_timer = timer;
+            timer = NULL;
+        }
+        portEXIT_CRITICAL(&s_decrypted_cache_lock);
+        if (timer != NULL) {
+            esp_timer_delete(timer);
+        }
+    }
+    int64_t timeout_us = expiry_us - esp_timer_get_time();
+    /* A running timer fires for an earlier entry and re-arms itself for the rest */
+    if (!esp_timer_is_active(s_decrypted_cache_timer)) {
+        esp_timer_start_once(s_decrypted_cache_timer, (timeout_us > 0) ? (uint64_t)timeout_us : 1);
+    }
+}
+
+/*
+ * Keep freshly decrypted data in the cache.
+ * Returns the buffer to hand out, which is the cached one
+ * if another task cached the same tlv in the meantime.
+ */
+static char *esp_secure_cert_decrypted_cache_put(esp_secure_cert_tlv_type_t type, char *buffer, uint32_t len)
+{
+    char *result = buffer;
+    bool cached = false;
+    int64_t expiry_us = (CONFIG_ESP_SECURE_CERT_DECRYPTED_DATA_CACHE_LIFETIME_S == 0) ?
+                        INT64_MAX : esp_timer_get_time() + ESP_SECURE_CERT_DECRYPTED_CACHE_LIFETIME_US;
+    esp_secure_cert_decrypted_entry_t *free_entry = NULL;
+
+    portENTER_CRITICAL(&s_decrypted_cache_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS; i++) {
+        esp_secure_cert_decrypted_entry_t *entry = &s_decrypted_cache[i];
+        if (entry->buffer == NULL) {
+            free_entry = (free_entry == NULL) ? entry : free_entry;
+        } else if (entry->type == type && esp_timer_get_time() < entry->expiry_us) {
+            entry->users++;
+            result = entry->buffer;
+            break;
+        }
+    }
+    if (result == buffer && free_entry != NULL) {
+        free_entry->buffer = buffer;
+        free_entry->len = len;
+        free_entry->type = type;
+        free_entry->users = 1;
+        free_entry->expiry_us = expiry_us;
+        cached = true;
+    }
+    portEXIT_CRITICAL(&s_decrypted_cache_lock);
+
+    if (result != buffer) {
+        mbedtls_platform_zeroize(buffer, len);
+        free(buffer);
+    } else if (cached) {
+        esp_secure_cert_decrypted_cache_arm_timer(expiry_us);
+    } else {
+        ESP_LOGD(TAG, "Decrypted data cache is full, tlv type %d is not cached", type);
+    }
+    return result;
+}
+
+/*
+ * Wipe and free the cached data that is no longer used and has expired, or all of it.
+ * Data still in use is marked expired and wiped once released.
+ */
+static void esp_secure_cert_decrypted_cache_sweep(bool wipe_all)
+{
+    esp_secure_cert_decrypted_entry_t wiped[ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS] = {0};
+    int64_t now = esp_timer_get_time();
+    int64_t next_expiry_us = INT64_MAX;
+
+    portENTER_CRITICAL(&s_decrypted_cache_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS; i++) {
+        esp_secure_cert_decrypted_entry_t *entry = &s_decrypted_cache[i];
+        if (entry->buffer == NULL) {
+            continue;
+        }
+        if (wipe_all) {
+            entry->expiry_us = 0;
+        }
+        if (now < entry->expiry_us) {
+            next_expiry_us = (entry->expiry_us < next_expiry_us) ? entry->expiry_us : next_expiry_us;
+        } else if (entry->users == 0) {
+            wiped[i] = *entry;
+            memset(entry, 0, sizeof(*entry));
+        }
+    }
+    portEXIT_CRITICAL(&s_decrypted_cache_lock);
+
+    for (int i = 0; i < ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS; i++) {
+        if (wiped[i].buffer != NULL) {
+            mbedtls_platform_zeroize(wiped[i].buffer, wiped[i].len);
+            free(wiped[i].buffer);
+        }
+    }
+    if (next_expiry_us != INT64_MAX) {
+        esp_secure_cert_decrypted_cache_arm_timer(next_expiry_us);
+    }
+}
+
+void esp_secure_cert_clear_decrypted_cache(void)
+{
+    esp_secure_cert_decrypted_cache_sweep(true);
+}
+#endif /* ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED */
+
+bool esp_secure_cert_tlv_release(const char *buffer)
+{
+#if ESP_SECURE_CERT_RETAIN_DERIVED_KEY_ENABLED
+    if (buffer == s_derived_ecdsa_key) {
+        return true;
+    }
+#endif
+#if ESP_SECURE_CERT_DECRYPTED_CACHE_ENABLED
+    bool found = false;
+    esp_secure_cert_decrypted_entry_t wiped = {0};
+
+    if (buffer == NULL) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_decrypted_cache_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_DECRYPTED_CACHE_SLOTS; i++) {
+        esp_secure_cert_decrypted_entry_t *entry = &s_decrypted_cache[i];
+        if (entry->buffer == buffer) {
+            found = true;
+            if (entry->users > 0) {
+                entry->users--;
+            }
+            if (entry->users == 0 && esp_timer_get_time() >= entry->expiry_us) {
+                wiped = *entry;
+                memset(entry, 0, sizeof(*entry));
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_decrypted_cache_lock);
+
+    if (wiped.buffer != NULL) {
+        mbedtls_platform_zeroize(wiped.buffer, wiped.len);
+        free(wiped.buffer);
+    }
+    return found;
+#else
+    (void) buffer;
+    return false;
+#endif
+}
+
+#if SOC_HMAC_SUPPORTED
+esp_err_t esp_secure_cert_calculate_hmac_encryption_iv(uint8_t *iv)
+{
+    if (iv == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint32_t iv_message[HMAC_ENCRYPTION_MESSAGE_LEN / 4] = {[0 ... 7] = 0xABCDABCD};
+    esp_err_t esp_ret = ESP_FAIL;
+    esp_efuse_block_t efuse_block = EFUSE_BLK_MAX;
+    if (!esp_efuse_find_purpose(ESP_EFUSE_KEY_PURPOSE_HMAC_UP, &efuse_block)) {
+        ESP_LOGE(TAG, "Failed to get the block with purpose set to HMAC_UP");
+        return ESP_FAIL;;
+    }
+
+    hmac_key_id_t hmac_key_id = efuse_block - (int)EFUSE_BLK_KEY0;
+    uint8_t hmac[HMAC_ENCRYPTION_AES_GCM_KEY_LEN];
+    esp_ret = esp_hmac_calculate(hmac_key_id, (uint8_t *)iv_message, HMAC_ENCRYPTION_MESSAGE_LEN, hmac);
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Could not calculate the HMAC value, returned %04X", esp_ret);
+        ESP_LOGE(TAG, "returned %04X", esp_ret);
+        return esp_ret;
+    }
+    memcpy(iv, hmac, HMAC_ENCRYPTION_IV_LEN);
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_calculate_hmac_encryption_key(uint8_t *aes_key)
+{
+    if (aes_key == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint32_t key_message[HMAC_ENCRYPTION_MESSAGE_LEN / 4] = {[0 ... 7] = 0xFFFFFFFF};
+    esp_err_t esp_ret = ESP_FAIL;
+    esp_efuse_block_t efuse_block = EFUSE_BLK_MAX;
+    if (!esp_efuse_find_purpose(ESP_EFUSE_KEY_PURPOSE_HMAC_UP, &efuse_block)) {
+        ESP_LOGE(TAG, "Failed to get the block with purpose set to HMAC_UP");
+        return ESP_FAIL;;
+    }
+
+    hmac_key_id_t hmac_key_id = efuse_block - (int)EFUSE_BLK_KEY0;
+    esp_ret = esp_hmac_calculate(hmac_key_id, (uint8_t *)key_message, HMAC_ENCRYPTION_MESSAGE_LEN, aes_key);
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Could not calculate the HMAC value, returned %04X", esp_ret);
+        return esp_ret;
+    }
+    return ESP_OK;
+}
+
+#define HMAC_ENCRYPTION_RANDOM_DELAY_LIMIT 100
+/*
+ * @info
+ * Decrypt the data encrypted using hmac based encryption
+ *
+ * in_buf       This is a pointer in flash that points to the encrypted data
+ * len          Length of the encrypted data
+ * output_buf   Buffer to write the decrypted data
+ *              This must be of size = len - HMAC_ENCRYPTION_TAG_LEN
+ */
+static esp_err_t esp_secure_cert_hmac_based_decryption(char *in_buf, uint32_t len, char *output_buf)
+{
+    esp_err_t esp_ret = ESP_FAIL;
+    int ret = -1;
+    uint8_t aes_gcm_key[HMAC_ENCRYPTION_AES_GCM_KEY_LEN];
+    uint8_t iv[HMAC_ENCRYPTION_IV_LEN];
+
+    esp_ret = esp_secure_cert_calculate_hmac_encryption_iv(iv);
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to calculate hmac encryption iv");
+        return esp_ret;
+    }
+    esp_ret = esp_secure_cert_calculate_hmac_encryption_key(aes_gcm_key);
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to calculate hmac encryption key");
+        return esp_ret;
+    }
+
+    mbedtls_gcm_context gcm_ctx;
+    mbedtls_gcm_init(&gcm_ctx);
+    ret = mbedtls_gcm_setkey(&gcm_ctx, MBEDTLS_CIPHER_ID_AES, (unsigned char *)aes_gcm_key, HMAC_ENCRYPTION_AES_GCM_KEY_LEN * 8);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failure at mbedtls_gcm_setkey with error code : -0x%04X", -ret);
+        mbedtls_gcm_free(&gcm_ctx);
+        return ESP_FAIL;
+    }
+
+    uint32_t rand_delay;
+    rand_delay = esp_random() % HMAC_ENCRYPTION_RANDOM_DELAY_LIMIT;
+    esp_rom_delay_us(rand_delay);
+
+    len = len - HMAC_ENCRYPTION_TAG_LEN;
+    ret = mbedtls_gcm_auth_decrypt(&gcm_ctx, len, iv,
+                                   HMAC_ENCRYPTION_IV_LEN, NULL, 0,
+                                   (unsigned char *) (in_buf + len),
+                                   HMAC_ENCRYPTION_TAG_LEN,
+                                   (const unsigned char *)(in_buf),
+                                   (unsigned char *)output_buf);
+
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to decrypt the data, mbedtls_gcm_crypt_and_tag returned %02X", ret);
+        mbedtls_gcm_free(&gcm_ctx);
+        return ESP_FAIL;
+    }
+
+    ESP_FAULT_ASSERT(ret == ESP_OK);
+
+    return ESP_OK;
+}
+
+static int myrand(void *rng_state, unsigned char *output, size_t len)
+{
+    size_t olen;
+    (void) olen;
+    return mbedtls_hardware_poll(rng_state, output, len, &olen);
+}
+
+/*
+ * The API converts the 256 bit ECDSA key to DER format.
+ * @input
+ * key_buf      The readable buffer containing the plaintext key
+ * key_buf_len  The length of the key buf in bytes
+ * output_buf   The writable buffer to write the DER key
+ * output_buf_len Length of the output buffer
+ *
+ */
+static esp_err_t esp_secure_cert_convert_key_to_der(char *key_buf, size_t key_buf_len, char* output_buf, size_t output_buf_len)
+{
+    esp_err_t ret = ESP_FAIL;
+    // Convert the private key to der
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    ret = mbedtls_pk_setup(&key, mbedtls_pk_info_from_type(MBEDTLS_PK_ECKEY));
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to setup pk key, returned %04X", ret);
+        goto exit;
+    }
+
+    mbedtls_ecdsa_context *key_ctx = mbedtls_pk_ec(key);
+    ret = mbedtls_ecp_group_load(&key_ctx->MBEDTLS_PRIVATE(grp), MBEDTLS_ECP_DP_SECP256R1);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to load the ecp group, returned %04X", ret);
+        goto exit;
+    }
+
+    ret = mbedtls_mpi_read_binary(&key_ctx->MBEDTLS_PRIVATE(d), (const unsigned char *) key_buf, key_buf_len);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to read binary, returned %04X", ret);
+        goto exit;
+    }
+
+    // Calculate the public key
+    ret = mbedtls_ecp_mul(&key_ctx->MBEDTLS_PRIVATE(grp), &key_ctx->MBEDTLS_PRIVATE(Q), &key_ctx->MBEDTLS_PRIVATE(d), &key_ctx->MBEDTLS_PRIVATE(grp).G, myrand, NULL);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to generate public key, returned %04X", ret);
+        goto exit;
+    }
+
+    // Write the private key in DER format
+    ret = mbedtls_pk_write_key_der(&key, (unsigned char *) output_buf, output_buf_len);
+    if (ret != ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE) {
+        ESP_LOGE(TAG, "Failed to write the pem key, returned %04X", ret);
+        goto exit;
+    }
+    ret = ESP_OK;
+
+exit:
+    mbedtls_pk_free(&key);
+    return ret;
+}
+/*
+ * @info
+ * Generate the ECDSA private key (DER format) with help of the PBKDF2 hmac implementation.
+ * In this case the first eFuse key block with purpose set to HMAC_UP shall be used for generating the private key.
+ * The key shall be generated for the SECP256R1 curve, the length of the key in DER format shall be ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE bytes.
+ * The API assumes that a valid salt is stored in the esp_secure_cert partition, Otherwise the API would return with failure.
+ *
+ * @input
+ * output_buf  A writable buffer to store the DER formatted ECDSA private key
+ * buf_len     The length of the buffer in bytes. This must be exactly ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE bytes.
+ *
+ */
+static esp_err_t esp_secure_cert_gen_ecdsa_key(char *output_buf, size_t buf_len)
+{
+    esp_err_t err = ESP_FAIL;
+    int ret = 0;
+    if (buf_len != ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Obtain the salt stored in the esp_secure_cert partition
+    uint8_t *salt = NULL;
+    uint32_t salt_len = 0;
+    err = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_HMAC_ECDSA_KEY_SALT, (void *)&salt, &salt_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading salt, returned %04X", err);
+    }
+    ESP_FAULT_ASSERT(err == ESP_OK);
+
+    ESP_LOG_BUFFER_HEX_LEVEL("SALT", salt, salt_len, ESP_LOG_DEBUG);
+
+    esp_efuse_block_t efuse_block = EFUSE_BLK_KEY_MAX;
+    bool res = esp_efuse_find_purpose(ESP_EFUSE_KEY_PURPOSE_HMAC_UP, &efuse_block);
+    if (!res) {
+        ESP_LOGE(TAG, "Failed to get the block with purpose set to HMAC_UP");
+        return ESP_FAIL;
+    }
+    ESP_FAULT_ASSERT(res);
+
+    // The plaintext private key is kept on the stack
+    char key_buf[ESP_SECURE_CERT_DERIVED_ECDSA_KEY_SIZE];
+
+    // Generate the private key
+    ret = esp_pbkdf2_hmac_sha256(efuse_block - (int)EFUSE_BLK_KEY0, salt, salt_len, ESP_SECURE_CERT_KEY_DERIVATION_ITERATION_COUNT, ESP_SECURE_CERT_DERIVED_ECDSA_KEY_SIZE, (unsigned char *)key_buf);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to derive the ECDSA key using HMAC, returned %04X", ret);
+        mbedtls_platform_zeroize(key_buf, sizeof(key_buf));
+        return ESP_FAIL;
+    }
+    ESP_FAULT_ASSERT(ret == 0);
+
+    err = esp_secure_cert_convert_key_to_der(key_buf, ESP_SECURE_CERT_DERIVED_ECDSA_KEY_SIZE, output_buf, ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE);
+    // Wipe the plaintext private key as it is no longer needed
+    mbedtls_platform_zeroize(key_buf, sizeof(key_buf));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to convert the plaintext key to DER format");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
+#ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+esp_ds_data_ctx_t *esp_secure_cert_tlv_get_ds_ctx(void)
+{
+    esp_err_t esp_ret;
+    esp_ds_data_ctx_t *ds_data_ctx;
+
+    ds_data_ctx = (esp_ds_data_ctx_t *)calloc(1, sizeof(esp_ds_data_ctx_t));
+    if (ds_data_ctx == NULL) {
+        ESP_LOGE(TAG, "Error in allocating memory for esp_ds_data_context");
+        goto exit;
+    }
+
+    uint32_t len;
+    esp_ds_data_t *esp_ds_data;
+    esp_ret = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_DS_DATA_TLV, (void *) &esp_ds_data, &len);
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading ds_data, returned %04X", esp_ret);
+        goto exit;
+    }
+
+    esp_ds_data_ctx_t *ds_data_ctx_flash;
+    esp_ret = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_DS_CONTEXT_TLV, (void *) &ds_data_ctx_flash, &len);
+    memcpy(ds_data_ctx, ds_data_ctx_flash, len);
+    ds_data_ctx->esp_ds_data = esp_ds_data;
+    if (esp_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading ds_context, returned %04X", esp_ret);
+        goto exit;
+    }
+    return ds_data_ctx;
+exit:
+    free(ds_data_ctx);
+    return NULL;
+}
+
+void esp_secure_cert_tlv_free_ds_ctx(esp_ds_data_ctx_t *ds_ctx)
+{
+    free(ds_ctx);
+}
+#endif /* CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
+
+static esp_secure_cert_key_type_t esp_secure_cert_tlv_get_key_type(uint8_t flags)
+{
+    if (ESP_SECURE_CERT_HMAC_ECDSA_KEY_DERIVATION(flags)) {
+        return ESP_SECURE_CERT_HMAC_DERIVED_ECDSA_KEY;
+    } else if (ESP_SECURE_CERT_KEY_ECDSA_PERIPHERAL(flags)) {
+        return ESP_SECURE_CERT_ECDSA_PERIPHERAL_KEY;
+    } else if (ESP_SECURE_CERT_IS_TLV_ENCRYPTED(flags)) {
+        return ESP_SECURE_CERT_HMAC_ENCRYPTED_KEY;
+    }
+    return ESP_SECURE_CERT_DEFAULT_FORMAT_KEY;
+}
+
+esp_err_t esp_secure_cert_tlv_get_bundle(esp_secure_cert_bundle_t *bundle)
+{
+    esp_err_t err;
+    esp_secure_cert_tlv_header_t *tlv_header = NULL;
+
+    if (bundle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(bundle, 0, sizeof(esp_secure_cert_bundle_t));
+    bundle->priv_key_type = ESP_SECURE_CERT_INVALID_KEY;
+
+    char *esp_secure_cert_addr = (char *)esp_secure_cert_get_mapped_addr();
+    if (esp_secure_cert_addr == NULL) {
+        ESP_LOGE(TAG, "Error in obtaining esp_secure_cert memory mapped address");
+        return ESP_FAIL;
+    }
+
+    err = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_DEV_CERT_TLV, &bundle->device_cert, &bundle->device_cert_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error in reading the device cert, returned %04X", err);
+        return err;
+    }
+
+    /* The CA cert is optional */
+    if (esp_secure_cert_find_tlv(esp_secure_cert_addr, ESP_SECURE_CERT_CA_CERT_TLV, (void **)&tlv_header) == ESP_OK) {
+        err = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_CA_CERT_TLV, &bundle->ca_cert, &bundle->ca_cert_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Error in reading the ca cert, returned %04X", err);
+            goto exit;
+        }
+    }
+
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+    err = esp_secure_cert_find_tlv(esp_secure_cert_addr, ESP_SECURE_CERT_PRIV_KEY_TLV, (void **)&tlv_header);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not find header for priv key");
+        goto exit;
+    }
+    bundle->priv_key_type = esp_secure_cert_tlv_get_key_type(tlv_header->flags);
+    if (bundle->priv_key_type != ESP_SECURE_CERT_ECDSA_PERIPHERAL_KEY) {
+        err = esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_PRIV_KEY_TLV, &bundle->priv_key, &bundle->priv_key_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Error in reading the priv key, returned %04X", err);
+            goto exit;
+        }
+    }
+#else
+    bundle->ds_ctx = esp_secure_cert_tlv_get_ds_ctx();
+    if (bundle->ds_ctx == NULL) {
+        err = ESP_FAIL;
+        goto exit;
+    }
+    bundle->priv_key_type = ESP_SECURE_CERT_DS_PERIPHERAL_KEY;
+#endif
+    return ESP_OK;
+
+exit:
+    esp_secure_cert_free_bundle(bundle);
+    return err;
+}
+
+void esp_secure_cert_free_bundle(esp_secure_cert_bundle_t *bundle)
+{
+    if (bundle == NULL) {
+        return;
+    }
+    if (bundle->device_cert != NULL) {
+        esp_secure_cert_free_device_cert(bundle->device_cert);
+    }
+    if (bundle->ca_cert != NULL) {
+        esp_secure_cert_free_ca_cert(bundle->ca_cert);
+    }
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+    if (bundle->priv_key != NULL) {
+        esp_secure_cert_free_priv_key(bundle->priv_key);
+    }
+#else
+    if (bundle->ds_ctx != NULL) {
+        esp_secure_cert_free_ds_ctx(bundle->ds_ctx);
+    }
+#endif
+    memset(bundle, 0, sizeof(esp_secure_cert_bundle_t));
+    bundle->priv_key_type = ESP_SECURE_CERT_INVALID_KEY;
+}
+
+bool esp_secure_cert_is_tlv_partition(void)
+{
+    char *esp_secure_cert_addr = (char *)esp_secure_cert_get_mapped_addr();
+    if (esp_secure_cert_addr == NULL) {
+        return 0;
+    }
+    esp_secure_cert_tlv_header_t *tlv_header = (esp_secure_cert_tlv_header_t *)(esp_secure_cert_addr );
+    if (tlv_header->magic == ESP_SECURE_CERT_TLV_MAGIC) {
+        ESP_LOGI(TAG, "TLV partition identified");
+        return 1;
+    }
+    return 0;
+}
+
+#ifndef CONFIG_ESP_SECURE_CERT_SUPPORT_LEGACY_FORMATS
+esp_err_t esp_secure_cert_get_device_cert(char **buffer, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_DEV_CERT_TLV, buffer, len);
+}
+
+esp_err_t esp_secure_cert_free_device_cert(char *buffer)
+{
+    /* Hand a cached decrypted cert back to the cache */
+    esp_secure_cert_tlv_release(buffer);
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_get_device_cert_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_into(ESP_SECURE_CERT_DEV_CERT_TLV, buf, cap, len);
+}
+
+esp_err_t esp_secure_cert_get_ca_cert(char **buffer, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_CA_CERT_TLV, buffer, len);
+}
+
+esp_err_t esp_secure_cert_free_ca_cert(char *buffer)
+{
+    /* Hand a cached decrypted cert back to the cache */
+    esp_secure_cert_tlv_release(buffer);
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_get_ca_cert_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_into(ESP_SECURE_CERT_CA_CERT_TLV, buf, cap, len);
+}
+
+#ifndef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_addr(ESP_SECURE_CERT_PRIV_KEY_TLV, buffer, len);
+}
+
+esp_err_t esp_secure_cert_free_priv_key(char *buffer)
+{
+    if (esp_secure_cert_tlv_release(buffer)) {
+        /* The decrypted key is kept in the cache */
+        return ESP_OK;
+    }
+    if (!esp_ptr_in_drom((const void *) buffer)) {
+        free(buffer);
+        return ESP_OK;
+    }
+    (void) buffer; /* nothing to do */
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_get_priv_key_into(char *buf, uint32_t cap, uint32_t *len)
+{
+    return esp_secure_cert_tlv_get_into(ESP_SECURE_CERT_PRIV_KEY_TLV, buf, cap, len);
+}
+
+#else /* !CONFIG_ESP_SECURE_CERT_DS_PEIPHERAL */
+
+esp_ds_data_ctx_t *esp_secure_cert_get_ds_ctx(void)
+{
+    return esp_secure_cert_tlv_get_ds_ctx();
+}
+
+void esp_secure_cert_free_ds_ctx(esp_ds_data_ctx_t *ds_ctx)
+{
+    esp_secure_cert_tlv_free_ds_ctx(ds_ctx);
+}
+#endif /* CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
+
+esp_err_t esp_secure_cert_get_bundle(esp_secure_cert_bundle_t *bundle)
+{
+    return esp_secure_cert_tlv_get_bundle(bundle);
+}
+
+esp_err_t esp_secure_cert_get_priv_key_type(esp_secure_cert_key_type_t *priv_key_type) {
+    esp_err_t err;
+    if (priv_key_type == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_secure_cert_tlv_header_t *tlv_header = NULL;
+    err = esp_secure_cert_tlv_get_header(ESP_SECURE_CERT_PRIV_KEY_TLV, &tlv_header);
+    if (err != ESP_OK) {
+        *priv_key_type = ESP_SECURE_CERT_INVALID_KEY;
+        ESP_LOGE(TAG, "Could not find header for priv key");
+        return err;
+    }
+
+    *priv_key_type = esp_secure_cert_tlv_get_key_type(tlv_header->flags);
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_get_priv_key_efuse_id(uint8_t *efuse_key_id) {
+    esp_err_t err;
+    esp_secure_cert_tlv_header_t *tlv_header = NULL;
+    if (efuse_key_id == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    err = esp_secure_cert_tlv_get_header(ESP_SECURE_CERT_TLV_SEC_CFG, &tlv_header);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not find header for TLV security configurations");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    esp_secure_cert_tlv_sec_cfg_t *tlv_sec_cfg;
+    tlv_sec_cfg = (esp_secure_cert_tlv_sec_cfg_t *) tlv_header->value;
+    *efuse_key_id = tlv_sec_cfg->priv_key_efuse_id;
+
+    return ESP_OK;
+}
+#endif /* CONFIG_ESP_SECURE_CERT_SUPPORT_LEGACY_FORMATS */
@@ -110,6 +110,14 @@ def main():
              'Can be \"cust_flash_tlv\" or \"cust_flash\" or \"nvs\". '
              'Please note that \"cust_flash\" and \"nvs\" are legacy formats.')
 
+    parser.add_argument(
+        '--tlv_directory',
+        dest='tlv_directory', action='store_true',
+        help='Provide this option to add a directory of the tlvs at the start'
+             ' of the \"cust_flash_tlv\" partition. It lets the device seek'
+             ' to a tlv directly. Older versions of the esp_secure_cert_mgr'
+             ' component ignore the directory.')
+
     parser.add_argument(
         '--configure_ds',
         dest='configure_ds', action='store_true',
@@ -215,12 +223,14 @@ def main():
             tlv_format.generate_partition_ds(c, iv, args.efuse_key_id,
                                              key_size, args.device_cert,
                                              ca_cert, idf_target,
-                                             bin_filename)
+                                             bin_filename,
+                                             args.tlv_directory)
         else:
             tlv_format.generate_partition_no_ds(args.device_cert,
                                                 ca_cert, args.privkey,
                                                 args.priv_key_pass,
-                                                idf_target, bin_filename)
+                                                idf_target, bin_filename,
+                                                args.tlv_directory)
 
     elif args.sec_cert_type == 'cust_flash':
         if args.configure_ds is not False:
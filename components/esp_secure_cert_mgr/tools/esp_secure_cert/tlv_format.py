@@ -12,6 +12,7 @@ class tlv_type_t(enum.IntEnum):
     PRIV_KEY = 2
     DS_DATA = 3
     DS_CONTEXT = 4
+    DIRECTORY = 49
     TLV_END = 50
     USER_DATA_1 = 51
     USER_DATA_2 = 52
@@ -24,6 +25,15 @@ class tlv_type_t(enum.IntEnum):
 # to an encrypted partition on esp device
 MIN_ALIGNMENT_REQUIRED = 16
 
+TLV_MAGIC = 0xBA5EBA11
+TLV_HEADER_LEN = 12
+TLV_FOOTER_LEN = 4
+
+# Version of the tlv directory format
+TLV_DIRECTORY_VERSION = 1
+TLV_DIRECTORY_HEADER_LEN = 4
+TLV_DIRECTORY_ENTRY_LEN = 16
+
 
 def prepare_tlv(tlv_type, data, data_len):
     # Add the magic at start ( unsigned int )
@@ -48,12 +58,64 @@ def prepare_tlv(tlv_type, data, data_len):
     return tlv
 
 
+def tlv_total_len(data_len):
+    padding_len = (MIN_ALIGNMENT_REQUIRED
+                   - data_len % MIN_ALIGNMENT_REQUIRED) % MIN_ALIGNMENT_REQUIRED
+    return TLV_HEADER_LEN + data_len + padding_len + TLV_FOOTER_LEN
+
+
+# @info
+#       This function adds a tlv directory at the start of the tlv data
+#       i.e. tlv_data[:tlv_data_length], moving the tlvs after it.
+#       The directory lists the type, flags, offset, length and crc
+#       of every tlv so that the device can seek to a tlv directly.
+#       Readers which do not support the directory skip it as any other tlv.
+def add_tlv_directory(tlv_data, tlv_data_length, partition_size):
+    tlvs = []
+    offset = 0
+    while offset < tlv_data_length:
+        magic, flags, tlv_type, data_len = struct.unpack_from('<IB3xHH',
+                                                              tlv_data,
+                                                              offset)
+        if magic != TLV_MAGIC:
+            raise ValueError('Invalid tlv at offset {}'.format(offset))
+        tlv_len = tlv_total_len(data_len)
+        crc, = struct.unpack_from('<I', tlv_data,
+                                  offset + tlv_len - TLV_FOOTER_LEN)
+        tlvs.append((tlv_type, flags, offset, data_len, crc))
+        offset = offset + tlv_len
+
+    if len(tlvs) > 0xFF:
+        raise ValueError('Too many tlvs for the tlv directory')
+    directory_len = (TLV_DIRECTORY_HEADER_LEN
+                     + TLV_DIRECTORY_ENTRY_LEN * len(tlvs))
+    directory_tlv_len = tlv_total_len(directory_len)
+    if directory_tlv_len + tlv_data_length > partition_size:
+        raise ValueError('The tlv directory does not fit in the partition')
+
+    directory = struct.pack('<BB2x', TLV_DIRECTORY_VERSION, len(tlvs))
+    for tlv_type, flags, offset, data_len, crc in tlvs:
+        directory = directory + struct.pack('<HB1xIH2xI', tlv_type, flags,
+                                            directory_tlv_len + offset,
+                                            data_len, crc)
+    directory_tlv = prepare_tlv(tlv_type_t.DIRECTORY,
+                                directory, len(directory))
+    print('tlv directory: total length = {}'.format(len(directory_tlv)))
+
+    output_data = bytearray(b'\xff' * partition_size)
+    output_data[0: directory_tlv_len] = directory_tlv
+    output_data[directory_tlv_len: directory_tlv_len
+                + tlv_data_length] = tlv_data[0: tlv_data_length]
+    return output_data
+
+
 # @info
 #       This function generates the cust_flash partition of
 #       the encrypted private key parameters when DS is enabled.
+#       With tlv_directory set, a tlv directory is added at the start.
 def generate_partition_ds(c, iv, hmac_key_id, key_size,
                           device_cert, ca_cert, idf_target,
-                          op_file):
+                          op_file, tlv_directory=False):
     # cust_flash partition is of size 0x2000 i.e. 8192 bytes
     tlv_data_length = 0
     with open(op_file, 'wb') as output_file:
@@ -121,6 +183,10 @@ def generate_partition_ds(c, iv, hmac_key_id, key_size,
         print('ds_context tlv: total length = {}'.format(len(ds_context_tlv)))
         tlv_data_length += len(ds_context_tlv)
         print('Total length of tlv data = {}'.format(tlv_data_length))
+        if tlv_directory:
+            output_file_data = add_tlv_directory(output_file_data,
+                                                 tlv_data_length,
+                                                 partition_size)
         output_file.write(output_file_data)
         output_file.close()
 
@@ -128,8 +194,10 @@ def generate_partition_ds(c, iv, hmac_key_id, key_size,
 # @info
 #       This function generates the cust_flash partition of
 #       the encrypted private key parameters when DS is disabled.
+#       With tlv_directory set, a tlv directory is added at the start.
 def generate_partition_no_ds(device_cert, ca_cert, priv_key,
-                             priv_key_pass, idf_target, op_file):
+                             priv_key_pass, idf_target, op_file,
+                             tlv_directory=False):
     # cust_flash partition is of size 0x2000 i.e. 8192 bytes
     tlv_data_length = 0
     with open(op_file, 'wb') as output_file:
@@ -184,5 +252,9 @@ def generate_partition_no_ds(device_cert, ca_cert, priv_key,
         print('priv_key tlv: total length = {}'.format(len(priv_key_tlv)))
         tlv_data_length += len(priv_key_tlv)
         print('Total length of tlv data = {}'.format(tlv_data_length))
+        if tlv_directory:
+            output_file_data = add_tlv_directory(output_file_data,
+                                                 tlv_data_length,
+                                                 partition_size)
         output_file.write(output_file_data)
         output_file.close()
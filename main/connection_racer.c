@@ -0,0 +1,434 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file connection_racer.c
+ *
+ * @brief Staggered race of TCP connections to several ports of a broker,
+ * and a per-network record of the port that won.
+ */
+
+/* Standard includes. */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* POSIX includes. */
+#include <fcntl.h>
+#include <unistd.h>
+
+/* lwIP includes. */
+#include "lwip/sockets.h"
+
+/* ESP-IDF includes. */
+#include "esp_netif.h"
+#include "nvs.h"
+
+/* Clock for timer. */
+#include "clock.h"
+
+/* Demo configuration. */
+#include "demo_config.h"
+
+#include "connection_racer.h"
+
+/**
+ * @brief Length of an NVS key: the gateway address and a hash of the host
+ * name, in hexadecimal.
+ */
+#define WINNER_KEY_LENGTH    ( 12U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Open a non-blocking socket and start connecting it.
+ *
+ * @param[in] pAddress Address to connect to.
+ * @param[in] port Port to connect to.
+ *
+ * @return The socket; -1 if the connection could not be started.
+ */
+static int startAttempt( const ip_addr_t * pAddress,
+                         uint16_t port );
+
+/**
+ * @brief Whether the connection of a socket reported writable by select()
+ * completed, rather than failed.
+ *
+ * @param[in] socketFd The socket.
+ *
+ * @return true if the connection is established.
+ */
+static bool attemptSucceeded( int socketFd );
+
+/**
+ * @brief Build the NVS key of the winner for a broker on the current
+ * network.
+ *
+ * @param[in] pHostName NUL-terminated host name of the broker.
+ * @param[out] pKey Buffer of #WINNER_KEY_LENGTH + 1 bytes.
+ *
+ * @return ConnectionRacerSuccess; ConnectionRacerBadParameter or
+ * ConnectionRacerNetworkUnknown.
+ */
+static ConnectionRacerStatus_t getWinnerKey( const char * pHostName,
+                                             char * pKey );
+
+/*-----------------------------------------------------------*/
+
+static int startAttempt( const ip_addr_t * pAddress,
+                         uint16_t port )
+{
+    struct sockaddr_storage address;
+    socklen_t addressLength = 0;
+    int socketFd = -1;
+    int flags = 0;
+
+    ( void ) memset( &address, 0x00, sizeof( address ) );
+
+    #if LWIP_IPV6
+        if( IP_IS_V6( pAddress ) )
+        {
+            struct sockaddr_in6 * pAddress6 = ( struct sockaddr_in6 * ) &address;
+
+            pAddress6->sin6_family = AF_INET6;
+            pAddress6->sin6_port = htons( port );
+            inet6_addr_from_ip6addr( &pAddress6->sin6_addr, ip_2_ip6( pAddress ) );
+            addressLength = sizeof( struct sockaddr_in6 );
+        }
+        else
+    #endif
+    {
+        struct sockaddr_in * pAddress4 = ( struct sockaddr_in * ) &address;
+
+        pAddress4->sin_family = AF_INET;
+        pAddress4->sin_port = htons( port );
+        inet_addr_from_ip4addr( &pAddress4->sin_addr, ip_2_ip4( pAddress ) );
+        addressLength = sizeof( struct sockaddr_in );
+    }
+
+    socketFd = socket( address.ss_family, SOCK_STREAM, IPPROTO_TCP );
+
+    if( socketFd >= 0 )
+    {
+        flags = fcntl( socketFd, F_GETFL, 0 );
+
+        if( ( fcntl( socketFd, F_SETFL, flags | O_NONBLOCK ) < 0 ) ||
+            ( ( connect( socketFd, ( struct sockaddr * ) &address, addressLength ) < 0 ) &&
+              ( errno != EINPROGRESS ) ) )
+        {
+            ( void ) close( socketFd );
+            socketFd = -1;
+        }
+    }
+
+    return socketFd;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool attemptSucceeded( int socketFd )
+{
+    int socketError = 0;
+    socklen_t optionLength = sizeof( socketError );
+
+    return( ( getsockopt( socketFd, SOL_SOCKET, SO_ERROR, &socketError, &optionLength ) == 0 ) &&
+            ( socketError == 0 ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static ConnectionRacerStatus_t getWinnerKey( const char * pHostName,
+                                             char * pKey )
+{
+    ConnectionRacerStatus_t status = ConnectionRacerSuccess;
+    esp_netif_t * pNetif = esp_netif_get_default_netif();
+    esp_netif_ip_info_t ipInfo;
+    uint32_t hostNameHash = 2166136261U;
+    const char * pCharacter = NULL;
+
+    if( pHostName == NULL )
+    {
+        status = ConnectionRacerBadParameter;
+    }
+    else if( ( pNetif == NULL ) ||
+             ( esp_netif_get_ip_info( pNetif, &ipInfo ) != ESP_OK ) ||
+             ( ipInfo.gw.addr == 0U ) )
+    {
+        status = ConnectionRacerNetworkUnknown;
+    }
+    else
+    {
+        /* FNV-1a, folded to 16 bits to fit the 15 character NVS key. */
+        for( pCharacter = pHostName; *pCharacter != '\0'; pCharacter++ )
+        {
+            hostNameHash = ( hostNameHash ^ ( uint8_t ) *pCharacter ) * 16777619U;
+        }
+
+        ( void ) snprintf( pKey, WINNER_KEY_LENGTH + 1U, "%08" PRIx32 "%04" PRIx32,
+                           ( uint32_t ) ipInfo.gw.addr,
+                           ( hostNameHash ^ ( hostNameHash >> 16 ) ) & 0xFFFFU );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ConnectionRacerStatus_t ConnectionRacer_Race( const ip_addr_t * pAddress,
+                                              const uint16_t * pPorts,
+                                              size_t portCount,
+                                              uint32_t timeoutMs,
+                                              uint16_t * pWinningPort )
+{
+    ConnectionRacerStatus_t status = ConnectionRacerNoWinner;
+    int sockets[ CONNECTION_RACER_MAX_PORTS ];
+    size_t started = 0U;
+    size_t running = 0U;
+    size_t index = 0U;
+    uint32_t startTimeMs = 0U;
+    uint32_t elapsedMs = 0U;
+    uint32_t waitMs = 0U;
+    int maxSocket = -1;
+    fd_set writeSet;
+    struct timeval timeout;
+
+    if( ( pAddress == NULL ) || ( pPorts == NULL ) || ( pWinningPort == NULL ) ||
+        ( portCount == 0U ) || ( portCount > CONNECTION_RACER_MAX_PORTS ) )
+    {
+        return ConnectionRacerBadParameter;
+    }
+
+    startTimeMs = Clock_GetTimeMs();
+
+    while( status == ConnectionRacerNoWinner )
+    {
+        elapsedMs = Clock_GetTimeMs() - startTimeMs;
+
+        if( elapsedMs >= timeoutMs )
+        {
+            break;
+        }
+
+        /* Start the next attempt when its turn comes, or at once if every
+         * running attempt has failed. */
+        if( ( started < portCount ) &&
+            ( ( running == 0U ) || ( elapsedMs >= ( started * CONNECTION_RACER_STAGGER_MS ) ) ) )
+        {
+            sockets[ started ] = startAttempt( pAddress, pPorts[ started ] );
+
+            if( sockets[ started ] >= 0 )
+            {
+                running++;
+            }
+
+            started++;
+            continue;
+        }
+
+        if( running == 0U )
+        {
+            break;
+        }
+
+        waitMs = timeoutMs - elapsedMs;
+
+        if( ( started < portCount ) && ( ( started * CONNECTION_RACER_STAGGER_MS ) - elapsedMs < waitMs ) )
+        {
+            waitMs = ( uint32_t ) ( ( started * CONNECTION_RACER_STAGGER_MS ) - elapsedMs );
+        }
+
+        FD_ZERO( &writeSet );
+        maxSocket = -1;
+
+        for( index = 0U; index < started; index++ )
+        {
+            if( sockets[ index ] >= 0 )
+            {
+                FD_SET( sockets[ index ], &writeSet );
+                maxSocket = ( sockets[ index ] > maxSocket ) ? sockets[ index ] : maxSocket;
+            }
+        }
+
+        timeout.tv_sec = waitMs / 1000U;
+        timeout.tv_usec = ( waitMs % 1000U ) * 1000U;
+
+        if( select( maxSocket + 1, NULL, &writeSet, NULL, &timeout ) < 0 )
+        {
+            break;
+        }
+
+        for( index = 0U; ( index < started ) && ( status == ConnectionRacerNoWinner ); index++ )
+        {
+            if( ( sockets[ index ] >= 0 ) && FD_ISSET( sockets[ index ], &writeSet ) )
+            {
+                if( attemptSucceeded( sockets[ index ] ) )
+                {
+                    *pWinningPort = pPorts[ index ];
+                    status = ConnectionRacerSuccess;
+                }
+                else
+                {
+                    ( void ) close( sockets[ index ] );
+                    sockets[ index ] = -1;
+                    running--;
+                }
+            }
+        }
+    }
+
+    /* The winner is only probed; the caller connects on its own. */
+    for( index = 0U; index < started; index++ )
+    {
+        if( sockets[ index ] >= 0 )
+        {
+            ( void ) close( sockets[ index ] );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ConnectionRacerStatus_t ConnectionRacer_LoadWinner( const char * pHostName,
+                                                    uint16_t * pPort )
+{
+    ConnectionRacerStatus_t status = ConnectionRacerSuccess;
+    char key[ WINNER_KEY_LENGTH + 1U ];
+    nvs_handle_t handle;
+    esp_err_t err = ESP_OK;
+
+    if( pPort == NULL )
+    {
+        return ConnectionRacerBadParameter;
+    }
+
+    status = getWinnerKey( pHostName, key );
+
+    if( status == ConnectionRacerSuccess )
+    {
+        err = nvs_open( CONNECTION_RACER_NVS_NAMESPACE, NVS_READONLY, &handle );
+
+        if( err == ESP_OK )
+        {
+            err = nvs_get_u16( handle, key, pPort );
+            nvs_close( handle );
+        }
+
+        if( err == ESP_ERR_NVS_NOT_FOUND )
+        {
+            status = ConnectionRacerNotFound;
+        }
+        else if( err != ESP_OK )
+        {
+            status = ConnectionRacerStorageError;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ConnectionRacerStatus_t ConnectionRacer_StoreWinner( const char * pHostName,
+                                                     uint16_t port )
+{
+    ConnectionRacerStatus_t status = ConnectionRacerSuccess;
+    char key[ WINNER_KEY_LENGTH + 1U ];
+    nvs_handle_t handle;
+    uint16_t storedPort = 0U;
+    esp_err_t err = ESP_OK;
+
+    status = getWinnerKey( pHostName, key );
+
+    if( status == ConnectionRacerSuccess )
+    {
+        err = nvs_open( CONNECTION_RACER_NVS_NAMESPACE, NVS_READWRITE, &handle );
+
+        if( err == ESP_OK )
+        {
+            /* Avoid wearing the flash when the same port wins again. */
+            if( ( nvs_get_u16( handle, key, &storedPort ) != ESP_OK ) || ( storedPort != port ) )
+            {
+                err = nvs_set_u16( handle, key, port );
+
+                if( err == ESP_OK )
+                {
+                    err = nvs_commit( handle );
+                }
+            }
+
+            nvs_close( handle );
+        }
+
+        if( err != ESP_OK )
+        {
+            LogWarn( ( "Failed to store the winning port %u: %s.",
+                       ( unsigned int ) port,
+                       esp_err_to_name( err ) ) );
+            status = ConnectionRacerStorageError;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ConnectionRacerStatus_t ConnectionRacer_ForgetWinner( const char * pHostName )
+{
+    ConnectionRacerStatus_t status = ConnectionRacerSuccess;
+    char key[ WINNER_KEY_LENGTH + 1U ];
+    nvs_handle_t handle;
+    esp_err_t err = ESP_OK;
+
+    status = getWinnerKey( pHostName, key );
+
+    if( status == ConnectionRacerSuccess )
+    {
+        err = nvs_open( CONNECTION_RACER_NVS_NAMESPACE, NVS_READWRITE, &handle );
+
+        if( err == ESP_OK )
+        {
+            err = nvs_erase_key( handle, key );
+
+            if( err == ESP_OK )
+            {
+                err = nvs_commit( handle );
+            }
+
+            nvs_close( handle );
+        }
+
+        if( ( err != ESP_OK ) && ( err != ESP_ERR_NVS_NOT_FOUND ) )
+        {
+            status = ConnectionRacerStorageError;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,136 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file connection_racer.h
+ *
+ * @brief Staggered race of TCP connections to several ports of a broker,
+ * and a per-network record of the port that won.
+ *
+ * The first port is tried at once, each further port
+ * #CONNECTION_RACER_STAGGER_MS later or as soon as every earlier attempt
+ * failed. The first connection to complete wins and all attempts are
+ * closed, so the caller then opens its own connection to the winning port.
+ *
+ * The winner is stored in NVS per broker host name and per network, the
+ * network being told apart by the gateway address of the default network
+ * interface, so later connections on the same network need no race.
+ */
+
+#ifndef CONNECTION_RACER_H_
+#define CONNECTION_RACER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* lwIP address type. */
+#include "lwip/ip_addr.h"
+
+/**
+ * @brief Maximum number of ports in a race.
+ */
+#ifndef CONNECTION_RACER_MAX_PORTS
+    #define CONNECTION_RACER_MAX_PORTS       ( 4U )
+#endif
+
+/**
+ * @brief Delay between the start of two attempts of a race.
+ */
+#ifndef CONNECTION_RACER_STAGGER_MS
+    #define CONNECTION_RACER_STAGGER_MS      ( 250U )
+#endif
+
+/**
+ * @brief NVS namespace of the stored winners.
+ */
+#ifndef CONNECTION_RACER_NVS_NAMESPACE
+    #define CONNECTION_RACER_NVS_NAMESPACE   "conn_racer"
+#endif
+
+/**
+ * @brief Return codes of the racer functions.
+ */
+typedef enum ConnectionRacerStatus
+{
+    ConnectionRacerSuccess = 0,      /**< The operation succeeded. */
+    ConnectionRacerBadParameter,     /**< A parameter was NULL or out of range. */
+    ConnectionRacerNoWinner,         /**< No connection completed in time. */
+    ConnectionRacerNotFound,         /**< No winner is stored for this network. */
+    ConnectionRacerNetworkUnknown,   /**< The default network interface has no gateway. */
+    ConnectionRacerStorageError      /**< NVS could not be read or written. */
+} ConnectionRacerStatus_t;
+
+/**
+ * @brief Race TCP connections to several ports of an address.
+ *
+ * @param[in] pAddress Address of the broker.
+ * @param[in] pPorts Ports to race, in order of preference.
+ * @param[in] portCount Number of ports, at most #CONNECTION_RACER_MAX_PORTS.
+ * @param[in] timeoutMs Longest time the race may take.
+ * @param[out] pWinningPort The port whose connection completed first.
+ *
+ * @return ConnectionRacerSuccess; ConnectionRacerNoWinner if every attempt
+ * failed or timed out; ConnectionRacerBadParameter.
+ */
+ConnectionRacerStatus_t ConnectionRacer_Race( const ip_addr_t * pAddress,
+                                              const uint16_t * pPorts,
+                                              size_t portCount,
+                                              uint32_t timeoutMs,
+                                              uint16_t * pWinningPort );
+
+/**
+ * @brief Get the port stored for a broker on the current network.
+ *
+ * @param[in] pHostName NUL-terminated host name of the broker.
+ * @param[out] pPort The stored port.
+ *
+ * @return ConnectionRacerSuccess; ConnectionRacerNotFound,
+ * ConnectionRacerNetworkUnknown or ConnectionRacerStorageError.
+ */
+ConnectionRacerStatus_t ConnectionRacer_LoadWinner( const char * pHostName,
+                                                    uint16_t * pPort );
+
+/**
+ * @brief Store the port to use for a broker on the current network. NVS is
+ * written only if the port changed.
+ *
+ * @param[in] pHostName NUL-terminated host name of the broker.
+ * @param[in] port The port.
+ *
+ * @return ConnectionRacerSuccess; ConnectionRacerNetworkUnknown or
+ * ConnectionRacerStorageError.
+ */
+ConnectionRacerStatus_t ConnectionRacer_StoreWinner( const char * pHostName,
+                                                     uint16_t port );
+
+/**
+ * @brief Forget the port stored for a broker on the current network, e.g.
+ * because connecting to it failed, so that the next connection races again.
+ *
+ * @param[in] pHostName NUL-terminated host name of the broker.
+ *
+ * @return ConnectionRacerSuccess; ConnectionRacerNetworkUnknown or
+ * ConnectionRacerStorageError.
+ */
+ConnectionRacerStatus_t ConnectionRacer_ForgetWinner( const char * pHostName );
+
+#endif /* ifndef CONNECTION_RACER_H_ */
@@ -0,0 +1,275 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file credential_cache.c
+ *
+ * @brief DER form of the PEM credentials embedded in the firmware, decoded
+ * once and kept for the lifetime of the program.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+
+/* mbedTLS PEM decoder. */
+#include "mbedtls/pem.h"
+
+#include "credential_cache.h"
+
+/**
+ * @brief Start of a PEM block, up to its label.
+ */
+#define PEM_BEGIN                  "-----BEGIN "
+
+/**
+ * @brief Length of #PEM_BEGIN.
+ */
+#define PEM_BEGIN_LENGTH           ( sizeof( PEM_BEGIN ) - 1U )
+
+/**
+ * @brief End of the header and footer lines of a PEM block.
+ */
+#define PEM_DASHES                 "-----"
+
+/**
+ * @brief Longest label of a PEM block, e.g. "ENCRYPTED PRIVATE KEY".
+ */
+#define PEM_LABEL_MAX_LENGTH       ( 32U )
+
+/**
+ * @brief Size of a buffer holding a header or footer line.
+ */
+#define PEM_BOUNDARY_BUFFER_SIZE   ( PEM_LABEL_MAX_LENGTH + 20U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A credential and the form handed to ESP-TLS.
+ */
+typedef struct CredentialCacheEntry
+{
+    const char * pPem;
+    const char * pCredential;
+    uint32_t credentialLength;
+    bool converted;
+} CredentialCacheEntry_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The cache. Entries are never removed.
+ */
+static CredentialCacheEntry_t cacheEntries[ CREDENTIAL_CACHE_MAX_ENTRIES ];
+
+/**
+ * @brief Number of entries in #cacheEntries.
+ */
+static size_t cacheEntryCount = 0U;
+
+/**
+ * @brief Spinlock protecting #cacheEntries.
+ */
+static portMUX_TYPE cacheEntriesLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decode a credential made of exactly one unencrypted PEM block.
+ *
+ * @param[in] pPem The credential.
+ * @param[in] pemLength Length of @p pPem, including the NUL terminator.
+ * @param[out] ppDer Heap copy of the DER form.
+ * @param[out] pDerLength Length of the DER form.
+ *
+ * @return true if the credential was decoded.
+ */
+static bool decodePem( const char * pPem,
+                       uint32_t pemLength,
+                       char ** ppDer,
+                       uint32_t * pDerLength );
+
+/**
+ * @brief Find the cache entry of a credential. Call with #cacheEntriesLock
+ * held.
+ *
+ * @param[in] pPem The credential.
+ *
+ * @return The entry; NULL if the credential is not cached.
+ */
+static const CredentialCacheEntry_t * findEntry( const char * pPem );
+
+/*-----------------------------------------------------------*/
+
+static bool decodePem( const char * pPem,
+                       uint32_t pemLength,
+                       char ** ppDer,
+                       uint32_t * pDerLength )
+{
+    bool decoded = false;
+    mbedtls_pem_context pemContext;
+    char header[ PEM_BOUNDARY_BUFFER_SIZE ];
+    char footer[ PEM_BOUNDARY_BUFFER_SIZE ];
+    const char * pLabel = NULL;
+    const char * pLabelEnd = NULL;
+    const unsigned char * pDer = NULL;
+    size_t derLength = 0U;
+    size_t usedLength = 0U;
+
+    /* DER credentials are not NUL-terminated. */
+    if( ( pemLength == 0U ) || ( pPem[ pemLength - 1U ] != '\0' ) )
+    {
+        return false;
+    }
+
+    pLabel = strstr( pPem, PEM_BEGIN );
+
+    if( pLabel == NULL )
+    {
+        return false;
+    }
+
+    pLabel += PEM_BEGIN_LENGTH;
+    pLabelEnd = strstr( pLabel, PEM_DASHES );
+
+    if( ( pLabelEnd == NULL ) || ( ( size_t ) ( pLabelEnd - pLabel ) > PEM_LABEL_MAX_LENGTH ) )
+    {
+        return false;
+    }
+
+    ( void ) snprintf( header, sizeof( header ), PEM_BEGIN "%.*s" PEM_DASHES,
+                       ( int ) ( pLabelEnd - pLabel ), pLabel );
+    ( void ) snprintf( footer, sizeof( footer ), "-----END %.*s" PEM_DASHES,
+                       ( int ) ( pLabelEnd - pLabel ), pLabel );
+
+    mbedtls_pem_init( &pemContext );
+
+    /* Encrypted keys fail here, as no password is given, and are left to
+     * ESP-TLS. A chain of certificates cannot be a single DER buffer. */
+    if( ( mbedtls_pem_read_buffer( &pemContext, header, footer,
+                                   ( const unsigned char * ) pPem,
+                                   NULL, 0U, &usedLength ) == 0 ) &&
+        ( strstr( &pPem[ usedLength ], PEM_BEGIN ) == NULL ) )
+    {
+        pDer = mbedtls_pem_get_buffer( &pemContext, &derLength );
+        *ppDer = malloc( derLength );
+
+        if( *ppDer != NULL )
+        {
+            ( void ) memcpy( *ppDer, pDer, derLength );
+            *pDerLength = ( uint32_t ) derLength;
+            decoded = true;
+        }
+    }
+
+    mbedtls_pem_free( &pemContext );
+
+    return decoded;
+}
+
+/*-----------------------------------------------------------*/
+
+static const CredentialCacheEntry_t * findEntry( const char * pPem )
+{
+    const CredentialCacheEntry_t * pEntry = NULL;
+    size_t index = 0U;
+
+    for( index = 0U; index < cacheEntryCount; index++ )
+    {
+        if( cacheEntries[ index ].pPem == pPem )
+        {
+            pEntry = &cacheEntries[ index ];
+            break;
+        }
+    }
+
+    return pEntry;
+}
+
+/*-----------------------------------------------------------*/
+
+CredentialCacheStatus_t CredentialCache_GetDer( const char * pPem,
+                                                uint32_t pemLength,
+                                                const char ** ppCredential,
+                                                uint32_t * pCredentialLength )
+{
+    CredentialCacheStatus_t status = CredentialCacheNotConverted;
+    const CredentialCacheEntry_t * pEntry = NULL;
+    char * pDer = NULL;
+    uint32_t derLength = 0U;
+    bool converted = false;
+
+    if( ( pPem == NULL ) || ( ppCredential == NULL ) || ( pCredentialLength == NULL ) )
+    {
+        return CredentialCacheBadParameter;
+    }
+
+    portENTER_CRITICAL( &cacheEntriesLock );
+    pEntry = findEntry( pPem );
+    portEXIT_CRITICAL( &cacheEntriesLock );
+
+    if( pEntry == NULL )
+    {
+        /* Decode outside the lock; if another task cached the credential
+         * meanwhile, its copy is kept. */
+        converted = decodePem( pPem, pemLength, &pDer, &derLength );
+
+        portENTER_CRITICAL( &cacheEntriesLock );
+        pEntry = findEntry( pPem );
+
+        if( ( pEntry == NULL ) && ( cacheEntryCount < CREDENTIAL_CACHE_MAX_ENTRIES ) )
+        {
+            cacheEntries[ cacheEntryCount ].pPem = pPem;
+            cacheEntries[ cacheEntryCount ].pCredential = converted ? pDer : pPem;
+            cacheEntries[ cacheEntryCount ].credentialLength = converted ? derLength : pemLength;
+            cacheEntries[ cacheEntryCount ].converted = converted;
+            pEntry = &cacheEntries[ cacheEntryCount ];
+            cacheEntryCount++;
+            pDer = NULL;
+        }
+
+        portEXIT_CRITICAL( &cacheEntriesLock );
+
+        free( pDer );
+    }
+
+    if( ( pEntry != NULL ) && pEntry->converted )
+    {
+        *ppCredential = pEntry->pCredential;
+        *pCredentialLength = pEntry->credentialLength;
+        status = CredentialCacheSuccess;
+    }
+    else
+    {
+        *ppCredential = pPem;
+        *pCredentialLength = pemLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,80 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file credential_cache.h
+ *
+ * @brief DER form of the PEM credentials embedded in the firmware, decoded
+ * once and kept for the lifetime of the program.
+ *
+ * ESP-TLS parses the credentials it is given on every handshake. Handing it
+ * DER instead of PEM saves the base64 decoding and the temporary buffer it
+ * needs on every connection and retry.
+ */
+
+#ifndef CREDENTIAL_CACHE_H_
+#define CREDENTIAL_CACHE_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Maximum number of credentials in the cache.
+ */
+#ifndef CREDENTIAL_CACHE_MAX_ENTRIES
+    #define CREDENTIAL_CACHE_MAX_ENTRIES    ( 4U )
+#endif
+
+/**
+ * @brief Return codes of the cache functions.
+ */
+typedef enum CredentialCacheStatus
+{
+    CredentialCacheSuccess = 0,     /**< The DER form was returned. */
+    CredentialCacheBadParameter,    /**< A parameter was NULL. */
+    CredentialCacheNotConverted     /**< The credential was returned unchanged. */
+} CredentialCacheStatus_t;
+
+/**
+ * @brief Get the DER form of a PEM credential that stays in place for the
+ * lifetime of the program, such as one embedded with
+ * target_add_binary_data().
+ *
+ * The credential is decoded on the first call and later calls return the
+ * cached copy. Credentials that are not exactly one unencrypted PEM block,
+ * such as a chain of CA certificates, or that are already DER, are
+ * returned unchanged; ESP-TLS accepts both forms.
+ *
+ * @param[in] pPem The credential. Used as the cache key.
+ * @param[in] pemLength Length of @p pPem, including the NUL terminator of a
+ * PEM credential.
+ * @param[out] ppCredential The credential to hand to ESP-TLS.
+ * @param[out] pCredentialLength Its length.
+ *
+ * @return CredentialCacheSuccess; CredentialCacheNotConverted if the
+ * credential is returned unchanged; CredentialCacheBadParameter.
+ */
+CredentialCacheStatus_t CredentialCache_GetDer( const char * pPem,
+                                                uint32_t pemLength,
+                                                const char ** ppCredential,
+                                                uint32_t * pCredentialLength );
+
+#endif /* ifndef CREDENTIAL_CACHE_H_ */
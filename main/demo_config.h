@@ -115,16 +115,28 @@
 #define MQTT_LIB    "core-mqtt@" MQTT_LIBRARY_VERSION
 
 /**
- * @brief Predefined thing name.
+ * @brief Time after which the resolved address of the broker is looked up
+ * again. Until the new lookup completes, the previous address is used.
+ */
+#define ENDPOINT_RESOLVER_TTL_MS         ( CONFIG_EXAMPLE_DNS_CACHE_TTL_S * 1000U )
+
+/**
+ * @brief Comma-separated names of the things whose shadows are synced over
+ * the MQTT connection. The names are parsed at run time.
  *
- * This is the example predefine thing name and could be compiled in ROM code.
+ * If empty, only the thing named like #CLIENT_IDENTIFIER is synced.
+ */
+#define SHADOW_THING_NAMES               CONFIG_EXAMPLE_SHADOW_THING_NAMES
+
+/**
+ * @brief Maximum number of things served over the MQTT connection.
  */
-#define THING_NAME           CONFIG_MQTT_CLIENT_IDENTIFIER
+#define SHADOW_THING_TABLE_MAX_THINGS    ( CONFIG_EXAMPLE_SHADOW_MAX_THINGS )
 
 /**
- * @brief The length of #THING_NAME.
+ * @brief Size of the pool holding the shadow topics of all things.
  */
-#define THING_NAME_LENGTH    ( ( uint16_t ) ( sizeof( THING_NAME ) - 1 ) )
+#define SHADOW_THING_TABLE_POOL_SIZE     ( CONFIG_EXAMPLE_SHADOW_TOPIC_POOL_SIZE )
 
 /**
  * @brief Predefined shadow name.
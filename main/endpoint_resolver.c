@@ -0,0 +1,373 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file endpoint_resolver.c
+ *
+ * @brief Cache of the resolved addresses of broker endpoints, filled by
+ * lookups that run in the background.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+/* lwIP includes. */
+#include "lwip/dns.h"
+#include "lwip/tcpip.h"
+
+/* Demo configuration, which sizes the cache. */
+#include "demo_config.h"
+
+#include "endpoint_resolver.h"
+
+/**
+ * @brief Event bit set when the lookup of an entry completes.
+ */
+#define LOOKUP_DONE_BIT    ( ( EventBits_t ) 1U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A cached host name and its address.
+ */
+typedef struct ResolverEntry
+{
+    char hostName[ ENDPOINT_RESOLVER_HOST_NAME_MAX_LENGTH + 1U ];
+    bool inUse;
+    bool hasAddress;
+    bool lookupRunning;
+    ip_addr_t address;
+
+    /**
+     * @brief Tick count at which #address was resolved.
+     */
+    TickType_t resolvedAt;
+
+    /**
+     * @brief #LOOKUP_DONE_BIT is cleared while a lookup is running.
+     */
+    EventGroupHandle_t lookupDone;
+    StaticEventGroup_t lookupDoneBuffer;
+} ResolverEntry_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The cache. Entries are never removed, so the lwIP callbacks can
+ * refer to them at any time.
+ */
+static ResolverEntry_t resolverEntries[ ENDPOINT_RESOLVER_MAX_HOSTS ];
+
+/**
+ * @brief Spinlock protecting #resolverEntries, which are updated from the
+ * lwIP thread.
+ */
+static portMUX_TYPE resolverEntriesLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the entry of a host name, adding it if it is not cached.
+ *
+ * @param[in] pHostName NUL-terminated host name.
+ * @param[out] ppEntry The entry.
+ *
+ * @return EndpointResolverSuccess; EndpointResolverBadParameter or
+ * EndpointResolverNoMemory.
+ */
+static EndpointResolverStatus_t findEntry( const char * pHostName,
+                                           ResolverEntry_t ** ppEntry );
+
+/**
+ * @brief Start a lookup for an entry unless its address is fresh or a lookup
+ * is running.
+ *
+ * @param[in] pEntry The entry.
+ *
+ * @return EndpointResolverSuccess; EndpointResolverFailed if the lookup
+ * could not be handed to the lwIP thread.
+ */
+static EndpointResolverStatus_t startLookup( ResolverEntry_t * pEntry );
+
+/**
+ * @brief Run a lookup in the lwIP thread, as the lwIP resolver requires.
+ *
+ * @param[in] pContext The entry.
+ */
+static void lookupInTcpipThread( void * pContext );
+
+/**
+ * @brief Record the result of a lookup.
+ *
+ * @param[in] pName The host name.
+ * @param[in] pIpAddress The address; NULL if the lookup failed.
+ * @param[in] pCallbackArg The entry.
+ */
+static void lookupDone( const char * pName,
+                        const ip_addr_t * pIpAddress,
+                        void * pCallbackArg );
+
+/**
+ * @brief Whether the address of an entry is older than
+ * #ENDPOINT_RESOLVER_TTL_MS. Call with #resolverEntriesLock held.
+ *
+ * @param[in] pEntry The entry.
+ *
+ * @return true if the address is stale.
+ */
+static bool isStale( const ResolverEntry_t * pEntry );
+
+/*-----------------------------------------------------------*/
+
+static EndpointResolverStatus_t findEntry( const char * pHostName,
+                                           ResolverEntry_t ** ppEntry )
+{
+    EndpointResolverStatus_t status = EndpointResolverNoMemory;
+    ResolverEntry_t * pFree = NULL;
+    size_t hostNameLength = 0U;
+    size_t index = 0U;
+
+    if( pHostName == NULL )
+    {
+        return EndpointResolverBadParameter;
+    }
+
+    hostNameLength = strlen( pHostName );
+
+    if( ( hostNameLength == 0U ) || ( hostNameLength > ENDPOINT_RESOLVER_HOST_NAME_MAX_LENGTH ) )
+    {
+        return EndpointResolverBadParameter;
+    }
+
+    portENTER_CRITICAL( &resolverEntriesLock );
+
+    for( index = 0U; index < ENDPOINT_RESOLVER_MAX_HOSTS; index++ )
+    {
+        if( !resolverEntries[ index ].inUse )
+        {
+            if( pFree == NULL )
+            {
+                pFree = &resolverEntries[ index ];
+            }
+        }
+        else if( strcmp( resolverEntries[ index ].hostName, pHostName ) == 0 )
+        {
+            *ppEntry = &resolverEntries[ index ];
+            status = EndpointResolverSuccess;
+            break;
+        }
+    }
+
+    if( ( status != EndpointResolverSuccess ) && ( pFree != NULL ) )
+    {
+        ( void ) memcpy( pFree->hostName, pHostName, hostNameLength + 1U );
+        pFree->hasAddress = false;
+        pFree->lookupRunning = false;
+        pFree->lookupDone = xEventGroupCreateStatic( &pFree->lookupDoneBuffer );
+        pFree->inUse = true;
+        *ppEntry = pFree;
+        status = EndpointResolverSuccess;
+    }
+
+    portEXIT_CRITICAL( &resolverEntriesLock );
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static EndpointResolverStatus_t startLookup( ResolverEntry_t * pEntry )
+{
+    EndpointResolverStatus_t status = EndpointResolverSuccess;
+    bool start = false;
+
+    portENTER_CRITICAL( &resolverEntriesLock );
+
+    if( !pEntry->lookupRunning && ( !pEntry->hasAddress || isStale( pEntry ) ) )
+    {
+        pEntry->lookupRunning = true;
+        start = true;
+    }
+
+    portEXIT_CRITICAL( &resolverEntriesLock );
+
+    if( start )
+    {
+        ( void ) xEventGroupClearBits( pEntry->lookupDone, LOOKUP_DONE_BIT );
+
+        if( tcpip_callback( lookupInTcpipThread, pEntry ) != ERR_OK )
+        {
+            lookupDone( pEntry->hostName, NULL, pEntry );
+            status = EndpointResolverFailed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void lookupInTcpipThread( void * pContext )
+{
+    ResolverEntry_t * pEntry = ( ResolverEntry_t * ) pContext;
+    ip_addr_t address;
+    err_t lwipStatus = ERR_OK;
+
+    /* Answered from the lwIP cache if the DNS record has not expired;
+     * otherwise lookupDone is called once the query completes. */
+    lwipStatus = dns_gethostbyname( pEntry->hostName, &address, lookupDone, pEntry );
+
+    if( lwipStatus == ERR_OK )
+    {
+        lookupDone( pEntry->hostName, &address, pEntry );
+    }
+    else if( lwipStatus != ERR_INPROGRESS )
+    {
+        lookupDone( pEntry->hostName, NULL, pEntry );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void lookupDone( const char * pName,
+                        const ip_addr_t * pIpAddress,
+                        void * pCallbackArg )
+{
+    ResolverEntry_t * pEntry = ( ResolverEntry_t * ) pCallbackArg;
+
+    ( void ) pName;
+
+    portENTER_CRITICAL( &resolverEntriesLock );
+
+    /* A failed lookup keeps the previous address, if any. */
+    if( pIpAddress != NULL )
+    {
+        ip_addr_copy( pEntry->address, *pIpAddress );
+        pEntry->resolvedAt = xTaskGetTickCount();
+        pEntry->hasAddress = true;
+    }
+
+    pEntry->lookupRunning = false;
+
+    portEXIT_CRITICAL( &resolverEntriesLock );
+
+    ( void ) xEventGroupSetBits( pEntry->lookupDone, LOOKUP_DONE_BIT );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isStale( const ResolverEntry_t * pEntry )
+{
+    /* Compared in milliseconds, pdMS_TO_TICKS() of a long TTL overflows
+     * TickType_t. */
+    return( ( ( uint64_t ) ( TickType_t ) ( xTaskGetTickCount() - pEntry->resolvedAt ) * portTICK_PERIOD_MS ) >=
+            ( uint64_t ) ENDPOINT_RESOLVER_TTL_MS );
+}
+
+/*-----------------------------------------------------------*/
+
+EndpointResolverStatus_t EndpointResolver_Prefetch( const char * pHostName )
+{
+    EndpointResolverStatus_t status = EndpointResolverSuccess;
+    ResolverEntry_t * pEntry = NULL;
+
+    status = findEntry( pHostName, &pEntry );
+
+    if( status == EndpointResolverSuccess )
+    {
+        status = startLookup( pEntry );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+EndpointResolverStatus_t EndpointResolver_Wait( const char * pHostName,
+                                                uint32_t timeoutMs,
+                                                ip_addr_t * pAddress,
+                                                bool * pIsStale )
+{
+    EndpointResolverStatus_t status = EndpointResolverSuccess;
+    ResolverEntry_t * pEntry = NULL;
+    EventBits_t bits = 0U;
+    bool hasAddress = false;
+
+    status = findEntry( pHostName, &pEntry );
+
+    if( status == EndpointResolverSuccess )
+    {
+        /* Refresh a stale address in the background. */
+        ( void ) startLookup( pEntry );
+
+        portENTER_CRITICAL( &resolverEntriesLock );
+        hasAddress = pEntry->hasAddress;
+        portEXIT_CRITICAL( &resolverEntriesLock );
+
+        if( !hasAddress )
+        {
+            bits = xEventGroupWaitBits( pEntry->lookupDone,
+                                        LOOKUP_DONE_BIT,
+                                        pdFALSE,
+                                        pdTRUE,
+                                        pdMS_TO_TICKS( timeoutMs ) );
+
+            if( ( bits & LOOKUP_DONE_BIT ) == 0U )
+            {
+                status = EndpointResolverTimeout;
+            }
+        }
+    }
+
+    if( status == EndpointResolverSuccess )
+    {
+        portENTER_CRITICAL( &resolverEntriesLock );
+
+        if( pEntry->hasAddress )
+        {
+            if( pAddress != NULL )
+            {
+                ip_addr_copy( *pAddress, pEntry->address );
+            }
+
+            if( pIsStale != NULL )
+            {
+                *pIsStale = isStale( pEntry );
+            }
+        }
+        else
+        {
+            status = EndpointResolverFailed;
+        }
+
+        portEXIT_CRITICAL( &resolverEntriesLock );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
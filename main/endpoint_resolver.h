@@ -0,0 +1,115 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file endpoint_resolver.h
+ *
+ * @brief Cache of the resolved addresses of broker endpoints, filled by
+ * lookups that run in the background.
+ *
+ * A lookup is started with #EndpointResolver_Prefetch before the work that
+ * precedes a connection, e.g. loading credentials, and is collected with
+ * #EndpointResolver_Wait right before connecting, so that the two overlap.
+ * The lookup goes through the lwIP resolver, which keeps the answer for the
+ * TTL of the DNS record, so the lookup ESP-TLS does when it connects by host
+ * name is answered from the lwIP cache.
+ *
+ * An address older than #ENDPOINT_RESOLVER_TTL_MS is still returned while it
+ * is looked up again in the background, and is kept if that lookup fails.
+ */
+
+#ifndef ENDPOINT_RESOLVER_H_
+#define ENDPOINT_RESOLVER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* lwIP address type. */
+#include "lwip/ip_addr.h"
+
+/**
+ * @brief Maximum number of host names in the cache.
+ */
+#ifndef ENDPOINT_RESOLVER_MAX_HOSTS
+    #define ENDPOINT_RESOLVER_MAX_HOSTS             ( 4U )
+#endif
+
+/**
+ * @brief Maximum length of a cached host name.
+ */
+#ifndef ENDPOINT_RESOLVER_HOST_NAME_MAX_LENGTH
+    #define ENDPOINT_RESOLVER_HOST_NAME_MAX_LENGTH  ( 128U )
+#endif
+
+/**
+ * @brief Time after which a resolved address is looked up again.
+ */
+#ifndef ENDPOINT_RESOLVER_TTL_MS
+    #define ENDPOINT_RESOLVER_TTL_MS                ( 60000U )
+#endif
+
+/**
+ * @brief Return codes of the resolver functions.
+ */
+typedef enum EndpointResolverStatus
+{
+    EndpointResolverSuccess = 0,  /**< An address is available. */
+    EndpointResolverBadParameter, /**< A parameter was NULL or the host name too long. */
+    EndpointResolverNoMemory,     /**< The cache has no room for another host name. */
+    EndpointResolverTimeout,      /**< The lookup did not complete in time. */
+    EndpointResolverFailed        /**< The host name could not be resolved. */
+} EndpointResolverStatus_t;
+
+/**
+ * @brief Start looking up a host name unless a fresh address is cached or a
+ * lookup is already running. Does not block.
+ *
+ * @param[in] pHostName NUL-terminated host name. Copied into the cache.
+ *
+ * @return EndpointResolverSuccess if the lookup is running or not needed;
+ * EndpointResolverBadParameter, EndpointResolverNoMemory or
+ * EndpointResolverFailed otherwise.
+ */
+EndpointResolverStatus_t EndpointResolver_Prefetch( const char * pHostName );
+
+/**
+ * @brief Get the address of a host name, waiting for a running lookup if no
+ * address is cached yet.
+ *
+ * Starts a lookup like #EndpointResolver_Prefetch if none was started. A
+ * stale address is returned without waiting.
+ *
+ * @param[in] pHostName NUL-terminated host name.
+ * @param[in] timeoutMs Longest time to wait for the lookup.
+ * @param[out] pAddress The address. May be NULL.
+ * @param[out] pIsStale Whether the address is older than
+ * #ENDPOINT_RESOLVER_TTL_MS. May be NULL.
+ *
+ * @return EndpointResolverSuccess if an address was returned;
+ * EndpointResolverTimeout or EndpointResolverFailed if not.
+ */
+EndpointResolverStatus_t EndpointResolver_Wait( const char * pHostName,
+                                                uint32_t timeoutMs,
+                                                ip_addr_t * pAddress,
+                                                bool * pIsStale );
+
+#endif /* ifndef ENDPOINT_RESOLVER_H_ */
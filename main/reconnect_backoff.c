@@ -0,0 +1,154 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_backoff.c
+ *
+ * @brief Reconnection delays with decorrelated jitter.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <stddef.h>
+
+/* Hardware random number generator. */
+#include "esp_random.h"
+
+#include "reconnect_backoff.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Draw a random number in [@p low, @p high].
+ *
+ * @param[in] low Lower bound.
+ * @param[in] high Upper bound, not less than @p low.
+ *
+ * @return The random number.
+ */
+static uint32_t randomBetween( uint32_t low,
+                               uint32_t high );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t randomBetween( uint32_t low,
+                               uint32_t high )
+{
+    uint32_t range = high - low;
+
+    /* The modulo bias is negligible for delays far below 2^32 ms. */
+    return( ( range == UINT32_MAX ) ? esp_random() : ( low + ( esp_random() % ( range + 1U ) ) ) );
+}
+
+/*-----------------------------------------------------------*/
+
+void ReconnectBackoff_Init( ReconnectBackoff_t * pBackoff,
+                            uint32_t baseDelayMs,
+                            uint32_t maxDelayMs,
+                            uint32_t maxAttempts )
+{
+    assert( pBackoff != NULL );
+    assert( baseDelayMs <= maxDelayMs );
+
+    pBackoff->baseDelayMs = baseDelayMs;
+    pBackoff->maxDelayMs = maxDelayMs;
+    pBackoff->maxAttempts = maxAttempts;
+    ReconnectBackoff_Reset( pBackoff );
+}
+
+/*-----------------------------------------------------------*/
+
+void ReconnectBackoff_Reset( ReconnectBackoff_t * pBackoff )
+{
+    assert( pBackoff != NULL );
+
+    pBackoff->attemptsDone = 0U;
+    pBackoff->previousDelayMs = pBackoff->baseDelayMs;
+    pBackoff->hintedDelayMs = 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+ReconnectBackoffStatus_t ReconnectBackoff_GetNextDelay( ReconnectBackoff_t * pBackoff,
+                                                        uint32_t * pDelayMs )
+{
+    ReconnectBackoffStatus_t status = ReconnectBackoffSuccess;
+    uint32_t upperMs = 0U;
+    uint32_t delayMs = 0U;
+
+    assert( pBackoff != NULL );
+    assert( pDelayMs != NULL );
+
+    if( ( pBackoff->maxAttempts != RECONNECT_BACKOFF_RETRY_FOREVER ) &&
+        ( pBackoff->attemptsDone >= pBackoff->maxAttempts ) )
+    {
+        status = ReconnectBackoffRetriesExhausted;
+    }
+    else if( pBackoff->hintedDelayMs > 0U )
+    {
+        delayMs = pBackoff->hintedDelayMs;
+        delayMs = randomBetween( delayMs, ( delayMs > ( UINT32_MAX / 2U ) ) ? delayMs : ( delayMs + ( delayMs / 2U ) ) );
+        pBackoff->hintedDelayMs = 0U;
+    }
+    else
+    {
+        /* Decorrelated jitter: between the base and three times the
+         * previous delay. */
+        upperMs = ( pBackoff->previousDelayMs > ( pBackoff->maxDelayMs / 3U ) ) ?
+                  pBackoff->maxDelayMs : ( pBackoff->previousDelayMs * 3U );
+        delayMs = randomBetween( pBackoff->baseDelayMs, upperMs );
+    }
+
+    if( status == ReconnectBackoffSuccess )
+    {
+        /* A long hinted delay must not make every later delay long. */
+        pBackoff->previousDelayMs = ( delayMs > pBackoff->maxDelayMs ) ? pBackoff->maxDelayMs : delayMs;
+        pBackoff->attemptsDone++;
+        *pDelayMs = delayMs;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void ReconnectBackoff_SetServerHint( ReconnectBackoff_t * pBackoff,
+                                     uint32_t delayMs )
+{
+    assert( pBackoff != NULL );
+
+    if( delayMs > pBackoff->hintedDelayMs )
+    {
+        pBackoff->hintedDelayMs = delayMs;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ReconnectBackoff_GetAttempts( const ReconnectBackoff_t * pBackoff )
+{
+    assert( pBackoff != NULL );
+
+    return pBackoff->attemptsDone;
+}
+
+/*-----------------------------------------------------------*/
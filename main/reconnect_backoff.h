@@ -0,0 +1,125 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file reconnect_backoff.h
+ *
+ * @brief Reconnection delays with decorrelated jitter.
+ *
+ * Each delay is drawn uniformly between the base delay and three times the
+ * previous delay, and capped. Unlike exponential backoff with full jitter,
+ * the delays of devices that lost the broker at the same moment drift
+ * apart from the first retry on, so a fleet does not reconnect in waves,
+ * while a single device still retries within a second or two at first.
+ * Random numbers come from the hardware random number generator, so
+ * devices booted at the same time do not share a sequence.
+ */
+
+#ifndef RECONNECT_BACKOFF_H_
+#define RECONNECT_BACKOFF_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Value of the maximum number of attempts for retrying forever.
+ */
+#define RECONNECT_BACKOFF_RETRY_FOREVER    ( 0U )
+
+/**
+ * @brief Return codes of #ReconnectBackoff_GetNextDelay.
+ */
+typedef enum ReconnectBackoffStatus
+{
+    ReconnectBackoffSuccess = 0,    /**< A delay was returned. */
+    ReconnectBackoffRetriesExhausted /**< All attempts were made. */
+} ReconnectBackoffStatus_t;
+
+/**
+ * @brief Backoff state. Treat as opaque.
+ */
+typedef struct ReconnectBackoff
+{
+    uint32_t baseDelayMs;
+    uint32_t maxDelayMs;
+    uint32_t maxAttempts;
+    uint32_t attemptsDone;
+    uint32_t previousDelayMs;
+    uint32_t hintedDelayMs;
+} ReconnectBackoff_t;
+
+/**
+ * @brief Prepare the backoff state.
+ *
+ * @param[out] pBackoff The backoff state.
+ * @param[in] baseDelayMs Shortest delay.
+ * @param[in] maxDelayMs Longest delay.
+ * @param[in] maxAttempts Number of retries, or
+ * #RECONNECT_BACKOFF_RETRY_FOREVER.
+ */
+void ReconnectBackoff_Init( ReconnectBackoff_t * pBackoff,
+                            uint32_t baseDelayMs,
+                            uint32_t maxDelayMs,
+                            uint32_t maxAttempts );
+
+/**
+ * @brief Start over from the base delay, e.g. once connected.
+ *
+ * @param[in] pBackoff The backoff state.
+ */
+void ReconnectBackoff_Reset( ReconnectBackoff_t * pBackoff );
+
+/**
+ * @brief Get the delay before the next retry.
+ *
+ * @param[in] pBackoff The backoff state.
+ * @param[out] pDelayMs The delay.
+ *
+ * @return ReconnectBackoffSuccess; ReconnectBackoffRetriesExhausted if the
+ * maximum number of attempts was reached.
+ */
+ReconnectBackoffStatus_t ReconnectBackoff_GetNextDelay( ReconnectBackoff_t * pBackoff,
+                                                        uint32_t * pDelayMs );
+
+/**
+ * @brief Make the next delay at least @p delayMs, e.g. because the server
+ * asked clients to back off.
+ *
+ * The hinted delay is stretched by a random amount of up to half of it, so
+ * that devices given the same hint do not return together. It may exceed
+ * the longest delay. Later delays decorrelate from the hinted one.
+ *
+ * @param[in] pBackoff The backoff state.
+ * @param[in] delayMs The hinted delay.
+ */
+void ReconnectBackoff_SetServerHint( ReconnectBackoff_t * pBackoff,
+                                     uint32_t delayMs );
+
+/**
+ * @brief Number of retries since the last reset.
+ *
+ * @param[in] pBackoff The backoff state.
+ *
+ * @return The number of delays handed out.
+ */
+uint32_t ReconnectBackoff_GetAttempts( const ReconnectBackoff_t * pBackoff );
+
+#endif /* ifndef RECONNECT_BACKOFF_H_ */
@@ -34,9 +34,9 @@
 
 /* Standard includes. */
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 /* Shadow includes */
 #include "shadow_demo_helpers.h"
@@ -47,16 +47,37 @@
 /* OpenSSL sockets transport implementation. */
 #include "network_transport.h"
 
-/*Include backoff algorithm header for retry logic.*/
-#include "backoff_algorithm.h"
+/* Decorrelated-jitter backoff for retry logic. */
+#include "reconnect_backoff.h"
 
 /* Clock for timer. */
 #include "clock.h"
 
+/* Background resolution of the broker host name. */
+#include "endpoint_resolver.h"
+
+#ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
+    /* Race between the MQTT over TLS port and port 443. */
+    #include "connection_racer.h"
+#endif
+
 #ifdef CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR
     #include "esp_secure_cert_read.h"    
 #endif
 
+/* DER form of the embedded credentials. */
+#include "credential_cache.h"
+
+/* Heap statistics. */
+#include "esp_heap_caps.h"
+
+#ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+    /* Batching of small writes into one TLS record. */
+    #include "tls_write_coalescer.h"
+    #include "esp_tls.h"
+    #include "lwip/sockets.h"
+#endif
+
 /**
  * These configuration settings are required to run the shadow demo.
  * Throw compilation error if the below configs are not defined.
@@ -96,32 +117,86 @@ extern const char root_cert_auth_end[]   asm("_binary_root_cert_auth_crt_end");
  */
 #define ALPN_PROTOCOL_NAME_LENGTH    ( ( uint16_t ) ( sizeof( ALPN_PROTOCOL_NAME ) - 1 ) )
 
+/**
+ * @brief Port of MQTT over TLS.
+ */
+#define MQTT_TLS_PORT                ( 8883U )
+
+/**
+ * @brief Port of MQTT over TLS with the #ALPN_PROTOCOL_NAME ALPN protocol,
+ * for networks that block #MQTT_TLS_PORT.
+ */
+#define MQTT_ALPN_PORT               ( 443U )
+
 
 /**
- * @brief The maximum number of retries for connecting to server.
+ * @brief The maximum number of retries for connecting to server, or
+ * #RECONNECT_BACKOFF_RETRY_FOREVER.
  */
-#define CONNECTION_RETRY_MAX_ATTEMPTS            ( 5U )
+#define CONNECTION_RETRY_MAX_ATTEMPTS            ( CONFIG_EXAMPLE_RECONNECT_MAX_ATTEMPTS )
 
 /**
  * @brief The maximum back-off delay (in milliseconds) for retrying connection to server.
  */
-#define CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS    ( 5000U )
+#define CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS    ( CONFIG_EXAMPLE_RECONNECT_MAX_DELAY_S * 1000U )
 
 /**
  * @brief The base back-off delay (in milliseconds) to use for connection retry attempts.
  */
-#define CONNECTION_RETRY_BACKOFF_BASE_MS         ( 500U )
+#define CONNECTION_RETRY_BACKOFF_BASE_MS         ( CONFIG_EXAMPLE_RECONNECT_BASE_DELAY_MS )
 
 /**
  * @brief Timeout for receiving CONNACK packet in milli seconds.
  */
 #define CONNACK_RECV_TIMEOUT_MS                  ( 1000U )
 
+/**
+ * @brief Longest time to wait for the broker host name to be resolved once
+ * the credentials are loaded. If it is not resolved by then, the lookup
+ * continues inside #xTlsConnect.
+ */
+#define ENDPOINT_RESOLVE_TIMEOUT_MS              ( 5000U )
+
+/**
+ * @brief Longest time a race between #MQTT_TLS_PORT and #MQTT_ALPN_PORT may
+ * take.
+ */
+#define CONNECTION_RACE_TIMEOUT_MS               ( 3000U )
+
+#ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+
+/**
+ * @brief Size of the buffer in which small writes are batched into one TLS
+ * record.
+ */
+    #define TLS_WRITE_COALESCING_BUFFER_SIZE    ( CONFIG_EXAMPLE_TLS_WRITE_COALESCING_BUFFER_SIZE )
+
+/**
+ * @brief Longest time a write is held back for others to join it.
+ */
+    #define TLS_WRITE_COALESCING_WINDOW_MS      ( CONFIG_EXAMPLE_TLS_WRITE_COALESCING_WINDOW_MS )
+#endif
+
+/**
+ * @brief Name of the TLS connection profile, which sets the cipher suites
+ * mbedTLS offers. See EXAMPLE_TLS_PROFILE in Kconfig.projbuild.
+ */
+#if defined( CONFIG_EXAMPLE_TLS_PROFILE_ECDHE_AES128_GCM )
+    #define TLS_PROFILE_NAME    "ECDHE AES-128-GCM"
+#elif defined( CONFIG_EXAMPLE_TLS_PROFILE_RSA_AES128_GCM )
+    #define TLS_PROFILE_NAME    "RSA AES-128-GCM"
+#else
+    #define TLS_PROFILE_NAME    "mbedTLS defaults"
+#endif
+
 /**
  * @brief Maximum number of outgoing publishes maintained in the application
  * until an ack is received from the broker.
+ *
+ * This is the upper bound of the RTT-adaptive in-flight window and must not
+ * exceed #OUTGOING_PUBLISH_RECORD_LEN.
  */
-#define MAX_OUTGOING_PUBLISHES              ( 5U )
+#define MAX_OUTGOING_PUBLISHES              ( 10U )
 
 /**
  * @brief Invalid packet identifier for the MQTT packets. Zero is always an
@@ -172,6 +247,71 @@ extern const char root_cert_auth_end[]   asm("_binary_root_cert_auth_crt_end");
  */
 #define INCOMING_PUBLISH_RECORD_LEN         ( 10U )
 
+/**
+ * @brief Number of publishes that can wait in each outbound priority lane.
+ */
+#define OUTBOUND_LANE_LENGTH                ( 8U )
+
+/**
+ * @brief Timeout for the process loop run after each packet sent from the
+ * outbound queue.
+ *
+ * It is kept short so that incoming deltas, and any urgent acknowledgement
+ * they trigger, are seen before the next queued packet is picked.
+ */
+#define OUTBOUND_PROCESS_LOOP_TIMEOUT_MS    ( 10U )
+
+/**
+ * @brief Number of unacked publishes resent in the first round after a
+ * session is resumed.
+ */
+#define RESEND_INITIAL_WINDOW               ( 1U )
+
+/**
+ * @brief Gap in milliseconds between two resent publishes of one round.
+ *
+ * The process loop runs during the gap, so early PUBACKs are collected.
+ */
+#define RESEND_PACING_INTERVAL_MS           ( 50U )
+
+/**
+ * @brief Maximum time in milliseconds to wait for the PUBACKs of one resend
+ * round before the round is considered to have timed out.
+ */
+#define RESEND_ROUND_TIMEOUT_MS( pClient )    ( getAckTimeoutMs( pClient ) )
+
+/**
+ * @brief Number of unacked QoS1 publishes allowed before the first RTT
+ * sample is taken.
+ */
+#define INFLIGHT_WINDOW_INITIAL             ( 2U )
+
+/**
+ * @brief Lower bound of the RTT-derived ACK timeout in milliseconds.
+ */
+#define ACK_TIMEOUT_MIN_MS                  ( 200U )
+
+/**
+ * @brief Upper bound of the RTT-derived ACK timeout in milliseconds.
+ */
+#define ACK_TIMEOUT_MAX_MS                  ( 10000U )
+
+/**
+ * @brief Longest topic name of a streamed incoming publish.
+ */
+#define STREAMING_TOPIC_MAX_LENGTH          ( 256U )
+
+/**
+ * @brief Longest encoding of the MQTT fixed header: the packet type byte and
+ * up to four remaining length bytes.
+ */
+#define MQTT_FIXED_HEADER_MAX_LENGTH        ( 5U )
+
+/**
+ * @brief Number of clients that can exist at the same time.
+ */
+#define MQTT_CLIENT_POOL_SIZE               ( CONFIG_EXAMPLE_MQTT_CLIENT_POOL_SIZE )
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -189,375 +329,1563 @@ typedef struct PublishPackets
      * @brief Publish info of the publish packet.
      */
     MQTTPublishInfo_t pubInfo;
+
+    /**
+     * @brief Time in milliseconds at which the publish was last sent.
+     */
+    uint32_t sentTimeMs;
+
+    /**
+     * @brief Set once the publish has been waiting longer than the ACK
+     * timeout, so that a single late PUBACK shrinks the window only once.
+     */
+    bool timedOut;
 } PublishPackets_t;
 
-/*-----------------------------------------------------------*/
+/**
+ * @brief Smoothed PUBLISH to PUBACK round trip time and the values derived
+ * from it, following the retransmission timer computation of RFC 6298.
+ */
+typedef struct RttEstimator
+{
+    /**
+     * @brief Smoothed round trip time in milliseconds.
+     */
+    uint32_t smoothedRttMs;
+
+    /**
+     * @brief Round trip time variation in milliseconds.
+     */
+    uint32_t rttVarianceMs;
+
+    /**
+     * @brief Timeout for waiting on an ACK, in milliseconds.
+     */
+    uint32_t ackTimeoutMs;
+
+    /**
+     * @brief Number of QoS1 publishes allowed to wait for a PUBACK.
+     */
+    uint8_t inFlightWindow;
+
+    /**
+     * @brief Whether a round trip time sample has been taken yet.
+     */
+    bool hasSample;
+} RttEstimator_t;
 
 /**
- * @brief Packet Identifier updated when an ACK packet is received.
- *
- * It is used to match an expected ACK for a transmitted packet.
+ * @brief A publish waiting in an outbound priority lane.
  */
-static uint16_t globalAckPacketIdentifier = 0U;
+typedef struct OutboundPublish
+{
+    /**
+     * @brief Topic of the queued publish.
+     */
+    const char * pTopicName;
+
+    /**
+     * @brief Length of the topic.
+     */
+    uint16_t topicNameLength;
+
+    /**
+     * @brief Payload of the queued publish.
+     */
+    const char * pPayload;
+
+    /**
+     * @brief Length of the payload.
+     */
+    size_t payloadLength;
+
+    /**
+     * @brief QoS the publish is sent with.
+     */
+    MQTTQoS_t qos;
+} OutboundPublish_t;
 
 /**
- * @brief Packet Identifier generated when Subscribe request was sent to the broker;
- * it is used to match received Subscribe ACK to the transmitted subscribe.
+ * @brief Ring buffer holding the queued publishes of one priority.
  */
-static uint16_t globalSubscribePacketIdentifier = 0U;
+typedef struct OutboundLane
+{
+    /**
+     * @brief Storage for the queued publishes.
+     */
+    OutboundPublish_t entries[ OUTBOUND_LANE_LENGTH ];
+
+    /**
+     * @brief Index of the oldest queued publish.
+     */
+    uint8_t head;
+
+    /**
+     * @brief Number of queued publishes.
+     */
+    uint8_t count;
+} OutboundLane_t;
 
 /**
- * @brief Packet Identifier generated when Unsubscribe request was sent to the broker;
- * it is used to match received Unsubscribe ACK to the transmitted unsubscribe
- * request.
+ * @brief States of the receive shim between the TLS transport and coreMQTT.
  */
-static uint16_t globalUnsubscribePacketIdentifier = 0U;
+typedef enum StreamingState
+{
+    StreamingStateHeader = 0,  /**< Reading the fixed header of the next packet. */
+    StreamingStatePassThrough, /**< Handing a packet that fits the network buffer to coreMQTT. */
+    StreamingStateTopicLength, /**< Reading the topic length of a streamed publish. */
+    StreamingStateTopic,       /**< Reading the topic name of a streamed publish. */
+    StreamingStatePacketId,    /**< Reading the packet identifier of a streamed publish. */
+    StreamingStatePayload      /**< Passing the payload of a streamed publish to the handler. */
+} StreamingState_t;
 
 /**
- * @brief Array to keep the outgoing publish messages.
- * These stored outgoing publish messages are kept until a successful ack
- * is received.
+ * @brief State of the receive shim, kept across calls as a packet may
+ * arrive over several of them.
  */
-static PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ] = { 0 };
+typedef struct StreamingReceive
+{
+    StreamingState_t state;
+
+    /**
+     * @brief Fixed header of the current packet and how much of it was read
+     * from the network and handed to coreMQTT.
+     */
+    uint8_t header[ MQTT_FIXED_HEADER_MAX_LENGTH ];
+    size_t headerLength;
+    size_t headerSent;
+
+    /**
+     * @brief Bytes of the current packet, after the fixed header, that have
+     * not been read from the network yet.
+     */
+    size_t remainingLength;
+
+    /**
+     * @brief Fields of the streamed publish.
+     */
+    uint8_t qos;
+    uint8_t field[ 2 ];
+    size_t fieldLength;
+    char topic[ STREAMING_TOPIC_MAX_LENGTH ];
+    uint16_t topicLength;
+    uint16_t topicRead;
+    uint16_t packetId;
+    size_t payloadLength;
+    size_t payloadOffset;
+
+    /**
+     * @brief Whether the streamed publish is read and dropped instead of
+     * being passed to the handler.
+     */
+    bool discard;
+} StreamingReceive_t;
+
+/*-----------------------------------------------------------*/
 
 /**
- * @brief The network buffer must remain valid for the lifetime of the MQTT context.
+ * @brief Credentials handed to every TLS session of a client.
  */
-static uint8_t buffer[ NETWORK_BUFFER_SIZE ];
+typedef struct ClientCredentials
+{
+    const char * pRootCa;
+    uint32_t rootCaSize;
+    const char * pClientCert;
+    uint32_t clientCertSize;
+    const char * pClientKey;
+    uint32_t clientKeySize;
+    void * pDsData;
+
+    #ifdef CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR
+
+        /**
+         * @brief Credentials read from the esp_secure_cert partition, which
+         * the fields above point into.
+         */
+        esp_secure_cert_bundle_t secureCertBundle;
+    #endif
+
+    /**
+     * @brief Whether the credentials were loaded. They are loaded on the
+     * first connection and kept until the client is released.
+     */
+    bool loaded;
+} ClientCredentials_t;
+
+/*-----------------------------------------------------------*/
 
 /**
- * @brief The MQTT context used for MQTT operation.
+ * @brief One MQTT connection and everything the helpers track for it.
  */
-static MQTTContext_t mqttContext = { 0 };
+struct MqttClient
+{
+    /**
+     * @brief The MQTT context used for MQTT operation.
+     */
+    MQTTContext_t mqttContext;
+
+    /**
+     * @brief The network context used for the TLS connection.
+     */
+    NetworkContext_t networkContext;
+
+    /**
+     * @brief Broker to connect to and client identifier to connect with.
+     */
+    MqttClientConfig_t config;
+
+    /**
+     * @brief Credentials, so that reconnecting does not fetch them again.
+     */
+    ClientCredentials_t credentials;
+
+    /**
+     * @brief The network buffer must remain valid for the lifetime of the MQTT context.
+     *
+     * It comes from #networkBufferPool, or with the low-memory TLS profile it
+     * is allocated once the TLS handshake is done and freed on disconnect, so
+     * that it never adds to the peak heap use of the handshake.
+     */
+    uint8_t * pNetworkBuffer;
+
+    /**
+     * @brief The flag to indicate the mqtt session changed.
+     */
+    bool sessionEstablished;
+
+    /**
+     * @brief Packet Identifier updated when an ACK packet is received.
+     *
+     * It is used to match an expected ACK for a transmitted packet.
+     */
+    uint16_t ackPacketIdentifier;
+
+    /**
+     * @brief Packet Identifier generated when Subscribe request was sent to the broker;
+     * it is used to match received Subscribe ACK to the transmitted subscribe.
+     */
+    uint16_t subscribePacketIdentifier;
+
+    /**
+     * @brief Packet Identifier generated when Unsubscribe request was sent to the broker;
+     * it is used to match received Unsubscribe ACK to the transmitted unsubscribe
+     * request.
+     */
+    uint16_t unsubscribePacketIdentifier;
+
+    /**
+     * @brief Array to keep the outgoing publish messages.
+     * These stored outgoing publish messages are kept until a successful ack
+     * is received.
+     */
+    PublishPackets_t outgoingPublishPackets[ MAX_OUTGOING_PUBLISHES ];
+
+    /**
+     * @brief Array to track the outgoing publish records for outgoing publishes
+     * with QoS > 0.
+     *
+     * This is passed into #MQTT_InitStatefulQoS to allow for QoS > 0.
+     */
+    MQTTPubAckInfo_t outgoingPublishRecords[ OUTGOING_PUBLISH_RECORD_LEN ];
+
+    /**
+     * @brief Array to track the incoming publish records for incoming publishes
+     * with QoS > 0.
+     *
+     * This is passed into #MQTT_InitStatefulQoS to allow for QoS > 0.
+     */
+    MQTTPubAckInfo_t incomingPublishRecords[ INCOMING_PUBLISH_RECORD_LEN ];
+
+    /**
+     * @brief Round trip time estimate. It is kept across reconnects, as the
+     * link to the broker rarely changes between two sessions.
+     */
+    RttEstimator_t rttEstimator;
+
+    /**
+     * @brief State of the receive shim.
+     */
+    StreamingReceive_t streamingReceive;
+
+    /**
+     * @brief Handler for the payload of incoming publishes that do not fit
+     * #NETWORK_BUFFER_SIZE. NULL to drop such publishes.
+     */
+    StreamingPublishCallback_t streamingPublishCallback;
+
+    /**
+     * @brief Outbound priority lanes, indexed by #OutboundPriority_t.
+     */
+    OutboundLane_t outboundLanes[ OutboundPriorityMax ];
+
+    /**
+     * @brief Spinlock protecting #outboundLanes, so that publishes can be
+     * enqueued from other tasks while the MQTT task services the queue.
+     */
+    portMUX_TYPE outboundLanesLock;
+
+    /**
+     * @brief Delays between connection attempts. Kept across sessions, and
+     * reset only once the broker accepted a CONNECT, so that a broker which
+     * keeps refusing or dropping the client is retried less and less often.
+     */
+    ReconnectBackoff_t reconnectBackoff;
+
+    /**
+     * @brief Whether to back off before the first connection attempt of the
+     * next session, because the last CONNECT failed or a delay was hinted.
+     */
+    bool backoffBeforeConnect;
+
+    /**
+     * @brief Static buffer for TLS Context Semaphore.
+     */
+    StaticSemaphore_t tlsContextSemaphoreBuffer;
+
+    #ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+
+        /**
+         * @brief Batches the writes of coreMQTT and of the receive shim.
+         */
+        TlsWriteCoalescer_t writeCoalescer;
+
+        /**
+         * @brief Buffer of #writeCoalescer.
+         */
+        uint8_t writeCoalescingBuffer[ TLS_WRITE_COALESCING_BUFFER_SIZE ];
+    #endif
+
+    /**
+     * @brief Whether the client is handed out from #mqttClientPool.
+     */
+    bool inUse;
+};
+
+/*-----------------------------------------------------------*/
 
 /**
- * @brief The network context used for Openssl operation.
+ * @brief Clients handed out by #CreateMqttClient.
  */
-static NetworkContext_t networkContext = { 0 };
+static MqttClient_t mqttClientPool[ MQTT_CLIENT_POOL_SIZE ];
+
+#ifndef CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE
 
 /**
- * @brief The flag to indicate the mqtt session changed.
+ * @brief Network buffers of the clients in #mqttClientPool, one per client.
  */
-static bool mqttSessionEstablished = false;
+static uint8_t networkBufferPool[ MQTT_CLIENT_POOL_SIZE ][ NETWORK_BUFFER_SIZE ];
+#endif
 
 /**
- * @brief Array to track the outgoing publish records for outgoing publishes
- * with QoS > 0.
- *
- * This is passed into #MQTT_InitStatefulQoS to allow for QoS > 0.
- *
+ * @brief Spinlock protecting the in-use flags of #mqttClientPool.
  */
-static MQTTPubAckInfo_t pOutgoingPublishRecords[ OUTGOING_PUBLISH_RECORD_LEN ];
+static portMUX_TYPE mqttClientPoolLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-----------------------------------------------------------*/
 
 /**
- * @brief Array to track the incoming publish records for incoming publishes
- * with QoS > 0.
+ * @brief Connect to MQTT broker with reconnection retries.
+ *
+ * If connection fails, retry is attempted after a delay drawn with
+ * decorrelated jitter from #ReconnectBackoff_t, capped by
+ * CONFIG_EXAMPLE_RECONNECT_MAX_DELAY_S. A delay hinted by the server through
+ * #SetReconnectDelayHint is honoured first. Retries are unbounded unless
+ * CONFIG_EXAMPLE_RECONNECT_MAX_ATTEMPTS is not 0.
  *
- * This is passed into #MQTT_InitStatefulQoS to allow for QoS > 0.
+ * @param[in] pClient The client.
  *
+ * @return EXIT_FAILURE on failure; EXIT_SUCCESS on successful connection.
  */
-static MQTTPubAckInfo_t pIncomingPublishRecords[ INCOMING_PUBLISH_RECORD_LEN ];
+static int connectToServerWithBackoffRetries( MqttClient_t * pClient );
 
 /**
- * @brief Static buffer for TLS Context Semaphore.
+ * @brief Set the port of the TLS session and the ALPN protocol it needs.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] port The port.
  */
-static StaticSemaphore_t xTlsContextSemaphoreBuffer;
+static void setBrokerPort( NetworkContext_t * pNetworkContext,
+                           uint16_t port );
 
-/*-----------------------------------------------------------*/
+#ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
 
 /**
- * @brief The random number generator to use for exponential backoff with
- * jitter retry logic.
+ * @brief Choose between #MQTT_TLS_PORT and #MQTT_ALPN_PORT.
+ *
+ * The port that won on the current network is used again. Otherwise
+ * TCP connections to both ports are raced, the configured port first, and
+ * the first to complete wins. The winner is stored only once the TLS
+ * session is established.
  *
- * @return The generated random number.
+ * @param[in] pClient The client.
+ *
+ * @return The port to connect to; the configured port if no race was
+ * possible.
  */
-static uint32_t generateRandomNumber();
+    static uint16_t chooseBrokerPort( MqttClient_t * pClient );
 
 /**
- * @brief Connect to MQTT broker with reconnection retries.
+ * @brief Tell whether a failed TLS session failed below TLS.
  *
- * If connection fails, retry is attempted after a timeout.
- * Timeout value will exponentially increase until maximum
- * timeout value is reached or the number of attempts are exhausted.
+ * #xTlsConnect reports a refused TCP connection and a failed handshake the
+ * same way, so a plain TCP connection to the port is tried again. Only if it
+ * fails too is the stored winner wrong for the network; certificate and
+ * credential errors keep it.
  *
- * @param[out] pNetworkContext The output parameter to return the created network context.
+ * @param[in] pClient The client.
+ * @param[in] port The port the TLS session was attempted on.
  *
- * @return EXIT_FAILURE on failure; EXIT_SUCCESS on successful connection.
+ * @return true if the broker did not accept a TCP connection on @p port;
+ * false if it did, or if that cannot be told without a cached address.
  */
-static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext );
+    static bool isBrokerPortUnreachable( MqttClient_t * pClient,
+                                         uint16_t port );
+#endif
 
 /**
  * @brief Function to get the free index at which an outgoing publish
  * can be stored.
  *
+ * @param[in] pClient The client.
  * @param[out] pIndex The output parameter to return the index at which an
  * outgoing publish message can be stored.
  *
  * @return EXIT_FAILURE if no more publishes can be stored;
  * EXIT_SUCCESS if an index to store the next outgoing publish is obtained.
  */
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex );
+static int getNextFreeIndexForOutgoingPublishes( MqttClient_t * pClient,
+                                                 uint8_t * pIndex );
 
 /**
  * @brief Function to clean up an outgoing publish at given index from the
  * #outgoingPublishPackets array.
  *
+ * @param[in] pClient The client.
  * @param[in] index The index at which a publish message has to be cleaned up.
  */
-static void cleanupOutgoingPublishAt( uint8_t index );
+static void cleanupOutgoingPublishAt( MqttClient_t * pClient,
+                                      uint8_t index );
 
 /**
  * @brief Function to clean up all the outgoing publishes maintained in the
  * array.
+ *
+ * @param[in] pClient The client.
  */
-static void cleanupOutgoingPublishes( void );
+static void cleanupOutgoingPublishes( MqttClient_t * pClient );
 
 /**
  * @brief Function to clean up the publish packet with the given packet id.
  *
+ * @param[in] pClient The client.
  * @param[in] packetId Packet identifier of the packet to be cleaned up from
  * the array.
  */
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId );
+static void cleanupOutgoingPublishWithPacketID( MqttClient_t * pClient,
+                                                uint16_t packetId );
 
 /**
  * @brief Function to resend the publishes if a session is re-established with
  * the broker. This function handles the resending of the QoS1 publish packets,
  * which are maintained locally.
  *
- * @param[in] pMqttContext MQTT context pointer.
+ * Publishes are resent in rounds. The number of publishes per round starts at
+ * #RESEND_INITIAL_WINDOW, doubles when every PUBACK of a round arrives in time
+ * and halves when a round times out. A publish that cannot be resent stays
+ * stored for the next session instead of failing the whole reconnect.
+ *
+ * @param[in] pClient The client.
  */
-static int handlePublishResend( MQTTContext_t * pMqttContext );
+static int handlePublishResend( MqttClient_t * pClient );
 
 /**
- * @brief Wait for an expected ACK packet to be received.
+ * @brief Count how many of the given packet identifiers are still waiting
+ * for a PUBACK in #outgoingPublishPackets.
  *
- * This function handles waiting for an expected ACK packet by calling
- * #MQTT_ProcessLoop and waiting for #mqttCallback to set the global ACK
- * packet identifier to the expected ACK packet identifier.
- *
- * @param[in] pMqttContext MQTT context pointer.
- * @param[in] usPacketIdentifier Packet identifier for expected ACK packet.
- * @param[in] ulTimeout Maximum duration to wait for expected ACK packet.
+ * @param[in] pClient The client.
+ * @param[in] pPacketIds Packet identifiers to look up.
+ * @param[in] packetIdCount Number of packet identifiers.
  *
- * @return EXIT_SUCCESS if the expected ACK packet was received, EXIT_FAILURE
- * otherwise.
+ * @return The number of packet identifiers still unacked.
  */
-static int waitForPacketAck( MQTTContext_t * pMqttContext,
-                             uint16_t usPacketIdentifier,
-                             uint32_t ulTimeout );
+static uint8_t countUnackedPublishes( MqttClient_t * pClient,
+                                      const uint16_t * pPacketIds,
+                                      uint8_t packetIdCount );
 
 /**
- * @brief Call #MQTT_ProcessLoop in a loop for the duration of a timeout or
- * #MQTT_ProcessLoop returns a failure.
+ * @brief Feed the round trip time of an acknowledged publish into
+ * #rttEstimator and adjust the in-flight window.
  *
- * @param[in] pMqttContext MQTT context pointer.
- * @param[in] ulTimeoutMs Duration to call #MQTT_ProcessLoop for.
+ * Publishes that were resent are not sampled, as their PUBACK cannot be
+ * matched to a single transmission.
  *
- * @return Returns the return value of the last call to #MQTT_ProcessLoop.
+ * @param[in] pClient The client.
+ * @param[in] packetId Packet identifier of the acknowledged publish.
  */
-static MQTTStatus_t processLoopWithTimeout( MQTTContext_t * pMqttContext,
-                                            uint32_t ulTimeoutMs );
+static void samplePublishRtt( MqttClient_t * pClient,
+                              uint16_t packetId );
 
-/*-----------------------------------------------------------*/
+/**
+ * @brief Get the current ACK timeout derived from the round trip time.
+ *
+ * @return The timeout in milliseconds.
+ *
+ * @param[in] pClient The client.
+ */
+static uint32_t getAckTimeoutMs( MqttClient_t * pClient );
+
+/**
+ * @brief Check whether another QoS1 publish fits in the in-flight window.
+ *
+ * Publishes that have been waiting longer than the ACK timeout halve the
+ * window and double the timeout, once per publish.
+ *
+ * @return true if another QoS1 publish may be sent; false otherwise.
+ *
+ * @param[in] pClient The client.
+ */
+static bool inFlightWindowHasRoom( MqttClient_t * pClient );
+
+/**
+ * @brief Read from the TLS transport on behalf of the receive shim, keeping
+ * track of the bytes of the current packet that are left.
+ *
+ * @param[in] pClient The client.
+ * @param[out] pBuffer Where to store the bytes.
+ * @param[in] bytesToRecv Maximum number of bytes to read.
+ *
+ * @return Number of bytes read, or a negative value on error.
+ */
+static int32_t streamingReadBody( MqttClient_t * pClient,
+                                  void * pBuffer,
+                                  size_t bytesToRecv );
+
+/**
+ * @brief Consume the next part of a publish that does not fit the network
+ * buffer and pass its payload to #streamingPublishCallback.
+ *
+ * The publish never reaches coreMQTT; for QoS1 the PUBACK is sent from here
+ * once the whole payload was read. Payload chunks are read into the part of
+ * the MQTT network buffer that coreMQTT asked to be filled, so streaming
+ * needs no buffer of its own.
+ *
+ * @param[in] pClient The client.
+ * @param[in] pScratch Free part of the network buffer.
+ * @param[in] scratchLength Length of @p pScratch.
+ *
+ * @return Number of bytes consumed, or a negative value on error.
+ */
+static int32_t streamOversizedPublish( MqttClient_t * pClient,
+                                       uint8_t * pScratch,
+                                       size_t scratchLength );
+
+/**
+ * @brief Transport receive function given to coreMQTT.
+ *
+ * It reads the fixed header of every incoming packet itself. Packets that
+ * fit #NETWORK_BUFFER_SIZE are handed to coreMQTT unchanged, never beyond
+ * the end of the packet; publishes that do not fit are consumed by
+ * #streamOversizedPublish.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[out] pBuffer Buffer to receive into.
+ * @param[in] bytesToRecv Size of @p pBuffer.
+ *
+ * @return Number of bytes handed to coreMQTT, or a negative value on error.
+ */
+static int32_t streamingTransportRecv( NetworkContext_t * pNetworkContext,
+                                       void * pBuffer,
+                                       size_t bytesToRecv );
+
+/**
+ * @brief Send function of the transport interface. Sends through the write
+ * coalescer when it is enabled.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] pBuffer Bytes to send.
+ * @param[in] bytesToSend Number of bytes.
+ *
+ * @return Number of bytes taken, or a negative value on error.
+ */
+static int32_t clientTransportSend( NetworkContext_t * pNetworkContext,
+                                    const void * pBuffer,
+                                    size_t bytesToSend );
+
+#ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+
+/**
+ * @brief Flush the held back writes of the client before the receive shim
+ * may wait for the broker.
+ *
+ * Writes stay held back while the broker has already sent more data, so
+ * that for example the PUBACKs of a burst of incoming publishes go out
+ * together. Otherwise the broker may be waiting for them.
+ *
+ * @param[in] pClient The client.
+ *
+ * @return EXIT_SUCCESS; EXIT_FAILURE if sending failed.
+ */
+    static int flushWritesBeforeReceive( MqttClient_t * pClient );
+#endif
+
+/**
+ * @brief Allocate the MQTT network buffer for the low-memory TLS profile.
+ *
+ * @return EXIT_SUCCESS if the buffer is available; EXIT_FAILURE otherwise.
+ *
+ * @param[in] pClient The client.
+ */
+static int allocateNetworkBuffer( MqttClient_t * pClient );
+
+/**
+ * @brief Free the MQTT network buffer for the low-memory TLS profile.
+ *
+ * @param[in] pClient The client.
+ */
+static void freeNetworkBuffer( MqttClient_t * pClient );
+
+/**
+ * @brief Prepare the network context of the client for a TLS session to
+ * its broker.
+ *
+ * @param[in] pClient The client.
+ *
+ * @return EXIT_SUCCESS; EXIT_FAILURE if the credentials could not be
+ * loaded.
+ */
+static int prepareNetworkContext( MqttClient_t * pClient );
+
+/**
+ * @brief Load the credentials of the client, unless they are loaded
+ * already, and hand them to the network context.
+ *
+ * The embedded credentials are converted to DER at build time. Any that are
+ * still PEM are decoded once for all clients by #CredentialCache_GetDer.
+ *
+ * @param[in] pClient The client.
+ *
+ * @return EXIT_SUCCESS if the credentials are available; EXIT_FAILURE
+ * otherwise.
+ */
+static int loadCredentials( MqttClient_t * pClient );
+
+/**
+ * @brief Free the credentials loaded for the TLS connection.
+ *
+ * @param[in] pClient The client holding the credentials.
+ */
+static void cleanupESPSecureMgrCerts( MqttClient_t * pClient );
+
+/**
+ * @brief Wait for an expected ACK packet to be received.
+ *
+ * This function handles waiting for an expected ACK packet by calling
+ * #MQTT_ProcessLoop and waiting for #mqttCallback to set the global ACK
+ * packet identifier to the expected ACK packet identifier.
+ *
+ * @param[in] pClient The client.
+ * @param[in] usPacketIdentifier Packet identifier for expected ACK packet.
+ * @param[in] ulTimeout Maximum duration to wait for expected ACK packet.
+ *
+ * @return EXIT_SUCCESS if the expected ACK packet was received, EXIT_FAILURE
+ * otherwise.
+ */
+static int waitForPacketAck( MqttClient_t * pClient,
+                             uint16_t usPacketIdentifier,
+                             uint32_t ulTimeout );
+
+/**
+ * @brief Call #MQTT_ProcessLoop in a loop for the duration of a timeout or
+ * #MQTT_ProcessLoop returns a failure.
+ *
+ * @param[in] pMqttContext MQTT context pointer.
+ * @param[in] ulTimeoutMs Duration to call #MQTT_ProcessLoop for.
+ *
+ * @return Returns the return value of the last call to #MQTT_ProcessLoop.
+ */
+static MQTTStatus_t processLoopWithTimeout( MQTTContext_t * pMqttContext,
+                                            uint32_t ulTimeoutMs );
+
+/**
+ * @brief Send a QoS0 PUBLISH without reserving an outgoing publish slot and
+ * without waiting in the process loop.
+ *
+ * @param[in] pClient The client.
+ * @param[in] pTopicFilter Points to the topic.
+ * @param[in] topicFilterLength The length of the topic.
+ * @param[in] pPayload Points to the payload.
+ * @param[in] payloadLength The length of the payload.
+ *
+ * @return EXIT_SUCCESS if PUBLISH was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+static int publishQoS0( MqttClient_t * pClient,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength );
+
+/**
+ * @brief Send a QoS1 PUBLISH, keeping it in #outgoingPublishPackets until
+ * the PUBACK is received.
+ *
+ * @param[in] pClient The client.
+ * @param[in] pTopicFilter Points to the topic.
+ * @param[in] topicFilterLength The length of the topic.
+ * @param[in] pPayload Points to the payload.
+ * @param[in] payloadLength The length of the payload.
+ * @param[in] processLoopTimeoutMs Duration to process incoming packets for
+ * after the PUBLISH is sent.
+ *
+ * @return EXIT_SUCCESS if PUBLISH was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+static int publishQoS1( MqttClient_t * pClient,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength,
+                        uint32_t processLoopTimeoutMs );
+
+/**
+ * @brief Take the oldest publish from the highest priority non-empty lane.
+ *
+ * QoS1 publishes are only taken when an outgoing publish slot is free, so a
+ * full in-flight window does not block QoS0 publishes queued behind them.
+ *
+ * @param[in] pClient The client.
+ * @param[out] pPublish The dequeued publish.
+ *
+ * @return true if a publish was dequeued; false otherwise.
+ */
+static bool dequeueOutboundPublish( MqttClient_t * pClient,
+                                    OutboundPublish_t * pPublish );
 
-static uint32_t generateRandomNumber()
-{
-    return( rand() );
-}
 
 /*-----------------------------------------------------------*/
 
-static int connectToServerWithBackoffRetries( NetworkContext_t * pNetworkContext )
+static int connectToServerWithBackoffRetries( MqttClient_t * pClient )
 {
     int returnStatus = EXIT_SUCCESS;
-    BackoffAlgorithmStatus_t backoffAlgStatus = BackoffAlgorithmSuccess;
-    TlsTransportStatus_t tlsStatus = TLS_TRANSPORT_SUCCESS;
-    BackoffAlgorithmContext_t reconnectParams;
-    pNetworkContext->pcHostname = AWS_IOT_ENDPOINT;
-    pNetworkContext->xPort = AWS_MQTT_PORT;
-    pNetworkContext->pxTls = NULL;
-    pNetworkContext->xTlsContextSemaphore = xSemaphoreCreateMutexStatic(&xTlsContextSemaphoreBuffer);
-
-    pNetworkContext->disableSni = 0;
-    uint16_t nextRetryBackOff;
-    struct timespec tp;
+    ReconnectBackoffStatus_t backoffStatus = ReconnectBackoffSuccess;
+    TlsTransportStatus_t tlsStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
+    uint32_t nextRetryBackOff = 0U;
+    EndpointResolverStatus_t resolverStatus = EndpointResolverSuccess;
+    ip_addr_t brokerAddress;
+    char brokerAddressString[ IPADDR_STRLEN_MAX ];
+    bool brokerAddressIsStale = false;
+
+    /* Resolve the broker host name while the credentials are loaded. */
+    ( void ) EndpointResolver_Prefetch( pClient->config.pHostName );
 
     /* Initialize credentials for establishing TLS session. */
-    pNetworkContext->pcServerRootCA = root_cert_auth_start;
-    pNetworkContext->pcServerRootCASize = root_cert_auth_end - root_cert_auth_start;
-
-#ifdef CONFIG_EXAMPLE_USE_SECURE_ELEMENT
-    pNetworkContext->use_secure_element = true;
-
-#elif defined(CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR)
-    if (esp_secure_cert_get_device_cert(&pNetworkContext->pcClientCert, &pNetworkContext->pcClientCertSize) != ESP_OK) {
-        LogError( ( "Failed to obtain flash address of device cert") );
-        return EXIT_FAILURE;
-    }
-#ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
-    pNetworkContext->ds_data = esp_secure_cert_get_ds_ctx();
-    if (pNetworkContext->ds_data == NULL) {
-        LogError( ( "Failed to obtain the ds context") );
-        return EXIT_FAILURE;
-    }
-#else /* !CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
-    if (esp_secure_cert_get_priv_key(&pNetworkContext->pcClientKey, &pNetworkContext->pcClientKeySize) != ESP_OK) {
-        LogError( ( "Failed to obtain flash address of private_key") );
+    if( prepareNetworkContext( pClient ) != EXIT_SUCCESS )
+    {
         return EXIT_FAILURE;
     }
-#endif /* CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
 
-#else /* !CONFIG_EXAMPLE_USE_SECURE_ELEMENT && !CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR  */
-    #ifndef CLIENT_USERNAME
-        pNetworkContext->pcClientCert = client_cert_start;
-        pNetworkContext->pcClientCertSize = client_cert_end - client_cert_start;
-        pNetworkContext->pcClientKey = client_key_start;
-        pNetworkContext->pcClientKeySize = client_key_end - client_key_start;
-    #endif
-#endif
+    resolverStatus = EndpointResolver_Wait( pClient->config.pHostName,
+                                            ENDPOINT_RESOLVE_TIMEOUT_MS,
+                                            &brokerAddress,
+                                            &brokerAddressIsStale );
 
-    if( AWS_MQTT_PORT == 443 )
+    if( resolverStatus == EndpointResolverSuccess )
     {
-        /* Pass the ALPN protocol name depending on the port being used.
-         * Please see more details about the ALPN protocol for AWS IoT MQTT endpoint
-         * in the link below.
-         * https://aws.amazon.com/blogs/iot/mqtt-with-tls-client-authentication-on-port-443-why-it-is-useful-and-how-it-works/
-         */
-        static const char * pcAlpnProtocols[] = { NULL, NULL };
-        pcAlpnProtocols[0] = ALPN_PROTOCOL_NAME;
-        pNetworkContext->pAlpnProtos = pcAlpnProtocols;
-    } else {
-        pNetworkContext->pAlpnProtos = NULL;
+        LogInfo( ( "%s resolved to %s%s.",
+                   pClient->config.pHostName,
+                   ipaddr_ntoa_r( &brokerAddress, brokerAddressString, sizeof( brokerAddressString ) ),
+                   brokerAddressIsStale ? " (refreshing)" : "" ) );
+    }
+    else
+    {
+        LogWarn( ( "Could not resolve %s in advance: resolver status %d.",
+                   pClient->config.pHostName,
+                   ( int ) resolverStatus ) );
     }
 
-    /* Seed pseudo random number generator used in the demo for
-     * backoff period calculation when retrying failed network operations
-     * with broker. */
-
-    /* Get current time to seed pseudo random number generator. */
-    ( void ) clock_gettime( CLOCK_REALTIME, &tp );
-    /* Seed pseudo random number generator with nanoseconds. */
-    srand( tp.tv_nsec );
+    if( pClient->backoffBeforeConnect )
+    {
+        /* The TLS session of the last attempt came up but the MQTT session
+         * did not, or a delay was hinted: do not come straight back. */
+        pClient->backoffBeforeConnect = false;
+        backoffStatus = ReconnectBackoff_GetNextDelay( &pClient->reconnectBackoff, &nextRetryBackOff );
 
-    /* Initialize reconnect attempts and interval */
-    BackoffAlgorithm_InitializeParams( &reconnectParams,
-                                       CONNECTION_RETRY_BACKOFF_BASE_MS,
-                                       CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS,
-                                       CONNECTION_RETRY_MAX_ATTEMPTS );
+        if( backoffStatus == ReconnectBackoffSuccess )
+        {
+            LogWarn( ( "Waiting %u ms before reconnecting.", ( unsigned int ) nextRetryBackOff ) );
+            Clock_SleepMs( nextRetryBackOff );
+        }
+        else
+        {
+            LogError( ( "Connection to the broker failed, all attempts exhausted." ) );
+            returnStatus = EXIT_FAILURE;
+        }
+    }
 
     /* Attempt to connect to MQTT broker. If connection fails, retry after
-     * a timeout. Timeout value will exponentially increase until maximum
-     * attempts are reached.
+     * a random delay between the base delay and three times the previous
+     * delay, until maximum attempts are reached, if ever.
      */
-    do
+    while( ( tlsStatus != TLS_TRANSPORT_SUCCESS ) && ( backoffStatus == ReconnectBackoffSuccess ) )
     {
-        /* Establish a TLS session with the MQTT broker. This example connects
-         * to the MQTT broker as specified in AWS_IOT_ENDPOINT and AWS_MQTT_PORT
-         * at the demo config header. */
-        LogInfo( ( "Establishing a TLS session to %.*s:%d.",
-                   AWS_IOT_ENDPOINT_LENGTH,
-                   AWS_IOT_ENDPOINT,
-                   AWS_MQTT_PORT ) );
+        #ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
+            setBrokerPort( pNetworkContext, chooseBrokerPort( pClient ) );
+        #else
+            setBrokerPort( pNetworkContext, pClient->config.port );
+        #endif
+
+        /* Establish a TLS session with the MQTT broker the client was
+         * created for. */
+        LogInfo( ( "Establishing a TLS session to %s:%u with the %s profile.",
+                   pClient->config.pHostName,
+                   ( unsigned int ) pNetworkContext->xPort,
+                   TLS_PROFILE_NAME ) );
         tlsStatus = xTlsConnect ( pNetworkContext );
 
+        #ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
+            if( tlsStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                ( void ) ConnectionRacer_StoreWinner( pClient->config.pHostName,
+                                                      ( uint16_t ) pNetworkContext->xPort );
+            }
+            else if( ( tlsStatus == TLS_TRANSPORT_CONNECT_FAILURE ) &&
+                     isBrokerPortUnreachable( pClient, ( uint16_t ) pNetworkContext->xPort ) )
+            {
+                /* Race again on the next attempt. */
+                ( void ) ConnectionRacer_ForgetWinner( pClient->config.pHostName );
+            }
+            else
+            {
+                /* The port answered, the failure is not the port's. */
+            }
+        #endif
+
         if( tlsStatus != TLS_TRANSPORT_SUCCESS )
         {
-            /* Generate a random number and get back-off value (in milliseconds) for the next connection retry. */
-            backoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &reconnectParams, generateRandomNumber(), &nextRetryBackOff );
+            /* Get back-off value (in milliseconds) for the next connection retry. */
+            backoffStatus = ReconnectBackoff_GetNextDelay( &pClient->reconnectBackoff, &nextRetryBackOff );
 
-            if( backoffAlgStatus == BackoffAlgorithmRetriesExhausted )
+            if( backoffStatus == ReconnectBackoffRetriesExhausted )
             {
                 LogError( ( "Connection to the broker failed, all attempts exhausted." ) );
                 returnStatus = EXIT_FAILURE;
             }
-            else if( backoffAlgStatus == BackoffAlgorithmSuccess )
+            else
             {
                 LogWarn( ( "Connection to the broker failed. Retrying connection "
-                           "after %hu ms backoff.",
-                           ( unsigned short ) nextRetryBackOff ) );
+                           "after %u ms backoff.",
+                           ( unsigned int ) nextRetryBackOff ) );
+
+                /* Refresh a stale address during the backoff rather than
+                 * inside the next connection attempt. */
+                ( void ) EndpointResolver_Prefetch( pClient->config.pHostName );
                 Clock_SleepMs( nextRetryBackOff );
             }
         }
-    } while( ( tlsStatus != TLS_TRANSPORT_SUCCESS ) && ( backoffAlgStatus == BackoffAlgorithmSuccess ) );
+    }
 
     return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
 
-static int getNextFreeIndexForOutgoingPublishes( uint8_t * pIndex )
+static void setBrokerPort( NetworkContext_t * pNetworkContext,
+                           uint16_t port )
+{
+    /* Pass the ALPN protocol name depending on the port being used.
+     * Please see more details about the ALPN protocol for AWS IoT MQTT endpoint
+     * in the link below.
+     * https://aws.amazon.com/blogs/iot/mqtt-with-tls-client-authentication-on-port-443-why-it-is-useful-and-how-it-works/
+     */
+    static const char * pcAlpnProtocols[] = { ALPN_PROTOCOL_NAME, NULL };
+
+    pNetworkContext->xPort = port;
+    pNetworkContext->pAlpnProtos = ( port == MQTT_ALPN_PORT ) ? pcAlpnProtocols : NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+#ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
+
+    static uint16_t chooseBrokerPort( MqttClient_t * pClient )
+    {
+        uint16_t port = pClient->config.port;
+        uint16_t ports[ 2 ];
+        ip_addr_t brokerAddress;
+
+        /* Only the two AWS IoT ports carry the same broker. */
+        if( ( port != MQTT_TLS_PORT ) && ( port != MQTT_ALPN_PORT ) )
+        {
+            return port;
+        }
+
+        if( ConnectionRacer_LoadWinner( pClient->config.pHostName, &port ) == ConnectionRacerSuccess )
+        {
+            return port;
+        }
+
+        port = pClient->config.port;
+
+        /* Only a cached address is used, the lookup itself is not awaited. */
+        if( EndpointResolver_Wait( pClient->config.pHostName, 0U, &brokerAddress, NULL ) == EndpointResolverSuccess )
+        {
+            ports[ 0 ] = pClient->config.port;
+            ports[ 1 ] = ( ports[ 0 ] == MQTT_TLS_PORT ) ? MQTT_ALPN_PORT : MQTT_TLS_PORT;
+
+            if( ConnectionRacer_Race( &brokerAddress, ports, 2U, CONNECTION_RACE_TIMEOUT_MS, &port ) == ConnectionRacerSuccess )
+            {
+                LogInfo( ( "Port %u answered first.", ( unsigned int ) port ) );
+            }
+            else
+            {
+                port = pClient->config.port;
+            }
+        }
+
+        return port;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static bool isBrokerPortUnreachable( MqttClient_t * pClient,
+                                         uint16_t port )
+    {
+        bool unreachable = false;
+        uint16_t answeredPort = 0U;
+        ip_addr_t brokerAddress;
+
+        /* Only a winner of a race is stored, for these two ports. */
+        if( ( ( port == MQTT_TLS_PORT ) || ( port == MQTT_ALPN_PORT ) ) &&
+            ( EndpointResolver_Wait( pClient->config.pHostName, 0U, &brokerAddress, NULL ) == EndpointResolverSuccess ) )
+        {
+            unreachable = ( ConnectionRacer_Race( &brokerAddress, &port, 1U, CONNECTION_RACE_TIMEOUT_MS,
+                                                  &answeredPort ) != ConnectionRacerSuccess );
+        }
+
+        return unreachable;
+    }
+
+#endif /* ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS */
+
+/*-----------------------------------------------------------*/
+
+static int getNextFreeIndexForOutgoingPublishes( MqttClient_t * pClient,
+                                                 uint8_t * pIndex )
 {
     int returnStatus = EXIT_FAILURE;
     uint8_t index = 0;
 
-    assert( outgoingPublishPackets != NULL );
+    assert( pClient != NULL );
     assert( pIndex != NULL );
 
-    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        /* A free index is marked by invalid packet id.
-         * Check if the the index has a free slot. */
-        if( outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
+    for( index = 0; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        /* A free index is marked by invalid packet id.
+         * Check if the the index has a free slot. */
+        if( pClient->outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID )
+        {
+            returnStatus = EXIT_SUCCESS;
+            break;
+        }
+    }
+
+    /* Copy the available index into the output param. */
+    *pIndex = index;
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void cleanupOutgoingPublishAt( MqttClient_t * pClient,
+                                      uint8_t index )
+{
+    assert( pClient != NULL );
+    assert( index < MAX_OUTGOING_PUBLISHES );
+
+    /* Clear the outgoing publish packet. */
+    ( void ) memset( &( pClient->outgoingPublishPackets[ index ] ),
+                     0x00,
+                     sizeof( pClient->outgoingPublishPackets[ index ] ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void cleanupOutgoingPublishes( MqttClient_t * pClient )
+{
+    assert( pClient != NULL );
+
+    /* Clean up all the outgoing publish packets. */
+    ( void ) memset( pClient->outgoingPublishPackets, 0x00, sizeof( pClient->outgoingPublishPackets ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void cleanupOutgoingPublishWithPacketID( MqttClient_t * pClient,
+                                                uint16_t packetId )
+{
+    uint8_t index = 0;
+
+    assert( pClient != NULL );
+    assert( packetId != MQTT_PACKET_ID_INVALID );
+
+    /* Clean up all the saved outgoing publishes. */
+    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        if( pClient->outgoingPublishPackets[ index ].packetId == packetId )
+        {
+            cleanupOutgoingPublishAt( pClient, index );
+            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.",
+                       packetId ) );
+            break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void samplePublishRtt( MqttClient_t * pClient,
+                              uint16_t packetId )
+{
+    uint8_t index = 0U;
+    uint32_t sampleMs = 0U;
+    uint32_t deviationMs = 0U;
+    bool delaySpike = false;
+
+    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        if( pClient->outgoingPublishPackets[ index ].packetId == packetId )
+        {
+            break;
+        }
+    }
+
+    if( ( index < MAX_OUTGOING_PUBLISHES ) &&
+        ( pClient->outgoingPublishPackets[ index ].pubInfo.dup == false ) )
+    {
+        sampleMs = pClient->mqttContext.getTime() - pClient->outgoingPublishPackets[ index ].sentTimeMs;
+
+        if( pClient->rttEstimator.hasSample == false )
+        {
+            pClient->rttEstimator.smoothedRttMs = sampleMs;
+            pClient->rttEstimator.rttVarianceMs = sampleMs / 2U;
+            pClient->rttEstimator.hasSample = true;
+        }
+        else
+        {
+            /* A sample well above the usual spread means queues are building
+             * up somewhere on the path. */
+            delaySpike = ( sampleMs > ( pClient->rttEstimator.smoothedRttMs + ( 2U * pClient->rttEstimator.rttVarianceMs ) ) );
+
+            deviationMs = ( sampleMs > pClient->rttEstimator.smoothedRttMs ) ?
+                          ( sampleMs - pClient->rttEstimator.smoothedRttMs ) :
+                          ( pClient->rttEstimator.smoothedRttMs - sampleMs );
+
+            /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R */
+            pClient->rttEstimator.rttVarianceMs = ( ( 3U * pClient->rttEstimator.rttVarianceMs ) + deviationMs ) / 4U;
+            pClient->rttEstimator.smoothedRttMs = ( ( 7U * pClient->rttEstimator.smoothedRttMs ) + sampleMs ) / 8U;
+        }
+
+        /* RTO = SRTT + 4 * RTTVAR */
+        pClient->rttEstimator.ackTimeoutMs = pClient->rttEstimator.smoothedRttMs + ( 4U * pClient->rttEstimator.rttVarianceMs );
+
+        if( pClient->rttEstimator.ackTimeoutMs < ACK_TIMEOUT_MIN_MS )
+        {
+            pClient->rttEstimator.ackTimeoutMs = ACK_TIMEOUT_MIN_MS;
+        }
+        else if( pClient->rttEstimator.ackTimeoutMs > ACK_TIMEOUT_MAX_MS )
+        {
+            pClient->rttEstimator.ackTimeoutMs = ACK_TIMEOUT_MAX_MS;
+        }
+
+        /* Grow the window by one per timely PUBACK, shrink it by one when
+         * the delay spikes. */
+        if( delaySpike == true )
+        {
+            if( pClient->rttEstimator.inFlightWindow > 1U )
+            {
+                pClient->rttEstimator.inFlightWindow--;
+            }
+        }
+        else if( pClient->rttEstimator.inFlightWindow < MAX_OUTGOING_PUBLISHES )
+        {
+            pClient->rttEstimator.inFlightWindow++;
+        }
+
+        LogDebug( ( "PUBACK RTT sample=%"PRIu32" ms, SRTT=%"PRIu32" ms, RTTVAR=%"PRIu32" ms, "
+                    "ACK timeout=%"PRIu32" ms, in-flight window=%u.",
+                    sampleMs,
+                    pClient->rttEstimator.smoothedRttMs,
+                    pClient->rttEstimator.rttVarianceMs,
+                    pClient->rttEstimator.ackTimeoutMs,
+                    pClient->rttEstimator.inFlightWindow ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t getAckTimeoutMs( MqttClient_t * pClient )
+{
+    return pClient->rttEstimator.ackTimeoutMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool inFlightWindowHasRoom( MqttClient_t * pClient )
+{
+    uint8_t index = 0U;
+    uint8_t inFlight = 0U;
+    uint32_t now = pClient->mqttContext.getTime();
+
+    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        if( pClient->outgoingPublishPackets[ index ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            inFlight++;
+
+            if( ( pClient->outgoingPublishPackets[ index ].timedOut == false ) &&
+                ( ( now - pClient->outgoingPublishPackets[ index ].sentTimeMs ) > pClient->rttEstimator.ackTimeoutMs ) )
+            {
+                /* Treat it like a retransmission timeout: halve the window
+                 * and back off the timer. */
+                pClient->outgoingPublishPackets[ index ].timedOut = true;
+                pClient->rttEstimator.inFlightWindow = ( uint8_t ) ( pClient->rttEstimator.inFlightWindow / 2U );
+
+                if( pClient->rttEstimator.inFlightWindow == 0U )
+                {
+                    pClient->rttEstimator.inFlightWindow = 1U;
+                }
+
+                pClient->rttEstimator.ackTimeoutMs *= 2U;
+
+                if( pClient->rttEstimator.ackTimeoutMs > ACK_TIMEOUT_MAX_MS )
+                {
+                    pClient->rttEstimator.ackTimeoutMs = ACK_TIMEOUT_MAX_MS;
+                }
+
+                LogWarn( ( "PUBACK for packet id %u overdue. In-flight window=%u, ACK timeout=%"PRIu32" ms.",
+                           pClient->outgoingPublishPackets[ index ].packetId,
+                           pClient->rttEstimator.inFlightWindow,
+                           pClient->rttEstimator.ackTimeoutMs ) );
+            }
+        }
+    }
+
+    return( inFlight < pClient->rttEstimator.inFlightWindow );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t streamingReadBody( MqttClient_t * pClient,
+                                  void * pBuffer,
+                                  size_t bytesToRecv )
+{
+    int32_t result = 0;
+
+    if( bytesToRecv > pClient->streamingReceive.remainingLength )
+    {
+        bytesToRecv = pClient->streamingReceive.remainingLength;
+    }
+
+    if( bytesToRecv > 0U )
+    {
+        result = espTlsTransportRecv( &pClient->networkContext, pBuffer, bytesToRecv );
+    }
+
+    if( result > 0 )
+    {
+        pClient->streamingReceive.remainingLength -= ( size_t ) result;
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t streamOversizedPublish( MqttClient_t * pClient,
+                                       uint8_t * pScratch,
+                                       size_t scratchLength )
+{
+    int32_t result = 0;
+    size_t chunkLength = 0U;
+    uint8_t ackBuffer[ MQTT_PUBLISH_ACK_PACKET_SIZE ];
+    MQTTFixedBuffer_t ackFixedBuffer = { .pBuffer = ackBuffer, .size = sizeof( ackBuffer ) };
+
+    switch( pClient->streamingReceive.state )
+    {
+        case StreamingStateTopicLength:
+        case StreamingStatePacketId:
+            result = streamingReadBody( pClient,
+                                        &pClient->streamingReceive.field[ pClient->streamingReceive.fieldLength ],
+                                        sizeof( pClient->streamingReceive.field ) - pClient->streamingReceive.fieldLength );
+
+            if( result > 0 )
+            {
+                pClient->streamingReceive.fieldLength += ( size_t ) result;
+            }
+
+            if( pClient->streamingReceive.fieldLength < sizeof( pClient->streamingReceive.field ) )
+            {
+                /* Wait for the rest of the field. */
+            }
+            else if( pClient->streamingReceive.state == StreamingStateTopicLength )
+            {
+                pClient->streamingReceive.topicLength = ( uint16_t ) ( ( pClient->streamingReceive.field[ 0 ] << 8 ) |
+                                                              pClient->streamingReceive.field[ 1 ] );
+                pClient->streamingReceive.topicRead = 0U;
+                pClient->streamingReceive.fieldLength = 0U;
+                pClient->streamingReceive.state = StreamingStateTopic;
+
+                if( ( size_t ) pClient->streamingReceive.topicLength +
+                    ( ( pClient->streamingReceive.qos > 0U ) ? 2U : 0U ) > pClient->streamingReceive.remainingLength )
+                {
+                    LogError( ( "Malformed incoming PUBLISH: topic length %u exceeds the packet.",
+                                pClient->streamingReceive.topicLength ) );
+                    result = -1;
+                }
+                else if( pClient->streamingReceive.topicLength > STREAMING_TOPIC_MAX_LENGTH )
+                {
+                    LogError( ( "Dropping incoming PUBLISH with a %u byte topic name.",
+                                pClient->streamingReceive.topicLength ) );
+                    pClient->streamingReceive.discard = true;
+                }
+            }
+            else
+            {
+                pClient->streamingReceive.packetId = ( uint16_t ) ( ( pClient->streamingReceive.field[ 0 ] << 8 ) |
+                                                           pClient->streamingReceive.field[ 1 ] );
+                pClient->streamingReceive.payloadLength = pClient->streamingReceive.remainingLength;
+                pClient->streamingReceive.payloadOffset = 0U;
+                pClient->streamingReceive.state = StreamingStatePayload;
+            }
+
+            break;
+
+        case StreamingStateTopic:
+
+            if( pClient->streamingReceive.discard == false )
+            {
+                result = streamingReadBody( pClient,
+                                            &pClient->streamingReceive.topic[ pClient->streamingReceive.topicRead ],
+                                            pClient->streamingReceive.topicLength - pClient->streamingReceive.topicRead );
+            }
+            else
+            {
+                chunkLength = pClient->streamingReceive.topicLength - pClient->streamingReceive.topicRead;
+                result = streamingReadBody( pClient,
+                                            pScratch,
+                                            ( chunkLength < scratchLength ) ? chunkLength : scratchLength );
+            }
+
+            if( result > 0 )
+            {
+                pClient->streamingReceive.topicRead += ( uint16_t ) result;
+            }
+
+            if( pClient->streamingReceive.topicRead == pClient->streamingReceive.topicLength )
+            {
+                if( pClient->streamingReceive.qos > 0U )
+                {
+                    pClient->streamingReceive.state = StreamingStatePacketId;
+                }
+                else
+                {
+                    pClient->streamingReceive.payloadLength = pClient->streamingReceive.remainingLength;
+                    pClient->streamingReceive.payloadOffset = 0U;
+                    pClient->streamingReceive.state = StreamingStatePayload;
+                }
+            }
+
+            break;
+
+        case StreamingStatePayload:
+            result = streamingReadBody( pClient, pScratch, scratchLength );
+
+            if( result > 0 )
+            {
+                if( pClient->streamingReceive.discard == false )
+                {
+                    pClient->streamingPublishCallback( pClient,
+                                                       pClient->streamingReceive.topic,
+                                                       pClient->streamingReceive.topicLength,
+                                                       pScratch,
+                                                       ( size_t ) result,
+                                                       pClient->streamingReceive.payloadOffset,
+                                                       pClient->streamingReceive.payloadLength );
+                }
+
+                pClient->streamingReceive.payloadOffset += ( size_t ) result;
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    if( ( result >= 0 ) &&
+        ( pClient->streamingReceive.state == StreamingStatePayload ) &&
+        ( pClient->streamingReceive.remainingLength == 0U ) )
+    {
+        /* The whole publish was consumed. coreMQTT never saw it, so the
+         * PUBACK is sent from here. */
+        if( pClient->streamingReceive.qos == 1U )
+        {
+            if( ( MQTT_SerializeAck( &ackFixedBuffer, MQTT_PACKET_TYPE_PUBACK, pClient->streamingReceive.packetId ) != MQTTSuccess ) ||
+                ( clientTransportSend( &pClient->networkContext, ackBuffer, sizeof( ackBuffer ) ) != ( int32_t ) sizeof( ackBuffer ) ) )
+            {
+                LogError( ( "Failed to send PUBACK for streamed PUBLISH with packet id %u.",
+                            pClient->streamingReceive.packetId ) );
+                result = -1;
+            }
+        }
+
+        LogDebug( ( "Streamed incoming PUBLISH on %.*s with %lu bytes of payload.",
+                    pClient->streamingReceive.topicLength,
+                    pClient->streamingReceive.topic,
+                    ( unsigned long ) pClient->streamingReceive.payloadLength ) );
+
+        pClient->streamingReceive.state = StreamingStateHeader;
+        pClient->streamingReceive.headerLength = 0U;
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t streamingTransportRecv( NetworkContext_t * pNetworkContext,
+                                       void * pBuffer,
+                                       size_t bytesToRecv )
+{
+    int32_t result = 0;
+    int32_t bytesReceived = 0;
+    size_t headerBytes = 0U;
+    size_t index = 0U;
+    uint8_t * pBytes = ( uint8_t * ) pBuffer;
+    bool keepReading = ( bytesToRecv > 0U );
+    MqttClient_t * pClient = ( MqttClient_t * ) ( ( uint8_t * ) pNetworkContext -
+                                                  offsetof( MqttClient_t, networkContext ) );
+
+    #ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+        if( flushWritesBeforeReceive( pClient ) != EXIT_SUCCESS )
+        {
+            return -1;
+        }
+    #endif
+
+    /* Keep going until coreMQTT gets data, the network runs dry or fails. A
+     * whole oversized publish is consumed here if the network keeps up. */
+    while( keepReading == true )
+    {
+        if( pClient->streamingReceive.state == StreamingStateHeader )
+        {
+            result = espTlsTransportRecv( pNetworkContext,
+                                          &pClient->streamingReceive.header[ pClient->streamingReceive.headerLength ],
+                                          1U );
+
+            if( result > 0 )
+            {
+                pClient->streamingReceive.headerLength++;
+
+                if( ( pClient->streamingReceive.headerLength >= 2U ) &&
+                    ( ( pClient->streamingReceive.header[ pClient->streamingReceive.headerLength - 1U ] & 0x80U ) == 0U ) )
+                {
+                    /* Decode the remaining length. */
+                    pClient->streamingReceive.remainingLength = 0U;
+
+                    for( index = pClient->streamingReceive.headerLength - 1U; index > 0U; index-- )
+                    {
+                        pClient->streamingReceive.remainingLength = ( pClient->streamingReceive.remainingLength << 7 ) |
+                                                           ( pClient->streamingReceive.header[ index ] & 0x7FU );
+                    }
+
+                    pClient->streamingReceive.headerSent = 0U;
+
+                    if( ( ( pClient->streamingReceive.header[ 0 ] & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH ) &&
+                        ( ( pClient->streamingReceive.headerLength + pClient->streamingReceive.remainingLength ) > NETWORK_BUFFER_SIZE ) )
+                    {
+                        pClient->streamingReceive.qos = ( uint8_t ) ( ( pClient->streamingReceive.header[ 0 ] >> 1 ) & 0x03U );
+                        pClient->streamingReceive.fieldLength = 0U;
+                        pClient->streamingReceive.discard = ( pClient->streamingPublishCallback == NULL );
+                        pClient->streamingReceive.state = StreamingStateTopicLength;
+
+                        if( pClient->streamingReceive.discard == true )
+                        {
+                            LogWarn( ( "Dropping incoming PUBLISH of %lu bytes: no streaming handler is set.",
+                                       ( unsigned long ) pClient->streamingReceive.remainingLength ) );
+                        }
+
+                        if( pClient->streamingReceive.qos > 1U )
+                        {
+                            /* The QoS2 handshake is left to coreMQTT, which
+                             * cannot hold this packet. */
+                            LogError( ( "Cannot stream an incoming QoS2 PUBLISH." ) );
+                            result = -1;
+                        }
+                    }
+                    else
+                    {
+                        pClient->streamingReceive.state = StreamingStatePassThrough;
+                    }
+                }
+                else if( pClient->streamingReceive.headerLength == MQTT_FIXED_HEADER_MAX_LENGTH )
+                {
+                    LogError( ( "Malformed remaining length in incoming packet." ) );
+                    result = -1;
+                }
+            }
+        }
+        else if( pClient->streamingReceive.state == StreamingStatePassThrough )
+        {
+            /* Hand over the fixed header, then as much of the body as fits,
+             * but never bytes of the next packet. */
+            headerBytes = pClient->streamingReceive.headerLength - pClient->streamingReceive.headerSent;
+
+            if( headerBytes > bytesToRecv )
+            {
+                headerBytes = bytesToRecv;
+            }
+
+            ( void ) memcpy( pBytes, &pClient->streamingReceive.header[ pClient->streamingReceive.headerSent ], headerBytes );
+            pClient->streamingReceive.headerSent += headerBytes;
+            bytesReceived = ( int32_t ) headerBytes;
+
+            result = streamingReadBody( pClient,
+                                        &pBytes[ headerBytes ],
+                                        bytesToRecv - headerBytes );
+
+            if( result > 0 )
+            {
+                bytesReceived += result;
+            }
+            else if( bytesReceived > 0 )
+            {
+                /* Report the header now; an error shows up on the next call. */
+                result = 0;
+            }
+
+            if( ( pClient->streamingReceive.headerSent == pClient->streamingReceive.headerLength ) &&
+                ( pClient->streamingReceive.remainingLength == 0U ) )
+            {
+                pClient->streamingReceive.state = StreamingStateHeader;
+                pClient->streamingReceive.headerLength = 0U;
+            }
+        }
+        else
+        {
+            result = streamOversizedPublish( pClient, pBytes, bytesToRecv );
+        }
+
+        keepReading = ( bytesReceived == 0 ) && ( result > 0 );
+    }
+
+    return ( result < 0 ) ? result : bytesReceived;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t clientTransportSend( NetworkContext_t * pNetworkContext,
+                                    const void * pBuffer,
+                                    size_t bytesToSend )
+{
+    #ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+        MqttClient_t * pClient = ( MqttClient_t * ) ( ( uint8_t * ) pNetworkContext -
+                                                      offsetof( MqttClient_t, networkContext ) );
+
+        return TlsWriteCoalescer_Send( &pClient->writeCoalescer, pBuffer, bytesToSend );
+    #else
+        return espTlsTransportSend( pNetworkContext, pBuffer, bytesToSend );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+#ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+
+    static int flushWritesBeforeReceive( MqttClient_t * pClient )
+    {
+        TlsWriteCoalescerStatus_t status = TlsWriteCoalescerSuccess;
+        esp_tls_t * pTls = pClient->networkContext.pxTls;
+        bool incomingDataReady = false;
+        int socket = -1;
+        fd_set readSet;
+        struct timeval noWait = { 0 };
+
+        status = TlsWriteCoalescer_FlushIfDue( &pClient->writeCoalescer );
+
+        if( ( status == TlsWriteCoalescerSuccess ) &&
+            ( TlsWriteCoalescer_HasPending( &pClient->writeCoalescer ) == true ) )
+        {
+            /* Data is ready if mbedTLS holds decrypted bytes of the current
+             * record, or the socket has more. */
+            if( ( pTls != NULL ) && ( esp_tls_get_bytes_avail( pTls ) > 0 ) )
+            {
+                incomingDataReady = true;
+            }
+            else if( ( pTls != NULL ) && ( esp_tls_get_conn_sockfd( pTls, &socket ) == ESP_OK ) && ( socket >= 0 ) )
+            {
+                FD_ZERO( &readSet );
+                FD_SET( socket, &readSet );
+                incomingDataReady = ( select( socket + 1, &readSet, NULL, NULL, &noWait ) > 0 );
+            }
+
+            if( incomingDataReady == false )
+            {
+                status = TlsWriteCoalescer_Flush( &pClient->writeCoalescer );
+            }
+        }
+
+        if( status != TlsWriteCoalescerSuccess )
         {
-            returnStatus = EXIT_SUCCESS;
-            break;
+            LogError( ( "Failed to send the coalesced writes to the broker." ) );
         }
-    }
 
-    /* Copy the available index into the output param. */
-    *pIndex = index;
+        return ( status == TlsWriteCoalescerSuccess ) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    return returnStatus;
-}
 /*-----------------------------------------------------------*/
 
-static void cleanupOutgoingPublishAt( uint8_t index )
+#endif /* ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING */
+
+static int allocateNetworkBuffer( MqttClient_t * pClient )
 {
-    assert( outgoingPublishPackets != NULL );
-    assert( index < MAX_OUTGOING_PUBLISHES );
+    int returnStatus = EXIT_SUCCESS;
 
-    /* Clear the outgoing publish packet. */
-    ( void ) memset( &( outgoingPublishPackets[ index ] ),
-                     0x00,
-                     sizeof( outgoingPublishPackets[ index ] ) );
-}
+#ifdef CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE
+    LogInfo( ( "Free internal heap after TLS handshake: %lu bytes, minimum so far: %lu bytes.",
+               ( unsigned long ) heap_caps_get_free_size( MALLOC_CAP_INTERNAL ),
+               ( unsigned long ) heap_caps_get_minimum_free_size( MALLOC_CAP_INTERNAL ) ) );
 
-/*-----------------------------------------------------------*/
+    if( pClient->pNetworkBuffer == NULL )
+    {
+        pClient->pNetworkBuffer = heap_caps_malloc( NETWORK_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT );
+    }
 
-static void cleanupOutgoingPublishes( void )
-{
-    assert( outgoingPublishPackets != NULL );
+    if( pClient->pNetworkBuffer == NULL )
+    {
+        LogError( ( "Failed to allocate the %u byte MQTT network buffer.",
+                    NETWORK_BUFFER_SIZE ) );
+        returnStatus = EXIT_FAILURE;
+    }
+#endif /* CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE */
 
-    /* Clean up all the outgoing publish packets. */
-    ( void ) memset( outgoingPublishPackets, 0x00, sizeof( outgoingPublishPackets ) );
+    return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
 
-static void cleanupOutgoingPublishWithPacketID( uint16_t packetId )
+static void freeNetworkBuffer( MqttClient_t * pClient )
 {
-    uint8_t index = 0;
-
-    assert( outgoingPublishPackets != NULL );
-    assert( packetId != MQTT_PACKET_ID_INVALID );
-
-    /* Clean up all the saved outgoing publishes. */
-    for( ; index < MAX_OUTGOING_PUBLISHES; index++ )
-    {
-        if( outgoingPublishPackets[ index ].packetId == packetId )
-        {
-            cleanupOutgoingPublishAt( index );
-            LogInfo( ( "Cleaned up outgoing publish packet with packet id %u.",
-                       packetId ) );
-            break;
-        }
-    }
+#ifdef CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE
+    heap_caps_free( pClient->pNetworkBuffer );
+    pClient->pNetworkBuffer = NULL;
+#endif /* CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE */
 }
 
 /*-----------------------------------------------------------*/
 
-static int waitForPacketAck( MQTTContext_t * pMqttContext,
+static int waitForPacketAck( MqttClient_t * pClient,
                              uint16_t usPacketIdentifier,
                              uint32_t ulTimeout )
 {
@@ -567,9 +1895,10 @@ static int waitForPacketAck( MQTTContext_t * pMqttContext,
 
     MQTTStatus_t eMqttStatus = MQTTSuccess;
     int returnStatus = EXIT_FAILURE;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
 
     /* Reset the ACK packet identifier being received. */
-    globalAckPacketIdentifier = 0U;
+    pClient->ackPacketIdentifier = 0U;
 
     ulCurrentTime = pMqttContext->getTime();
     ulMqttProcessLoopEntryTime = ulCurrentTime;
@@ -577,18 +1906,18 @@ static int waitForPacketAck( MQTTContext_t * pMqttContext,
 
     /* Call MQTT_ProcessLoop multiple times until the expected packet ACK
      * is received, a timeout happens, or MQTT_ProcessLoop fails. */
-    while( ( globalAckPacketIdentifier != usPacketIdentifier ) &&
+    while( ( pClient->ackPacketIdentifier != usPacketIdentifier ) &&
            ( ulCurrentTime < ulMqttProcessLoopTimeoutTime ) &&
            ( eMqttStatus == MQTTSuccess || eMqttStatus == MQTTNeedMoreBytes ) )
     {
-        /* Event callback will set #globalAckPacketIdentifier when receiving
+        /* Event callback will set #MqttClient::ackPacketIdentifier when receiving
          * appropriate packet. */
         eMqttStatus = MQTT_ProcessLoop( pMqttContext );
         ulCurrentTime = pMqttContext->getTime();
     }
 
     if( ( ( eMqttStatus != MQTTSuccess ) && ( eMqttStatus != MQTTNeedMoreBytes ) ) ||
-        ( globalAckPacketIdentifier != usPacketIdentifier ) )
+        ( pClient->ackPacketIdentifier != usPacketIdentifier ) )
     {
         LogError( ( "MQTT_ProcessLoop failed to receive ACK packet: Expected ACK Packet ID=%08"PRIx16", LoopDuration=%"PRIu32", Status=%s",
                     usPacketIdentifier,
@@ -630,26 +1959,228 @@ static MQTTStatus_t processLoopWithTimeout( MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
-void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
+static int publishQoS0( MqttClient_t * pClient,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
+    MQTTPublishInfo_t publishInfo;
+
+    assert( pMqttContext != NULL );
+
+    /* QoS0 publishes are fire-and-forget. They are neither stored in
+     * #outgoingPublishPackets nor tracked by the coreMQTT outgoing publish
+     * records, so they never compete with QoS1 shadow updates for a slot. */
+    ( void ) memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = pTopicFilter;
+    publishInfo.topicNameLength = ( uint16_t ) topicFilterLength;
+    publishInfo.pPayload = pPayload;
+    publishInfo.payloadLength = payloadLength;
+
+    /* The packet identifier is unused for QoS0. */
+    mqttStatus = MQTT_Publish( pMqttContext, &publishInfo, MQTT_PACKET_ID_INVALID );
+
+    if( mqttStatus != MQTTSuccess )
+    {
+        LogError( ( "Failed to send QoS0 PUBLISH packet to broker with error = %u.",
+                    mqttStatus ) );
+        returnStatus = EXIT_FAILURE;
+    }
+    else if( FlushPendingWrites( pClient ) != EXIT_SUCCESS )
+    {
+        /* Without a process loop nothing else would send the coalesced
+         * packet if the application goes idle, so it is sent now. The
+         * header, topic and payload still go out as one TLS record. */
+        returnStatus = EXIT_FAILURE;
+    }
+    else
+    {
+        /* No process loop is run here: there is no ACK to wait for, and
+         * high-rate telemetry should not block for a full process loop
+         * timeout on every message. Incoming packets are processed by the
+         * next QoS1 operation or by #ProcessIncomingPackets. */
+        LogDebug( ( "QoS0 PUBLISH sent for topic %.*s with %lu bytes of payload.",
+                    ( int ) topicFilterLength,
+                    pTopicFilter,
+                    ( unsigned long ) payloadLength ) );
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static int publishQoS1( MqttClient_t * pClient,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength,
+                        uint32_t processLoopTimeoutMs )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
+
+    uint32_t windowDeadline = 0U;
+
+    assert( pMqttContext != NULL );
+
+    /* Wait for PUBACKs to open the in-flight window, for at most one ACK
+     * timeout. */
+    windowDeadline = pMqttContext->getTime() + getAckTimeoutMs( pClient );
+
+    while( ( inFlightWindowHasRoom( pClient ) == false ) &&
+           ( pMqttContext->getTime() < windowDeadline ) )
+    {
+        mqttStatus = MQTT_ProcessLoop( pMqttContext );
+
+        if( ( mqttStatus != MQTTSuccess ) && ( mqttStatus != MQTTNeedMoreBytes ) )
+        {
+            break;
+        }
+    }
+
+    /* Get the next free index for the outgoing publish. All QoS1 outgoing
+     * publishes are stored until a PUBACK is received. These messages are
+     * stored for supporting a resend if a network connection is broken before
+     * receiving a PUBACK. */
+    if( inFlightWindowHasRoom( pClient ) == false )
+    {
+        LogError( ( "In-flight window of %u publishes is full.",
+                    pClient->rttEstimator.inFlightWindow ) );
+        returnStatus = EXIT_FAILURE;
+    }
+    else
+    {
+        returnStatus = getNextFreeIndexForOutgoingPublishes( pClient, &publishIndex );
+    }
+
+    if( returnStatus == EXIT_FAILURE )
+    {
+        LogError( ( "Unable to find a free spot for outgoing PUBLISH message." ) );
+    }
+    else
+    {
+        LogInfo( ( "Published payload: %s", pPayload ) );
+        pClient->outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS1;
+        pClient->outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = pTopicFilter;
+        pClient->outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = topicFilterLength;
+        pClient->outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = pPayload;
+        pClient->outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = payloadLength;
+
+        /* Get a new packet id. */
+        pClient->outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
+        pClient->outgoingPublishPackets[ publishIndex ].sentTimeMs = pMqttContext->getTime();
+
+        /* Send PUBLISH packet. */
+        mqttStatus = MQTT_Publish( pMqttContext,
+                                   &pClient->outgoingPublishPackets[ publishIndex ].pubInfo,
+                                   pClient->outgoingPublishPackets[ publishIndex ].packetId );
+
+        if( mqttStatus != MQTTSuccess )
+        {
+            LogError( ( "Failed to send PUBLISH packet to broker with error = %u.",
+                        mqttStatus ) );
+            cleanupOutgoingPublishAt( pClient, publishIndex );
+            returnStatus = EXIT_FAILURE;
+        }
+        else
+        {
+            LogInfo( ( "PUBLISH sent for topic %.*s to broker with packet ID %u.",
+                       (int) topicFilterLength,
+                       pTopicFilter,
+                       pClient->outgoingPublishPackets[ publishIndex ].packetId ) );
+
+            /* Calling MQTT_ProcessLoop to process incoming publish echo, since
+             * application subscribed to the same topic the broker will send
+             * publish message back to the application. This function also
+             * sends ping request to broker if MQTT_KEEP_ALIVE_INTERVAL_SECONDS
+             * has expired since the last MQTT packet sent and receive
+             * ping responses. */
+            mqttStatus = processLoopWithTimeout( &pClient->mqttContext, processLoopTimeoutMs );
+
+            if( ( mqttStatus != MQTTSuccess ) && ( mqttStatus != MQTTNeedMoreBytes ) )
+            {
+                LogWarn( ( "MQTT_ProcessLoop returned with status = %u.",
+                           mqttStatus ) );
+            }
+        }
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool dequeueOutboundPublish( MqttClient_t * pClient,
+                                    OutboundPublish_t * pPublish )
+{
+    bool dequeued = false;
+    bool slotAvailable = false;
+    uint8_t freeIndex = 0U;
+    OutboundLane_t * pLane = NULL;
+    uint8_t lane = 0U;
+
+    assert( pPublish != NULL );
+
+    /* The outgoing publish packets are only touched by the MQTT task, so
+     * they can be inspected outside of the lanes lock. */
+    slotAvailable = ( inFlightWindowHasRoom( pClient ) == true ) &&
+                    ( getNextFreeIndexForOutgoingPublishes( pClient, &freeIndex ) == EXIT_SUCCESS );
+
+    portENTER_CRITICAL( &pClient->outboundLanesLock );
+
+    for( lane = 0U; ( lane < ( uint8_t ) OutboundPriorityMax ) && ( dequeued == false ); lane++ )
+    {
+        pLane = &pClient->outboundLanes[ lane ];
+
+        if( ( pLane->count > 0U ) &&
+            ( ( pLane->entries[ pLane->head ].qos == MQTTQoS0 ) || ( slotAvailable == true ) ) )
+        {
+            *pPublish = pLane->entries[ pLane->head ];
+            pLane->head = ( uint8_t ) ( ( pLane->head + 1U ) % OUTBOUND_LANE_LENGTH );
+            pLane->count--;
+            dequeued = true;
+        }
+    }
+
+    portEXIT_CRITICAL( &pClient->outboundLanesLock );
+
+    return dequeued;
+}
+
+/*-----------------------------------------------------------*/
+
+void HandleOtherIncomingPacket( MQTTContext_t * pMqttContext,
+                                MQTTPacketInfo_t * pPacketInfo,
                                 uint16_t packetIdentifier )
 {
+    MqttClient_t * pClient = ( MqttClient_t * ) ( ( uint8_t * ) pMqttContext -
+                                                  offsetof( MqttClient_t, mqttContext ) );
+
     /* Handle other packets. */
     switch( pPacketInfo->type )
     {
         case MQTT_PACKET_TYPE_SUBACK:
             LogInfo( ( "MQTT_PACKET_TYPE_SUBACK." ) );
             /* Make sure ACK packet identifier matches with Request packet identifier. */
-            assert( globalSubscribePacketIdentifier == packetIdentifier );
+            assert( pClient->subscribePacketIdentifier == packetIdentifier );
             /* Update the global ACK packet identifier. */
-            globalAckPacketIdentifier = packetIdentifier;
+            pClient->ackPacketIdentifier = packetIdentifier;
             break;
 
         case MQTT_PACKET_TYPE_UNSUBACK:
             LogInfo( ( "MQTT_PACKET_TYPE_UNSUBACK." ) );
             /* Make sure ACK packet identifier matches with Request packet identifier. */
-            assert( globalUnsubscribePacketIdentifier == packetIdentifier );
+            assert( pClient->unsubscribePacketIdentifier == packetIdentifier );
             /* Update the global ACK packet identifier. */
-            globalAckPacketIdentifier = packetIdentifier;
+            pClient->ackPacketIdentifier = packetIdentifier;
             break;
 
         case MQTT_PACKET_TYPE_PINGRESP:
@@ -660,70 +2191,276 @@ void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
                        "callback when using MQTT_ProcessLoop." ) );
             break;
 
-        case MQTT_PACKET_TYPE_PUBACK:
-            LogInfo( ( "PUBACK received for packet id %u.",
-                       packetIdentifier ) );
-            /* Cleanup publish packet when a PUBACK is received. */
-            cleanupOutgoingPublishWithPacketID( packetIdentifier );
-            /* Update the global ACK packet identifier. */
-            globalAckPacketIdentifier = packetIdentifier;
-            break;
+        case MQTT_PACKET_TYPE_PUBACK:
+            LogInfo( ( "PUBACK received for packet id %u.",
+                       packetIdentifier ) );
+            /* Update the round trip time estimate before the publish
+             * and its send time are cleaned up. */
+            samplePublishRtt( pClient, packetIdentifier );
+            /* Cleanup publish packet when a PUBACK is received. */
+            cleanupOutgoingPublishWithPacketID( pClient, packetIdentifier );
+            /* Update the global ACK packet identifier. */
+            pClient->ackPacketIdentifier = packetIdentifier;
+            break;
+
+        /* Any other packet type is invalid. */
+        default:
+            LogError( ( "Unknown packet type received:(%02x).",
+                        pPacketInfo->type ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t countUnackedPublishes( MqttClient_t * pClient,
+                                      const uint16_t * pPacketIds,
+                                      uint8_t packetIdCount )
+{
+    uint8_t unacked = 0U;
+    uint8_t i = 0U;
+    uint8_t index = 0U;
+
+    assert( pPacketIds != NULL );
+
+    for( i = 0U; i < packetIdCount; i++ )
+    {
+        for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+        {
+            if( pClient->outgoingPublishPackets[ index ].packetId == pPacketIds[ i ] )
+            {
+                unacked++;
+                break;
+            }
+        }
+    }
+
+    return unacked;
+}
+
+/*-----------------------------------------------------------*/
+
+static int handlePublishResend( MqttClient_t * pClient )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+    uint8_t index = 0U;
+    bool resendPending[ MAX_OUTGOING_PUBLISHES ] = { false };
+    uint16_t roundPacketIds[ MAX_OUTGOING_PUBLISHES ];
+    uint8_t pendingCount = 0U;
+    uint8_t window = RESEND_INITIAL_WINDOW;
+    uint8_t roundSent = 0U;
+    uint8_t roundFailed = 0U;
+    uint8_t unacked = 0U;
+    uint32_t roundDeadline = 0U;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
+
+    assert( pClient != NULL );
+
+    /* Resend all the QoS1 publishes still in the array. These are the
+     * publishes that hasn't received a PUBACK. When a PUBACK is
+     * received, the publish is removed from the array. */
+    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+    {
+        if( pClient->outgoingPublishPackets[ index ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            resendPending[ index ] = true;
+            pendingCount++;
+        }
+    }
+
+    while( pendingCount > 0U )
+    {
+        roundSent = 0U;
+        roundFailed = 0U;
+
+        for( index = 0U; ( index < MAX_OUTGOING_PUBLISHES ) && ( roundSent < window ); index++ )
+        {
+            /* The PUBACK of a previous round may have freed the entry. */
+            if( ( resendPending[ index ] == false ) ||
+                ( pClient->outgoingPublishPackets[ index ].packetId == MQTT_PACKET_ID_INVALID ) )
+            {
+                if( resendPending[ index ] == true )
+                {
+                    resendPending[ index ] = false;
+                    pendingCount--;
+                }
+
+                continue;
+            }
+
+            resendPending[ index ] = false;
+            pendingCount--;
+
+            if( roundSent > 0U )
+            {
+                /* Pace the resends of a round. */
+                ( void ) processLoopWithTimeout( pMqttContext, RESEND_PACING_INTERVAL_MS );
+            }
+
+            pClient->outgoingPublishPackets[ index ].pubInfo.dup = true;
+            pClient->outgoingPublishPackets[ index ].sentTimeMs = pMqttContext->getTime();
+            pClient->outgoingPublishPackets[ index ].timedOut = false;
+
+            LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
+                       pClient->outgoingPublishPackets[ index ].packetId ) );
+            mqttStatus = MQTT_Publish( pMqttContext,
+                                       &pClient->outgoingPublishPackets[ index ].pubInfo,
+                                       pClient->outgoingPublishPackets[ index ].packetId );
+
+            if( mqttStatus != MQTTSuccess )
+            {
+                /* Keep the publish stored; it is resent with the next
+                 * session instead of tearing this one down. */
+                LogWarn( ( "Sending duplicate PUBLISH for packet id %u "
+                           " failed with status %u. Keeping it for the next session.",
+                           pClient->outgoingPublishPackets[ index ].packetId,
+                           mqttStatus ) );
+                roundFailed++;
+            }
+            else
+            {
+                LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.",
+                           pClient->outgoingPublishPackets[ index ].packetId ) );
+                roundPacketIds[ roundSent ] = pClient->outgoingPublishPackets[ index ].packetId;
+                roundSent++;
+            }
+        }
+
+        if( roundSent == 0U )
+        {
+            if( roundFailed > 0U )
+            {
+                /* Nothing went out in this round, so the connection is not
+                 * usable for resends right now. */
+                LogWarn( ( "No duplicate PUBLISH could be sent in this round. "
+                           "Leaving the %u remaining publishes for the next session.",
+                           ( unsigned int ) ( pendingCount + roundFailed ) ) );
+            }
+
+            break;
+        }
+
+        /* Wait for the PUBACKs of this round. */
+        roundDeadline = pMqttContext->getTime() + RESEND_ROUND_TIMEOUT_MS( pClient );
+        unacked = countUnackedPublishes( pClient, roundPacketIds, roundSent );
+
+        while( ( unacked > 0U ) && ( pMqttContext->getTime() < roundDeadline ) )
+        {
+            mqttStatus = MQTT_ProcessLoop( pMqttContext );
+
+            if( ( mqttStatus != MQTTSuccess ) && ( mqttStatus != MQTTNeedMoreBytes ) )
+            {
+                break;
+            }
+
+            unacked = countUnackedPublishes( pClient, roundPacketIds, roundSent );
+        }
+
+        if( ( unacked == 0U ) && ( roundFailed == 0U ) )
+        {
+            /* Every PUBACK arrived in time, open the window. */
+            window = ( uint8_t ) ( window * 2U );
+
+            if( window > MAX_OUTGOING_PUBLISHES )
+            {
+                window = MAX_OUTGOING_PUBLISHES;
+            }
+        }
+        else
+        {
+            /* The round timed out or partially failed, back off. */
+            window = ( uint8_t ) ( window / 2U );
+
+            if( window < RESEND_INITIAL_WINDOW )
+            {
+                window = RESEND_INITIAL_WINDOW;
+            }
+        }
 
-        /* Any other packet type is invalid. */
-        default:
-            LogError( ( "Unknown packet type received:(%02x).",
-                        pPacketInfo->type ) );
+        LogDebug( ( "Resend round: sent=%u, unacked=%u, failed=%u, next window=%u.",
+                    roundSent, unacked, roundFailed, window ) );
     }
+
+    return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
 
-static int handlePublishResend( MQTTContext_t * pMqttContext )
+MqttClient_t * CreateMqttClient( const MqttClientConfig_t * pConfig )
 {
-    int returnStatus = EXIT_SUCCESS;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t index = 0U;
+    MqttClient_t * pClient = NULL;
+    size_t index = 0U;
 
-    assert( outgoingPublishPackets != NULL );
+    portENTER_CRITICAL( &mqttClientPoolLock );
 
-    /* Resend all the QoS1 publishes still in the array. These are the
-     * publishes that hasn't received a PUBACK. When a PUBACK is
-     * received, the publish is removed from the array. */
-    for( index = 0U; index < MAX_OUTGOING_PUBLISHES; index++ )
+    for( index = 0U; index < MQTT_CLIENT_POOL_SIZE; index++ )
     {
-        if( outgoingPublishPackets[ index ].packetId != MQTT_PACKET_ID_INVALID )
+        if( mqttClientPool[ index ].inUse == false )
         {
-            outgoingPublishPackets[ index ].pubInfo.dup = true;
+            pClient = &mqttClientPool[ index ];
+            pClient->inUse = true;
+            break;
+        }
+    }
 
-            LogInfo( ( "Sending duplicate PUBLISH with packet id %u.",
-                       outgoingPublishPackets[ index ].packetId ) );
-            mqttStatus = MQTT_Publish( pMqttContext,
-                                       &outgoingPublishPackets[ index ].pubInfo,
-                                       outgoingPublishPackets[ index ].packetId );
+    portEXIT_CRITICAL( &mqttClientPoolLock );
 
-            if( mqttStatus != MQTTSuccess )
-            {
-                LogError( ( "Sending duplicate PUBLISH for packet id %u "
-                            " failed with status %u.",
-                            outgoingPublishPackets[ index ].packetId,
-                            mqttStatus ) );
-                returnStatus = EXIT_FAILURE;
-                break;
-            }
-            else
-            {
-                LogInfo( ( "Sent duplicate PUBLISH successfully for packet id %u.",
-                           outgoingPublishPackets[ index ].packetId ) );
-            }
+    if( pClient == NULL )
+    {
+        LogError( ( "All %u MQTT clients are in use.",
+                    ( unsigned int ) MQTT_CLIENT_POOL_SIZE ) );
+    }
+    else
+    {
+        ( void ) memset( pClient, 0x00, offsetof( MqttClient_t, inUse ) );
+
+        if( pConfig != NULL )
+        {
+            pClient->config = *pConfig;
         }
+        else
+        {
+            pClient->config.pHostName = AWS_IOT_ENDPOINT;
+            pClient->config.port = AWS_MQTT_PORT;
+            pClient->config.pClientIdentifier = CLIENT_IDENTIFIER;
+            pClient->config.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+        }
+
+        pClient->rttEstimator.ackTimeoutMs = MQTT_PROCESS_LOOP_TIMEOUT_MS;
+        pClient->rttEstimator.inFlightWindow = INFLIGHT_WINDOW_INITIAL;
+        portMUX_INITIALIZE( &pClient->outboundLanesLock );
+        ReconnectBackoff_Init( &pClient->reconnectBackoff,
+                               CONNECTION_RETRY_BACKOFF_BASE_MS,
+                               CONNECTION_RETRY_MAX_BACKOFF_DELAY_MS,
+                               CONNECTION_RETRY_MAX_ATTEMPTS );
+
+        #ifndef CONFIG_EXAMPLE_LOW_MEMORY_TLS_PROFILE
+            pClient->pNetworkBuffer = networkBufferPool[ index ];
+        #endif
     }
 
-    return returnStatus;
+    return pClient;
+}
+
+/*-----------------------------------------------------------*/
+
+void ReleaseMqttClient( MqttClient_t * pClient )
+{
+    assert( pClient != NULL );
+
+    freeNetworkBuffer( pClient );
+
+    cleanupESPSecureMgrCerts( pClient );
+
+    portENTER_CRITICAL( &mqttClientPoolLock );
+    pClient->inUse = false;
+    portEXIT_CRITICAL( &mqttClientPoolLock );
 }
 
 /*-----------------------------------------------------------*/
 
-int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
+int32_t EstablishMqttSession( MqttClient_t * pClient,
+                              MQTTEventCallback_t eventCallback )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus;
@@ -731,10 +2468,12 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
     MQTTFixedBuffer_t networkBuffer;
     TransportInterface_t transport = { 0 };
     bool createCleanSession = false;
-    MQTTContext_t * pMqttContext = &mqttContext;
-    NetworkContext_t * pNetworkContext = &networkContext;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
     bool sessionPresent = false;
 
+    assert( pClient != NULL );
+
     assert( pMqttContext != NULL );
     assert( pNetworkContext != NULL );
 
@@ -742,15 +2481,21 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
     ( void ) memset( pMqttContext, 0U, sizeof( MQTTContext_t ) );
     ( void ) memset( pNetworkContext, 0U, sizeof( NetworkContext_t ) );
 
-    returnStatus = connectToServerWithBackoffRetries( pNetworkContext );
+    returnStatus = connectToServerWithBackoffRetries( pClient );
+
+    if( ( returnStatus == EXIT_SUCCESS ) &&
+        ( allocateNetworkBuffer( pClient ) != EXIT_SUCCESS ) )
+    {
+        ( void ) xTlsDisconnect( pNetworkContext );
+        returnStatus = EXIT_FAILURE;
+    }
 
     if( returnStatus != EXIT_SUCCESS )
     {
         /* Log error to indicate connection failure after all
          * reconnect attempts are over. */
-        LogError( ( "Failed to connect to MQTT broker %.*s.",
-                    AWS_IOT_ENDPOINT_LENGTH,
-                    AWS_IOT_ENDPOINT ) );
+        LogError( ( "Failed to connect to MQTT broker %s.",
+                    pClient->config.pHostName ) );
     }
     else
     {
@@ -758,12 +2503,22 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
          * For this demo, TCP sockets are used to send and receive data
          * from network. Network context is SSL context for OpenSSL.*/
         transport.pNetworkContext = pNetworkContext;
-        transport.send = espTlsTransportSend;
-        transport.recv = espTlsTransportRecv;
+        transport.send = clientTransportSend;
+        transport.recv = streamingTransportRecv;
+        ( void ) memset( &pClient->streamingReceive, 0x00, sizeof( pClient->streamingReceive ) );
         transport.writev = NULL;
 
+        #ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+            TlsWriteCoalescer_Init( &pClient->writeCoalescer,
+                                    pNetworkContext,
+                                    espTlsTransportSend,
+                                    pClient->writeCoalescingBuffer,
+                                    sizeof( pClient->writeCoalescingBuffer ),
+                                    TLS_WRITE_COALESCING_WINDOW_MS );
+        #endif
+
         /* Fill the values for network buffer. */
-        networkBuffer.pBuffer = buffer;
+        networkBuffer.pBuffer = pClient->pNetworkBuffer;
         networkBuffer.size = NETWORK_BUFFER_SIZE;
 
         /* Initialize MQTT library. */
@@ -781,9 +2536,9 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
         else
         {
             mqttStatus = MQTT_InitStatefulQoS( pMqttContext,
-                                               pOutgoingPublishRecords,
+                                               pClient->outgoingPublishRecords,
                                                OUTGOING_PUBLISH_RECORD_LEN,
-                                               pIncomingPublishRecords,
+                                               pClient->incomingPublishRecords,
                                                INCOMING_PUBLISH_RECORD_LEN );
 
             if( mqttStatus != MQTTSuccess )
@@ -804,8 +2559,8 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
                 /* The client identifier is used to uniquely identify this MQTT client to
                  * the MQTT broker. In a production device the identifier can be something
                  * unique, such as a device serial number. */
-                connectInfo.pClientIdentifier = CLIENT_IDENTIFIER;
-                connectInfo.clientIdentifierLength = CLIENT_IDENTIFIER_LENGTH;
+                connectInfo.pClientIdentifier = pClient->config.pClientIdentifier;
+                connectInfo.clientIdentifierLength = pClient->config.clientIdentifierLength;
 
                 /* The maximum time interval in seconds which is allowed to elapse
                  * between two Control Packets.
@@ -825,16 +2580,19 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
                 mqttStatus = MQTT_Connect( pMqttContext,
                                            &connectInfo,
                                            NULL,
-                                           CONNACK_RECV_TIMEOUT_MS,
+                                           ( getAckTimeoutMs( pClient ) > CONNACK_RECV_TIMEOUT_MS ) ?
+                                           getAckTimeoutMs( pClient ) : CONNACK_RECV_TIMEOUT_MS,
                                            &sessionPresent );
 
                 if( mqttStatus != MQTTSuccess )
                 {
                     returnStatus = EXIT_FAILURE;
+                    pClient->backoffBeforeConnect = true;
                     LogError( ( "Connection with MQTT broker failed with status %u.", mqttStatus ) );
                 }
                 else
                 {
+                    ReconnectBackoff_Reset( &pClient->reconnectBackoff );
                     LogInfo( ( "MQTT connection successfully established with broker." ) );
                 }
             }
@@ -844,7 +2602,7 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
                 /* Keep a flag for indicating if MQTT session is established. This
                  * flag will mark that an MQTT DISCONNECT has to be sent at the end
                  * of the demo even if there are intermediate failures. */
-                mqttSessionEstablished = true;
+                pClient->sessionEstablished = true;
             }
 
             if( returnStatus == EXIT_SUCCESS )
@@ -858,7 +2616,7 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
                                "Resending unacked publishes." ) );
 
                     /* Handle all the resend of publish messages. */
-                    returnStatus = handlePublishResend( &mqttContext );
+                    returnStatus = handlePublishResend( pClient );
                 }
                 else
                 {
@@ -867,7 +2625,7 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
 
                     /* Clean up the outgoing publishes waiting for ack as this new
                      * connection doesn't re-establish an existing session. */
-                    cleanupOutgoingPublishes();
+                    cleanupOutgoingPublishes( pClient );
                 }
             }
         }
@@ -878,42 +2636,116 @@ int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback )
 
 /*-----------------------------------------------------------*/
 
-static void cleanupESPSecureMgrCerts( NetworkContext_t * pNetworkContext )
+static int prepareNetworkContext( MqttClient_t * pClient )
+{
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
+
+    pNetworkContext->pcHostname = pClient->config.pHostName;
+    pNetworkContext->xPort = pClient->config.port;
+    pNetworkContext->pxTls = NULL;
+    pNetworkContext->xTlsContextSemaphore = xSemaphoreCreateMutexStatic( &pClient->tlsContextSemaphoreBuffer );
+    pNetworkContext->disableSni = 0;
+
+    return loadCredentials( pClient );
+}
+
+/*-----------------------------------------------------------*/
+
+static int loadCredentials( MqttClient_t * pClient )
 {
+    ClientCredentials_t * pCredentials = &pClient->credentials;
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
+
+    if( !pCredentials->loaded )
+    {
+        ( void ) CredentialCache_GetDer( root_cert_auth_start,
+                                         root_cert_auth_end - root_cert_auth_start,
+                                         &pCredentials->pRootCa,
+                                         &pCredentials->rootCaSize );
+
 #ifdef CONFIG_EXAMPLE_USE_SECURE_ELEMENT
-    /* Nothing to be freed */
+        /* The key stays in the secure element. */
 #elif defined(CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR)
-    esp_secure_cert_free_device_cert(&pNetworkContext->pcClientCert);
+        /* The device cert and the key are read in one call. */
+        if (esp_secure_cert_get_bundle(&pCredentials->secureCertBundle) != ESP_OK) {
+            LogError( ( "Failed to obtain the credentials from the esp_secure_cert partition") );
+            return EXIT_FAILURE;
+        }
+        pCredentials->pClientCert = pCredentials->secureCertBundle.device_cert;
+        pCredentials->clientCertSize = pCredentials->secureCertBundle.device_cert_len;
 #ifdef CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
-    esp_secure_cert_free_ds_ctx(pNetworkContext->ds_data);
+        pCredentials->pDsData = pCredentials->secureCertBundle.ds_ctx;
 #else /* !CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
-    esp_secure_cert_free_priv_key(&pNetworkContext->pcClientKey);
+        pCredentials->pClientKey = pCredentials->secureCertBundle.priv_key;
+        pCredentials->clientKeySize = pCredentials->secureCertBundle.priv_key_len;
 #endif /* CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL */
 
 #else /* !CONFIG_EXAMPLE_USE_SECURE_ELEMENT && !CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR  */
+    #ifndef CLIENT_USERNAME
+        ( void ) CredentialCache_GetDer( client_cert_start,
+                                         client_cert_end - client_cert_start,
+                                         &pCredentials->pClientCert,
+                                         &pCredentials->clientCertSize );
+        ( void ) CredentialCache_GetDer( client_key_start,
+                                         client_key_end - client_key_start,
+                                         &pCredentials->pClientKey,
+                                         &pCredentials->clientKeySize );
+    #endif
+#endif
+        pCredentials->loaded = true;
+    }
+
+    pNetworkContext->pcServerRootCA = pCredentials->pRootCa;
+    pNetworkContext->pcServerRootCASize = pCredentials->rootCaSize;
+    pNetworkContext->pcClientCert = pCredentials->pClientCert;
+    pNetworkContext->pcClientCertSize = pCredentials->clientCertSize;
+    pNetworkContext->pcClientKey = pCredentials->pClientKey;
+    pNetworkContext->pcClientKeySize = pCredentials->clientKeySize;
+    pNetworkContext->ds_data = pCredentials->pDsData;
+
+    #ifdef CONFIG_EXAMPLE_USE_SECURE_ELEMENT
+        pNetworkContext->use_secure_element = true;
+    #endif
+
+    return EXIT_SUCCESS;
+}
+
+/*-----------------------------------------------------------*/
+
+static void cleanupESPSecureMgrCerts( MqttClient_t * pClient )
+{
+    ClientCredentials_t * pCredentials = &pClient->credentials;
+
+#ifdef CONFIG_EXAMPLE_USE_SECURE_ELEMENT
     /* Nothing to be freed */
+#elif defined(CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR)
+    esp_secure_cert_free_bundle(&pCredentials->secureCertBundle);
+
+#else /* !CONFIG_EXAMPLE_USE_SECURE_ELEMENT && !CONFIG_EXAMPLE_USE_ESP_SECURE_CERT_MGR  */
+    /* Nothing to be freed; the DER copies in the credential cache are
+     * shared by all clients. */
 #endif
-    return;
+    ( void ) memset( pCredentials, 0x00, sizeof( ClientCredentials_t ) );
 }
 
 /*-----------------------------------------------------------*/
 
-int32_t DisconnectMqttSession( void )
+int32_t DisconnectMqttSession( MqttClient_t * pClient )
 {
     MQTTStatus_t mqttStatus = MQTTSuccess;
     int returnStatus = EXIT_SUCCESS;
-    MQTTContext_t * pMqttContext = &mqttContext;
-    NetworkContext_t * pNetworkContext = &networkContext;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
 
     assert( pMqttContext != NULL );
     assert( pNetworkContext != NULL );
 
-    if( mqttSessionEstablished == true )
+    if( pClient->sessionEstablished == true )
     {
         /* Send DISCONNECT. */
         mqttStatus = MQTT_Disconnect( pMqttContext );
 
-        if( mqttStatus != MQTTSuccess )
+        if( ( mqttStatus != MQTTSuccess ) || ( FlushPendingWrites( pClient ) != EXIT_SUCCESS ) )
         {
             LogError( ( "Sending MQTT DISCONNECT failed with status=%u.",
                         mqttStatus ) );
@@ -921,21 +2753,35 @@ int32_t DisconnectMqttSession( void )
         }
     }
 
-    /* End TLS session, then close TCP connection. */
-    cleanupESPSecureMgrCerts( &networkContext );
+    /* End TLS session, then close TCP connection. The credentials are kept
+     * for the next session. */
     ( void ) xTlsDisconnect( pNetworkContext );
+    freeNetworkBuffer( pClient );
+    pClient->sessionEstablished = false;
 
     return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
 
-int32_t SubscribeToTopic( const char * pTopicFilter,
+int32_t SubscribeToTopic( MqttClient_t * pClient,
+                          const char * pTopicFilter,
                           uint16_t topicFilterLength )
+{
+    /* Shadow topics are subscribed with QoS1 so that no response is lost. */
+    return SubscribeToTopicWithQoS( pClient, pTopicFilter, topicFilterLength, MQTTQoS1 );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t SubscribeToTopicWithQoS( MqttClient_t * pClient,
+                                 const char * pTopicFilter,
+                                 uint16_t topicFilterLength,
+                                 MQTTQoS_t qos )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus;
-    MQTTContext_t * pMqttContext = &mqttContext;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
     MQTTSubscribeInfo_t pSubscriptionList[ 1 ];
 
     assert( pMqttContext != NULL );
@@ -945,19 +2791,19 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
     /* Start with everything at 0. */
     ( void ) memset( ( void * ) pSubscriptionList, 0x00, sizeof( pSubscriptionList ) );
 
-    /* This example subscribes to only one topic and uses QOS1. */
-    pSubscriptionList[ 0 ].qos = MQTTQoS1;
+    /* This example subscribes to only one topic per request. */
+    pSubscriptionList[ 0 ].qos = qos;
     pSubscriptionList[ 0 ].pTopicFilter = pTopicFilter;
     pSubscriptionList[ 0 ].topicFilterLength = topicFilterLength;
 
     /* Generate packet identifier for the SUBSCRIBE packet. */
-    globalSubscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
+    pClient->subscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
 
     /* Send SUBSCRIBE packet. */
     mqttStatus = MQTT_Subscribe( pMqttContext,
                                  pSubscriptionList,
                                  sizeof( pSubscriptionList ) / sizeof( MQTTSubscribeInfo_t ),
-                                 globalSubscribePacketIdentifier );
+                                 pClient->subscribePacketIdentifier );
 
     if( mqttStatus != MQTTSuccess )
     {
@@ -967,9 +2813,10 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
     }
     else
     {
-        LogInfo( ( "SUBSCRIBE topic %.*s to broker.",
+        LogInfo( ( "SUBSCRIBE topic %.*s to broker with QoS%u.",
                    topicFilterLength,
-                   pTopicFilter ) );
+                   pTopicFilter,
+                   ( unsigned int ) qos ) );
 
         /* Process incoming packet from the broker. Acknowledgment for subscription
          * ( SUBACK ) will be received here. However after sending the subscribe, the
@@ -978,9 +2825,9 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
          * of receiving publish message before subscribe ack is zero; but application
          * must be ready to receive any packet. This demo uses MQTT_ProcessLoop to
          * receive packet from network. */
-        returnStatus = waitForPacketAck( pMqttContext,
-                                         globalSubscribePacketIdentifier,
-                                         MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        returnStatus = waitForPacketAck( pClient,
+                                         pClient->subscribePacketIdentifier,
+                                         getAckTimeoutMs( pClient ) );
     }
 
     return returnStatus;
@@ -988,12 +2835,13 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
-int32_t UnsubscribeFromTopic( const char * pTopicFilter,
+int32_t UnsubscribeFromTopic( MqttClient_t * pClient,
+                              const char * pTopicFilter,
                               uint16_t topicFilterLength )
 {
     int returnStatus = EXIT_SUCCESS;
     MQTTStatus_t mqttStatus;
-    MQTTContext_t * pMqttContext = &mqttContext;
+    MQTTContext_t * pMqttContext = &pClient->mqttContext;
     MQTTSubscribeInfo_t pSubscriptionList[ 1 ];
 
     assert( pMqttContext != NULL );
@@ -1009,13 +2857,13 @@ int32_t UnsubscribeFromTopic( const char * pTopicFilter,
     pSubscriptionList[ 0 ].topicFilterLength = topicFilterLength;
 
     /* Generate packet identifier for the UNSUBSCRIBE packet. */
-    globalUnsubscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
+    pClient->unsubscribePacketIdentifier = MQTT_GetPacketId( pMqttContext );
 
     /* Send UNSUBSCRIBE packet. */
     mqttStatus = MQTT_Unsubscribe( pMqttContext,
                                    pSubscriptionList,
                                    sizeof( pSubscriptionList ) / sizeof( MQTTSubscribeInfo_t ),
-                                   globalUnsubscribePacketIdentifier );
+                                   pClient->unsubscribePacketIdentifier );
 
     if( mqttStatus != MQTTSuccess )
     {
@@ -1036,9 +2884,9 @@ int32_t UnsubscribeFromTopic( const char * pTopicFilter,
          * of receiving publish message before subscribe ack is zero; but application
          * must be ready to receive any packet. This demo uses MQTT_ProcessLoop to
          * receive packet from network. */
-        returnStatus = waitForPacketAck( pMqttContext,
-                                         globalUnsubscribePacketIdentifier,
-                                         MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        returnStatus = waitForPacketAck( pClient,
+                                         pClient->unsubscribePacketIdentifier,
+                                         getAckTimeoutMs( pClient ) );
     }
 
     return returnStatus;
@@ -1046,78 +2894,329 @@ int32_t UnsubscribeFromTopic( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
-int32_t PublishToTopic( const char * pTopicFilter,
+int32_t PublishToTopic( MqttClient_t * pClient,
+                        const char * pTopicFilter,
                         int32_t topicFilterLength,
                         const char * pPayload,
                         size_t payloadLength )
+{
+    /* Shadow documents are published with QoS1 so that they are resent
+     * if the connection drops before the PUBACK is received. */
+    return PublishToTopicWithQoS( pClient,
+                                  pTopicFilter,
+                                  topicFilterLength,
+                                  pPayload,
+                                  payloadLength,
+                                  MQTTQoS1 );
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t PublishToTopicWithQoS( MqttClient_t * pClient,
+                               const char * pTopicFilter,
+                               int32_t topicFilterLength,
+                               const char * pPayload,
+                               size_t payloadLength,
+                               MQTTQoS_t qos )
 {
     int returnStatus = EXIT_SUCCESS;
-    MQTTStatus_t mqttStatus = MQTTSuccess;
-    uint8_t publishIndex = MAX_OUTGOING_PUBLISHES;
-    MQTTContext_t * pMqttContext = &mqttContext;
 
-    assert( pMqttContext != NULL );
     assert( pTopicFilter != NULL );
     assert( topicFilterLength > 0 );
 
-    /* Get the next free index for the outgoing publish. All QoS1 outgoing
-     * publishes are stored until a PUBACK is received. These messages are
-     * stored for supporting a resend if a network connection is broken before
-     * receiving a PUBACK. */
-    returnStatus = getNextFreeIndexForOutgoingPublishes( &publishIndex );
+    switch( qos )
+    {
+        case MQTTQoS0:
+            returnStatus = publishQoS0( pClient, pTopicFilter,
+                                        topicFilterLength,
+                                        pPayload,
+                                        payloadLength );
+            break;
 
-    if( returnStatus == EXIT_FAILURE )
+        case MQTTQoS1:
+            returnStatus = publishQoS1( pClient, pTopicFilter,
+                                        topicFilterLength,
+                                        pPayload,
+                                        payloadLength,
+                                        MQTT_PROCESS_LOOP_TIMEOUT_MS );
+            break;
+
+        /* The helpers do not track PUBREC/PUBREL/PUBCOMP, so QoS2 is not
+         * offered. */
+        default:
+            LogError( ( "Unsupported QoS%u for PUBLISH to topic %.*s.",
+                        ( unsigned int ) qos,
+                        ( int ) topicFilterLength,
+                        pTopicFilter ) );
+            returnStatus = EXIT_FAILURE;
+            break;
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ProcessIncomingPackets( MqttClient_t * pClient,
+                                uint32_t timeoutMs )
+{
+    int returnStatus = EXIT_SUCCESS;
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+
+    mqttStatus = processLoopWithTimeout( &pClient->mqttContext, timeoutMs );
+
+    if( ( mqttStatus != MQTTSuccess ) && ( mqttStatus != MQTTNeedMoreBytes ) )
     {
-        LogError( ( "Unable to find a free spot for outgoing PUBLISH message." ) );
+        LogError( ( "MQTT_ProcessLoop returned with status = %s.",
+                    MQTT_Status_strerror( mqttStatus ) ) );
+        returnStatus = EXIT_FAILURE;
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t EnqueuePublish( MqttClient_t * pClient,
+                        OutboundPriority_t priority,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength,
+                        MQTTQoS_t qos )
+{
+    int returnStatus = EXIT_SUCCESS;
+    OutboundLane_t * pLane = NULL;
+    OutboundPublish_t * pEntry = NULL;
+
+    assert( priority < OutboundPriorityMax );
+    assert( pTopicFilter != NULL );
+    assert( topicFilterLength > 0 );
+
+    if( qos > MQTTQoS1 )
+    {
+        LogError( ( "Unsupported QoS%u for queued PUBLISH to topic %.*s.",
+                    ( unsigned int ) qos,
+                    ( int ) topicFilterLength,
+                    pTopicFilter ) );
+        returnStatus = EXIT_FAILURE;
     }
     else
     {
-        LogInfo( ( "Published payload: %s", pPayload ) );
-        /* This example publishes to only one topic and uses QOS1. */
-        outgoingPublishPackets[ publishIndex ].pubInfo.qos = MQTTQoS1;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pTopicName = pTopicFilter;
-        outgoingPublishPackets[ publishIndex ].pubInfo.topicNameLength = topicFilterLength;
-        outgoingPublishPackets[ publishIndex ].pubInfo.pPayload = pPayload;
-        outgoingPublishPackets[ publishIndex ].pubInfo.payloadLength = payloadLength;
+        pLane = &pClient->outboundLanes[ priority ];
 
-        /* Get a new packet id. */
-        outgoingPublishPackets[ publishIndex ].packetId = MQTT_GetPacketId( pMqttContext );
-
-        /* Send PUBLISH packet. */
-        mqttStatus = MQTT_Publish( pMqttContext,
-                                   &outgoingPublishPackets[ publishIndex ].pubInfo,
-                                   outgoingPublishPackets[ publishIndex ].packetId );
+        portENTER_CRITICAL( &pClient->outboundLanesLock );
 
-        if( mqttStatus != MQTTSuccess )
+        if( pLane->count >= OUTBOUND_LANE_LENGTH )
         {
-            LogError( ( "Failed to send PUBLISH packet to broker with error = %u.",
-                        mqttStatus ) );
-            cleanupOutgoingPublishAt( publishIndex );
             returnStatus = EXIT_FAILURE;
         }
         else
         {
-            LogInfo( ( "PUBLISH sent for topic %.*s to broker with packet ID %u.",
-                       (int) topicFilterLength,
-                       pTopicFilter,
-                       outgoingPublishPackets[ publishIndex ].packetId ) );
+            pEntry = &pLane->entries[ ( pLane->head + pLane->count ) % OUTBOUND_LANE_LENGTH ];
+            pEntry->pTopicName = pTopicFilter;
+            pEntry->topicNameLength = ( uint16_t ) topicFilterLength;
+            pEntry->pPayload = pPayload;
+            pEntry->payloadLength = payloadLength;
+            pEntry->qos = qos;
+            pLane->count++;
+        }
 
-            /* Calling MQTT_ProcessLoop to process incoming publish echo, since
-             * application subscribed to the same topic the broker will send
-             * publish message back to the application. This function also
-             * sends ping request to broker if MQTT_KEEP_ALIVE_INTERVAL_SECONDS
-             * has expired since the last MQTT packet sent and receive
-             * ping responses. */
-            mqttStatus = processLoopWithTimeout( &mqttContext, MQTT_PROCESS_LOOP_TIMEOUT_MS );
+        portEXIT_CRITICAL( &pClient->outboundLanesLock );
 
-            if( ( mqttStatus != MQTTSuccess ) && ( mqttStatus != MQTTNeedMoreBytes ) )
+        if( returnStatus == EXIT_FAILURE )
+        {
+            LogWarn( ( "Outbound lane %u is full, dropping PUBLISH to topic %.*s.",
+                       ( unsigned int ) priority,
+                       ( int ) topicFilterLength,
+                       pTopicFilter ) );
+        }
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t ServiceOutboundQueue( MqttClient_t * pClient,
+                              uint32_t maxPackets )
+{
+    int returnStatus = EXIT_SUCCESS;
+    OutboundPublish_t publish;
+    uint32_t packetsSent = 0U;
+
+    /* The highest priority lane is looked up again before every packet, so
+     * a control message queued while a telemetry backlog is being drained
+     * (for example from the event callback during the process loop) is sent
+     * next. */
+    while( ( ( maxPackets == 0U ) || ( packetsSent < maxPackets ) ) &&
+           ( returnStatus == EXIT_SUCCESS ) &&
+           ( dequeueOutboundPublish( pClient, &publish ) == true ) )
+    {
+        if( publish.qos == MQTTQoS0 )
+        {
+            returnStatus = publishQoS0( pClient, publish.pTopicName,
+                                        publish.topicNameLength,
+                                        publish.pPayload,
+                                        publish.payloadLength );
+
+            /* Give incoming packets a chance between packets, as the QoS1
+             * path does. */
+            if( returnStatus == EXIT_SUCCESS )
             {
-                LogWarn( ( "MQTT_ProcessLoop returned with status = %u.",
-                           mqttStatus ) );
+                ( void ) processLoopWithTimeout( &pClient->mqttContext, OUTBOUND_PROCESS_LOOP_TIMEOUT_MS );
             }
         }
+        else
+        {
+            returnStatus = publishQoS1( pClient, publish.pTopicName,
+                                        publish.topicNameLength,
+                                        publish.pPayload,
+                                        publish.payloadLength,
+                                        OUTBOUND_PROCESS_LOOP_TIMEOUT_MS );
+        }
+
+        packetsSent++;
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t FlushPendingWrites( MqttClient_t * pClient )
+{
+    int returnStatus = EXIT_SUCCESS;
+
+    assert( pClient != NULL );
+
+    #ifdef CONFIG_EXAMPLE_TLS_WRITE_COALESCING
+        if( TlsWriteCoalescer_Flush( &pClient->writeCoalescer ) != TlsWriteCoalescerSuccess )
+        {
+            LogError( ( "Failed to send the coalesced writes to the broker." ) );
+            returnStatus = EXIT_FAILURE;
+        }
+    #else
+        ( void ) pClient;
+    #endif
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void SetStreamingPublishHandler( MqttClient_t * pClient,
+                                 StreamingPublishCallback_t streamingCallback )
+{
+    pClient->streamingPublishCallback = streamingCallback;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t RunTlsHandshakeBenchmark( MqttClient_t * pClient,
+                                  uint32_t handshakeCount )
+{
+    int returnStatus = EXIT_SUCCESS;
+    NetworkContext_t * pNetworkContext = &pClient->networkContext;
+    uint32_t handshake = 0U;
+    uint32_t startTimeMs = 0U;
+    uint32_t elapsedMs = 0U;
+    uint32_t totalMs = 0U;
+    uint32_t minMs = UINT32_MAX;
+    uint32_t maxMs = 0U;
+    uint32_t completed = 0U;
+    size_t freeBefore = 0U;
+    size_t minimumFreeBefore = 0U;
+    size_t minimumFree = 0U;
+    size_t peakUse = 0U;
+    bool peakMeasured = false;
+
+    assert( pClient != NULL );
+    assert( !pClient->sessionEstablished );
+
+    ( void ) memset( pNetworkContext, 0x00, sizeof( NetworkContext_t ) );
+
+    if( prepareNetworkContext( pClient ) != EXIT_SUCCESS )
+    {
+        return EXIT_FAILURE;
+    }
+
+    #ifdef CONFIG_EXAMPLE_RACE_BROKER_PORTS
+        setBrokerPort( pNetworkContext, chooseBrokerPort( pClient ) );
+    #else
+        setBrokerPort( pNetworkContext, pClient->config.port );
+    #endif
+
+    for( handshake = 0U; handshake < handshakeCount; handshake++ )
+    {
+        freeBefore = heap_caps_get_free_size( MALLOC_CAP_8BIT );
+        minimumFreeBefore = heap_caps_get_minimum_free_size( MALLOC_CAP_8BIT );
+        startTimeMs = Clock_GetTimeMs();
+
+        if( xTlsConnect( pNetworkContext ) != TLS_TRANSPORT_SUCCESS )
+        {
+            LogError( ( "Benchmark handshake %u failed.", ( unsigned int ) ( handshake + 1U ) ) );
+            returnStatus = EXIT_FAILURE;
+            continue;
+        }
+
+        elapsedMs = Clock_GetTimeMs() - startTimeMs;
+
+        /* ESP-IDF keeps only the lifetime low-water mark of the heap. Only
+         * when it dropped during this handshake was the new mark reached by
+         * the handshake, otherwise its peak cannot be told. */
+        minimumFree = heap_caps_get_minimum_free_size( MALLOC_CAP_8BIT );
+
+        if( ( minimumFree < minimumFreeBefore ) && ( freeBefore > minimumFree ) )
+        {
+            peakUse = ( ( freeBefore - minimumFree ) > peakUse ) ? ( freeBefore - minimumFree ) : peakUse;
+            peakMeasured = true;
+        }
+
+        ( void ) xTlsDisconnect( pNetworkContext );
+
+        totalMs += elapsedMs;
+        minMs = ( elapsedMs < minMs ) ? elapsedMs : minMs;
+        maxMs = ( elapsedMs > maxMs ) ? elapsedMs : maxMs;
+        completed++;
+    }
+
+    if( completed > 0U )
+    {
+        LogInfo( ( "TLS handshake benchmark, %s profile, port %u: %u of %u handshakes, "
+                   "%u/%u/%u ms min/avg/max.",
+                   TLS_PROFILE_NAME,
+                   ( unsigned int ) pNetworkContext->xPort,
+                   ( unsigned int ) completed,
+                   ( unsigned int ) handshakeCount,
+                   ( unsigned int ) minMs,
+                   ( unsigned int ) ( totalMs / completed ),
+                   ( unsigned int ) maxMs ) );
+
+        if( peakMeasured )
+        {
+            LogInfo( ( "TLS handshake benchmark: peak heap use %u bytes.",
+                       ( unsigned int ) peakUse ) );
+        }
+        else
+        {
+            LogInfo( ( "TLS handshake benchmark: peak heap use not measurable, "
+                       "the heap low-water mark was set before the benchmark." ) );
+        }
     }
 
     return returnStatus;
 }
+
+/*-----------------------------------------------------------*/
+
+void SetReconnectDelayHint( MqttClient_t * pClient,
+                            uint32_t delayMs )
+{
+    assert( pClient != NULL );
+
+    ReconnectBackoff_SetServerHint( &pClient->reconnectBackoff, delayMs );
+    pClient->backoffBeforeConnect = true;
+}
+
 /*-----------------------------------------------------------*/
@@ -29,37 +29,119 @@
 /* MQTT API header. */
 #include "core_mqtt.h"
 
+/**
+ * @brief An MQTT client: one connection with its own network buffer, QoS
+ * state and outbound queue. Clients are taken from a fixed pool of
+ * CONFIG_EXAMPLE_MQTT_CLIENT_POOL_SIZE entries by #CreateMqttClient.
+ */
+typedef struct MqttClient MqttClient_t;
+
+/**
+ * @brief Settings of a client.
+ *
+ * The strings are not copied: they must stay valid until the client is
+ * released.
+ */
+typedef struct MqttClientConfig
+{
+    const char * pHostName;          /**< @brief Broker endpoint. */
+    uint16_t port;                   /**< @brief Broker port; 443 enables ALPN. */
+    const char * pClientIdentifier;  /**< @brief MQTT client identifier. */
+    uint16_t clientIdentifierLength; /**< @brief Length of #pClientIdentifier. */
+} MqttClientConfig_t;
+
+/**
+ * @brief Priorities of the outbound publish lanes, highest first.
+ */
+typedef enum OutboundPriority
+{
+    OutboundPriorityControl = 0, /**< Acknowledgements and other urgent control messages. */
+    OutboundPriorityShadow,      /**< Shadow state updates. */
+    OutboundPriorityTelemetry,   /**< Periodic telemetry. */
+    OutboundPriorityBulk,        /**< Bulk uploads that may wait. */
+    OutboundPriorityMax          /**< Number of priorities. */
+} OutboundPriority_t;
+
+/**
+ * @brief Handler for the payload of an incoming publish that does not fit
+ * the network buffer.
+ *
+ * The payload is passed in consecutive chunks; the first chunk has
+ * @p payloadOffset 0 and the last one ends at @p payloadLength. It is called
+ * from within the MQTT process loop, so it must not call back into the MQTT
+ * library.
+ *
+ * @param[in] pClient The client the publish was received on.
+ * @param[in] pTopicName Topic name of the publish.
+ * @param[in] topicNameLength Length of @p pTopicName.
+ * @param[in] pPayloadChunk The chunk.
+ * @param[in] chunkLength Length of @p pPayloadChunk.
+ * @param[in] payloadOffset Offset of the chunk in the payload.
+ * @param[in] payloadLength Length of the whole payload.
+ */
+typedef void ( * StreamingPublishCallback_t )( MqttClient_t * pClient,
+                                               const char * pTopicName,
+                                               uint16_t topicNameLength,
+                                               const uint8_t * pPayloadChunk,
+                                               size_t chunkLength,
+                                               size_t payloadOffset,
+                                               size_t payloadLength );
+
+/**
+ * @brief Take a client from the pool.
+ *
+ * @param[in] pConfig Broker and client identifier, or NULL to use
+ * AWS_IOT_ENDPOINT, AWS_MQTT_PORT and CLIENT_IDENTIFIER from demo_config.h.
+ *
+ * @return The client; NULL if the pool is exhausted.
+ */
+MqttClient_t * CreateMqttClient( const MqttClientConfig_t * pConfig );
+
+/**
+ * @brief Return a client to the pool. Its session must be disconnected.
+ *
+ * @param[in] pClient The client.
+ */
+void ReleaseMqttClient( MqttClient_t * pClient );
+
 /**
  * @brief Establish a MQTT connection.
  *
+ * @param[in] pClient The client.
  * @param[in] appCallback The callback function used to receive incoming
  * publishes and incoming acks from MQTT library.
  *
  * @return EXIT_SUCCESS if an MQTT session is established;
  * EXIT_FAILURE otherwise.
  */
-int32_t EstablishMqttSession( MQTTEventCallback_t eventCallback );
+int32_t EstablishMqttSession( MqttClient_t * pClient,
+                              MQTTEventCallback_t eventCallback );
 
 /**
  * @brief Handle the incoming packet if it's not related to the device shadow.
  *
+ * @param[in] pMqttContext MQTT context passed to the event callback.
  * @param[in] pPacketInfo Packet Info pointer for the incoming packet.
  * @param[in] packetIdentifier Packet identifier of the incoming packet.
  */
-void HandleOtherIncomingPacket( MQTTPacketInfo_t * pPacketInfo,
+void HandleOtherIncomingPacket( MQTTContext_t * pMqttContext,
+                                MQTTPacketInfo_t * pPacketInfo,
                                 uint16_t packetIdentifier );
 
 /**
  * @brief Close the MQTT connection.
  *
+ * @param[in] pClient The client.
+ *
  * @return EXIT_SUCCESS if DISCONNECT was successfully sent;
  * EXIT_FAILURE otherwise.
  */
-int32_t DisconnectMqttSession( void );
+int32_t DisconnectMqttSession( MqttClient_t * pClient );
 
 /**
  * @brief Subscribe to a MQTT topic filter.
  *
+ * @param[in] pClient The client.
  * @param[in] pTopicFilter Pointer to the shadow topic buffer.
  * @param[in] topicFilterLength Indicates the length of the shadow
  * topic buffer.
@@ -67,13 +149,33 @@ int32_t DisconnectMqttSession( void );
  * @return EXIT_SUCCESS if SUBSCRIBE was successfully sent;
  * EXIT_FAILURE otherwise.
  */
-int32_t SubscribeToTopic( const char * pTopicFilter,
+int32_t SubscribeToTopic( MqttClient_t * pClient,
+                          const char * pTopicFilter,
                           uint16_t topicFilterLength );
 
+/**
+ * @brief Subscribe to a MQTT topic filter with the given maximum QoS.
+ *
+ * @param[in] pClient The client.
+ * @param[in] pTopicFilter Pointer to the topic filter buffer.
+ * @param[in] topicFilterLength Indicates the length of the topic filter
+ * buffer.
+ * @param[in] qos Maximum QoS the broker may use for publishes delivered on
+ * this subscription.
+ *
+ * @return EXIT_SUCCESS if SUBSCRIBE was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t SubscribeToTopicWithQoS( MqttClient_t * pClient,
+                                 const char * pTopicFilter,
+                                 uint16_t topicFilterLength,
+                                 MQTTQoS_t qos );
+
 /**
  * @brief Sends an MQTT UNSUBSCRIBE to unsubscribe from the shadow
  * topic.
  *
+ * @param[in] pClient The client.
  * @param[in] pTopicFilter Pointer to the shadow topic buffer.
  * @param[in] topicFilterLength Indicates the length of the shadow
  * topic buffer.
@@ -81,12 +183,14 @@ int32_t SubscribeToTopic( const char * pTopicFilter,
  * @return EXIT_SUCCESS if UNSUBSCRIBE was successfully sent;
  * EXIT_FAILURE otherwise.
  */
-int32_t UnsubscribeFromTopic( const char * pTopicFilter,
+int32_t UnsubscribeFromTopic( MqttClient_t * pClient,
+                              const char * pTopicFilter,
                               uint16_t topicFilterLength );
 
 /**
- * @brief Publish a message to a MQTT topic.
+ * @brief Publish a message to a MQTT topic with QoS1.
  *
+ * @param[in] pClient The client.
  * @param[in] pTopicFilter Points to the topic.
  * @param[in] topicFilterLength The length of the topic.
  * @param[in] pPayload Points to the payload.
@@ -95,9 +199,156 @@ int32_t UnsubscribeFromTopic( const char * pTopicFilter,
  * @return EXIT_SUCCESS if PUBLISH was successfully sent;
  * EXIT_FAILURE otherwise.
  */
-int32_t PublishToTopic( const char * pTopicFilter,
+int32_t PublishToTopic( MqttClient_t * pClient,
+                        const char * pTopicFilter,
                         int32_t topicFilterLength,
                         const char * pPayload,
                         size_t payloadLength );
 
-#endif /* ifndef SHADOW_DEMO_HELPERS_H_ */
+/**
+ * @brief Publish a message to a MQTT topic with the given QoS.
+ *
+ * QoS1 publishes are stored until their PUBACK is received and are resent
+ * when a session is resumed. QoS0 publishes take a fast path that neither
+ * reserves an outgoing publish slot nor waits for incoming packets, which
+ * suits high-rate telemetry that may be dropped.
+ *
+ * @param[in] pClient The client.
+ * @param[in] pTopicFilter Points to the topic.
+ * @param[in] topicFilterLength The length of the topic.
+ * @param[in] pPayload Points to the payload.
+ * @param[in] payloadLength The length of the payload.
+ * @param[in] qos MQTTQoS0 or MQTTQoS1.
+ *
+ * @return EXIT_SUCCESS if PUBLISH was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t PublishToTopicWithQoS( MqttClient_t * pClient,
+                               const char * pTopicFilter,
+                               int32_t topicFilterLength,
+                               const char * pPayload,
+                               size_t payloadLength,
+                               MQTTQoS_t qos );
+
+/**
+ * @brief Process incoming packets and keep-alive for the given duration.
+ *
+ * Useful after a burst of QoS0 publishes, which do not run the process loop
+ * themselves.
+ *
+ * @param[in] pClient The client.
+ * @param[in] timeoutMs Duration to process incoming packets for.
+ *
+ * @return EXIT_SUCCESS if the process loop did not report an error;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t ProcessIncomingPackets( MqttClient_t * pClient,
+                                uint32_t timeoutMs );
+
+/**
+ * @brief Queue a publish in the outbound lane of the given priority.
+ *
+ * Queued publishes are sent by #ServiceOutboundQueue. The topic and payload
+ * are not copied: they must stay valid until the publish is sent and, for
+ * QoS1, until its PUBACK is received. May be called from any task and from
+ * the MQTT event callback.
+ *
+ * @param[in] pClient The client.
+ * @param[in] priority Lane to queue the publish in.
+ * @param[in] pTopicFilter Points to the topic.
+ * @param[in] topicFilterLength The length of the topic.
+ * @param[in] pPayload Points to the payload.
+ * @param[in] payloadLength The length of the payload.
+ * @param[in] qos MQTTQoS0 or MQTTQoS1.
+ *
+ * @return EXIT_SUCCESS if the publish was queued;
+ * EXIT_FAILURE if the lane is full or the QoS is not supported.
+ */
+int32_t EnqueuePublish( MqttClient_t * pClient,
+                        OutboundPriority_t priority,
+                        const char * pTopicFilter,
+                        int32_t topicFilterLength,
+                        const char * pPayload,
+                        size_t payloadLength,
+                        MQTTQoS_t qos );
+
+/**
+ * @brief Send queued publishes, highest priority first.
+ *
+ * The lanes are re-examined before every packet, so a higher priority
+ * publish queued while a lower priority backlog is being drained preempts
+ * that backlog at the next packet boundary.
+ *
+ * @param[in] pClient The client.
+ * @param[in] maxPackets Maximum number of packets to send, or 0 to send
+ * until the queue is empty or no in-flight slot is available.
+ *
+ * @return EXIT_SUCCESS if every attempted PUBLISH was sent;
+ * EXIT_FAILURE otherwise.
+ */
+int32_t ServiceOutboundQueue( MqttClient_t * pClient,
+                              uint32_t maxPackets );
+
+/**
+ * @brief Send the writes the client holds back to batch them into one TLS
+ * record.
+ *
+ * Held back writes are otherwise sent once the buffer is full, the
+ * coalescing window has passed, or the client is about to wait for the
+ * broker, so this is needed only before going quiet without calling
+ * #ProcessIncomingPackets, e.g. after a QoS0 publish. Does nothing unless
+ * EXAMPLE_TLS_WRITE_COALESCING is enabled.
+ *
+ * @param[in] pClient The client.
+ *
+ * @return EXIT_SUCCESS; EXIT_FAILURE if sending failed.
+ */
+int32_t FlushPendingWrites( MqttClient_t * pClient );
+
+/**
+ * @brief Set the handler for incoming publishes that do not fit the network
+ * buffer.
+ *
+ * Such publishes bypass the callback given to #EstablishMqttSession and are
+ * acknowledged once their whole payload was passed to @p streamingCallback.
+ * Without a handler they are dropped.
+ *
+ * @param[in] pClient The client.
+ * @param[in] streamingCallback The handler, or NULL.
+ */
+void SetStreamingPublishHandler( MqttClient_t * pClient,
+                                 StreamingPublishCallback_t streamingCallback );
+
+/**
+ * @brief Measure the TLS handshake with the broker of the client.
+ *
+ * Runs @p handshakeCount TLS handshakes, each followed by a disconnect, and
+ * logs their minimum, average and maximum duration and the peak heap use,
+ * along with the TLS profile selected in menuconfig. Build the firmware
+ * once per profile to compare them on a given board.
+ *
+ * Call while the client has no MQTT session.
+ *
+ * @param[in] pClient The client.
+ * @param[in] handshakeCount Number of handshakes.
+ *
+ * @return EXIT_SUCCESS if every handshake succeeded; EXIT_FAILURE otherwise.
+ */
+int32_t RunTlsHandshakeBenchmark( MqttClient_t * pClient,
+                                  uint32_t handshakeCount );
+
+/**
+ * @brief Make the next connection of the client wait at least @p delayMs,
+ * e.g. because the broker or a fleet-wide message asked devices to stay
+ * away for a while.
+ *
+ * The delay is stretched by a random amount of up to half of it, so that
+ * devices given the same hint do not come back together.
+ *
+ * @param[in] pClient The client.
+ * @param[in] delayMs The hinted delay.
+ */
+void SetReconnectDelayHint( MqttClient_t * pClient,
+                            uint32_t delayMs );
+
+#endif /* ifndef MQTT_DEMO_HELPERS_H_ */
@@ -31,10 +31,16 @@
  * therefore the code for MQTT connections are placed in another file (shadow_demo_helpers.c)
  * to make it easy to read the code using Device Shadow library.
  *
+ * The names of the things are given at run time (#SHADOW_THING_NAMES), so one
+ * MQTT connection can sync the shadows of many things, e.g. sensors behind a
+ * gateway. Each thing has its own state and its topics are assembled once
+ * into a shared table (shadow_thing_table.c).
+ *
  * This example assumes there is a powerOn state in the device shadow. It does the
  * following operations:
  * 1. Establish a MQTT connection by using the helper functions in shadow_demo_helpers.c.
- * 2. Assemble strings for the MQTT topics of device shadow, by using macros defined by the Device Shadow library.
+ * 2. Assemble strings for the MQTT topics of device shadow of every thing, by using
+ * #Shadow_AssembleTopicString of the Device Shadow library.
  * 3. Subscribe to those MQTT topics by using helper functions in shadow_demo_helpers.c.
  * 4. Publish a desired state of powerOn by using helper functions in shadow_demo_helpers.c.  That will cause
  * a delta message to be sent to device.
@@ -43,7 +49,8 @@
  * device shadow delta message, set a flag for the main function to know, then the main function will publish
  * a second message to update the reported state of powerOn.
  * 6. Handle incoming message again in eventCallback. If the message is from update/accepted, verify that it
- * has the same clientToken as previously published in the update message. That will mark the end of the demo.
+ * has the same clientToken as previously published in the update message. Steps 3 to 6
+ * are repeated for every thing. That will mark the end of the demo.
  */
 
 /* Standard includes. */
@@ -67,6 +74,12 @@
 /* JSON API header. */
 #include "core_json.h"
 
+/* Incremental JSON tokenizer for streamed payloads. */
+#include "shadow_json_stream.h"
+
+/* Table of the things served over the MQTT connection. */
+#include "shadow_thing_table.h"
+
 /* Clock for timer. */
 #include "clock.h"
 
@@ -176,48 +189,97 @@
  */
 #define SHADOW_DELETE_REJECTED_ERROR_CODE_KEY_LENGTH    ( ( uint16_t ) ( sizeof( SHADOW_DELETE_REJECTED_ERROR_CODE_KEY ) - 1 ) )
 
+/**
+ * @brief Longest number accepted from a streamed shadow document.
+ */
+#define STREAMED_NUMBER_MAX_LENGTH                      ( 10U )
+
 /*-----------------------------------------------------------*/
 
 /**
- * @brief The simulated device current power on state.
+ * @brief State of the simulated device behind one thing.
  */
-static uint32_t currentPowerOnState = 0;
+typedef struct ShadowThingState
+{
+    /**
+     * @brief The simulated device current power on state.
+     */
+    uint32_t currentPowerOnState;
+
+    /**
+     * @brief The latest shadow version received on /update/delta.
+     */
+    uint32_t currentVersion;
+
+    /**
+     * @brief When we send an update to the device shadow, and if we care about
+     * the response from cloud (accepted/rejected), remember the clientToken and
+     * use it to match with the response.
+     */
+    uint32_t clientToken;
+
+    /**
+     * @brief The flag to indicate the device current power on state changed.
+     */
+    bool stateChanged;
+
+    /**
+     * @brief Status of the response of Shadow delete operation from AWS IoT
+     * message broker.
+     */
+    bool deleteResponseReceived;
+
+    /**
+     * @brief Status of the Shadow delete operation.
+     *
+     * The Shadow delete status will be updated by the incoming publishes on the
+     * MQTT topics for delete acknowledgement from AWS IoT message broker
+     * (accepted/rejected). Shadow document is considered to be deleted if an
+     * incoming publish is received on `/delete/accepted` topic or an incoming
+     * publish is received on `/delete/rejected` topic with error code 404. Code 404
+     * indicates that the Shadow document does not exist for the Thing yet.
+     */
+    bool shadowDeleted;
+} ShadowThingState_t;
 
 /**
- * @brief The flag to indicate the device current power on state changed.
+ * @brief Values collected from an /update/delta document that is received
+ * in chunks.
  */
-static bool stateChanged = false;
+typedef struct StreamedDelta
+{
+    uint32_t version;
+    uint32_t powerOnState;
+    bool versionFound;
+    bool powerOnFound;
+} StreamedDelta_t;
+
+/*-----------------------------------------------------------*/
 
 /**
- * @brief When we send an update to the device shadow, and if we care about
- * the response from cloud (accepted/rejected), remember the clientToken and
- * use it to match with the response.
+ * @brief Things served over the MQTT connection and their topics.
  */
-static uint32_t clientToken = 0U;
+static ShadowThingTable_t thingTable;
 
 /**
- * @brief Indicator that an error occurred during the MQTT event callback. If an
- * error occurred during the MQTT event callback, then the demo has failed.
+ * @brief State of every thing in #thingTable, at the same index.
  */
-static bool eventCallbackError = false;
+static ShadowThingState_t thingStates[ SHADOW_THING_TABLE_MAX_THINGS ];
 
 /**
- * @brief Status of the response of Shadow delete operation from AWS IoT
- * message broker.
+ * @brief Tokenizer for the streamed publish being received, the delta
+ * values found in it so far, and the thing it is for.
  */
-static bool deleteResponseReceived = false;
+static JsonStreamParser_t streamedDocumentParser;
+static StreamedDelta_t streamedDelta;
+static ShadowMessageType_t streamedMessageType = ShadowMessageTypeMaxNum;
+static ShadowThingState_t * pStreamedThingState = NULL;
 
 /**
- * @brief Status of the Shadow delete operation.
- *
- * The Shadow delete status will be updated by the incoming publishes on the
- * MQTT topics for delete acknowledgement from AWS IoT message broker
- * (accepted/rejected). Shadow document is considered to be deleted if an
- * incoming publish is received on `/delete/accepted` topic or an incoming
- * publish is received on `/delete/rejected` topic with error code 404. Code 404
- * indicates that the Shadow document does not exist for the Thing yet.
+ * @brief Indicator that an error occurred during the MQTT event callback. If an
+ * error occurred during the MQTT event callback, then the demo has failed.
  */
-static bool shadowDeleted = false;
+static bool eventCallbackError = false;
 
 /*-----------------------------------------------------------*/
 
@@ -241,10 +303,12 @@ static void eventCallback( MQTTContext_t * pMqttContext,
  * This handler examines the version number and the powerOn state. If powerOn
  * state has changed, it sets a flag for the main function to take further actions.
  *
+ * @param[in] pThingState State of the thing the publish is for.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo );
+static void updateDeltaHandler( ShadowThingState_t * pThingState,
+                                MQTTPublishInfo_t * pPublishInfo );
 
 /**
  * @brief Process payload from /update/accepted topic.
@@ -252,10 +316,12 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo );
  * This handler examines the accepted message that carries the same clientToken
  * as sent before.
  *
+ * @param[in] pThingState State of the thing the publish is for.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo );
+static void updateAcceptedHandler( ShadowThingState_t * pThingState,
+                                   MQTTPublishInfo_t * pPublishInfo );
 
 /**
  * @brief Process payload from `/delete/rejected` topic.
@@ -265,14 +331,129 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo );
  * document which was not present yet. This is considered to be success for this
  * demo application.
  *
+ * @param[in] pThingState State of the thing the publish is for.
  * @param[in] pPublishInfo Deserialized publish info pointer for the incoming
  * packet.
  */
-static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo );
+static void deleteRejectedHandler( ShadowThingState_t * pThingState,
+                                   MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Collect "version" and "state.powerOn" from a streamed /update/delta
+ * document. Called by the JSON tokenizer for every scalar value.
+ */
+static void streamedDeltaValueHandler( const char * pPath,
+                                       size_t pathLength,
+                                       const char * pValue,
+                                       size_t valueLength,
+                                       JSONTypes_t valueType,
+                                       void * pUserContext );
+
+/**
+ * @brief Process the payload of an incoming publish that does not fit the
+ * network buffer, chunk by chunk.
+ *
+ * /update/delta documents are fed to the incremental JSON tokenizer and
+ * applied like #updateDeltaHandler does once the whole payload was seen.
+ * Other shadow documents, such as large /get/accepted or /update/documents
+ * responses, are validated and logged.
+ *
+ * @param[in] pClient The client the publish was received on.
+ * @param[in] pTopicName Topic name of the publish.
+ * @param[in] topicNameLength Length of @p pTopicName.
+ * @param[in] pPayloadChunk The chunk.
+ * @param[in] chunkLength Length of @p pPayloadChunk.
+ * @param[in] payloadOffset Offset of the chunk in the payload.
+ * @param[in] payloadLength Length of the whole payload.
+ */
+static void streamingPublishHandler( MqttClient_t * pClient,
+                                     const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     const uint8_t * pPayloadChunk,
+                                     size_t chunkLength,
+                                     size_t payloadOffset,
+                                     size_t payloadLength );
+
+/**
+ * @brief Find the state of the thing named in an incoming shadow topic.
+ *
+ * @param[in] pThingName Thing name parsed by #Shadow_MatchTopicString.
+ * @param[in] thingNameLength Length of @p pThingName.
+ *
+ * @return The state of the thing; NULL if the thing is not served.
+ */
+static ShadowThingState_t * findThingState( const char * pThingName,
+                                            uint8_t thingNameLength );
+
+/**
+ * @brief Fill #thingTable with the things named in #SHADOW_THING_NAMES.
+ *
+ * @return EXIT_SUCCESS if at least one thing was added; EXIT_FAILURE
+ * otherwise.
+ */
+static int loadThings( void );
+
+/**
+ * @brief Subscribe to a shadow topic of a thing.
+ *
+ * @param[in] pMqttClient The MQTT client.
+ * @param[in] thingIndex Index of the thing in #thingTable.
+ * @param[in] topic The topic.
+ *
+ * @return EXIT_SUCCESS if SUBSCRIBE was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+static int32_t subscribeToThingTopic( MqttClient_t * pMqttClient,
+                                      size_t thingIndex,
+                                      ShadowThingTopic_t topic );
+
+/**
+ * @brief Unsubscribe from a shadow topic of a thing.
+ *
+ * @param[in] pMqttClient The MQTT client.
+ * @param[in] thingIndex Index of the thing in #thingTable.
+ * @param[in] topic The topic.
+ *
+ * @return EXIT_SUCCESS if UNSUBSCRIBE was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+static int32_t unsubscribeFromThingTopic( MqttClient_t * pMqttClient,
+                                          size_t thingIndex,
+                                          ShadowThingTopic_t topic );
+
+/**
+ * @brief Publish a document to a shadow topic of a thing.
+ *
+ * @param[in] pMqttClient The MQTT client.
+ * @param[in] thingIndex Index of the thing in #thingTable.
+ * @param[in] topic The topic.
+ * @param[in] pPayload The document.
+ * @param[in] payloadLength Length of @p pPayload.
+ *
+ * @return EXIT_SUCCESS if PUBLISH was successfully sent;
+ * EXIT_FAILURE otherwise.
+ */
+static int32_t publishToThingTopic( MqttClient_t * pMqttClient,
+                                    size_t thingIndex,
+                                    ShadowThingTopic_t topic,
+                                    const char * pPayload,
+                                    size_t payloadLength );
+
+/**
+ * @brief Run the shadow delete and update sequence for one thing.
+ *
+ * @param[in] pMqttClient The MQTT client.
+ * @param[in] thingIndex Index of the thing in #thingTable.
+ *
+ * @return EXIT_SUCCESS if the sequence succeeded; EXIT_FAILURE otherwise.
+ */
+static int runShadowDemoForThing( MqttClient_t * pMqttClient,
+                                  size_t thingIndex );
 
 /*-----------------------------------------------------------*/
 
-static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo )
+static void deleteRejectedHandler( ShadowThingState_t * pThingState,
+                                   MQTTPublishInfo_t * pPublishInfo )
 {
     JSONStatus_t result = JSONSuccess;
     char * pOutValue = NULL;
@@ -331,15 +512,15 @@ static void deleteRejectedHandler( MQTTPublishInfo_t * pPublishInfo )
     /* Mark Shadow delete operation as a success if error code is 404. */
     if( errorCode == 404UL )
     {
-        shadowDeleted = true;
+        pThingState->shadowDeleted = true;
     }
 }
 
 /*-----------------------------------------------------------*/
 
-static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
+static void updateDeltaHandler( ShadowThingState_t * pThingState,
+                                MQTTPublishInfo_t * pPublishInfo )
 {
-    static uint32_t currentVersion = 0; /* Remember the latestVersion # we've ever received */
     uint32_t version = 0U;
     uint32_t newState = 0U;
     char * outValue = NULL;
@@ -402,14 +583,14 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
         eventCallbackError = true;
     }
 
-    LogInfo( ( "version:%"PRIu32", currentVersion:%"PRIu32" \r\n", version, currentVersion ) );
+    LogInfo( ( "version:%"PRIu32", currentVersion:%"PRIu32" \r\n", version, pThingState->currentVersion ) );
 
     /* When the version is much newer than the on we retained, that means the powerOn
      * state is valid for us. */
-    if( version > currentVersion )
+    if( version > pThingState->currentVersion )
     {
         /* Set to received version as the current version. */
-        currentVersion = version;
+        pThingState->currentVersion = version;
 
         /* Get powerOn state from json documents. */
         result = JSON_Search( ( char * ) pPublishInfo->pPayload,
@@ -435,19 +616,19 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
         newState = ( uint32_t ) strtoul( outValue, NULL, 10 );
 
         LogInfo( ( "The new power on state newState:%"PRIu32", currentPowerOnState:%"PRIu32" \r\n",
-                   newState, currentPowerOnState ) );
+                   newState, pThingState->currentPowerOnState ) );
 
-        if( newState != currentPowerOnState )
+        if( newState != pThingState->currentPowerOnState )
         {
             /* The received powerOn state is different from the one we retained before, so we switch them
              * and set the flag. */
-            currentPowerOnState = newState;
+            pThingState->currentPowerOnState = newState;
 
             /* State change will be handled in main(), where we will publish a "reported"
              * state to the device shadow. We do not do it here because we are inside of
              * a callback from the MQTT library, so that we don't re-enter
              * the MQTT library. */
-            stateChanged = true;
+            pThingState->stateChanged = true;
         }
     }
     else
@@ -459,7 +640,8 @@ static void updateDeltaHandler( MQTTPublishInfo_t * pPublishInfo )
 
 /*-----------------------------------------------------------*/
 
-static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
+static void updateAcceptedHandler( ShadowThingState_t * pThingState,
+                                   MQTTPublishInfo_t * pPublishInfo )
 {
     char * outValue = NULL;
     uint32_t outValueLength = 0U;
@@ -522,20 +704,20 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
         /* Convert the code to an unsigned integer value. */
         receivedToken = ( uint32_t ) strtoul( outValue, NULL, 10 );
 
-        LogInfo( ( "receivedToken:%"PRIu32", clientToken:%"PRIu32" \r\n", receivedToken, clientToken ) );
+        LogInfo( ( "receivedToken:%"PRIu32", clientToken:%"PRIu32" \r\n", receivedToken, pThingState->clientToken ) );
 
         /* If the clientToken in this update/accepted message matches the one we
          * published before, it means the device shadow has accepted our latest
          * reported state. We are done. */
-        if( receivedToken == clientToken )
+        if( receivedToken == pThingState->clientToken )
         {
             LogInfo( ( "Received response from the device shadow. Previously published "
-                       "update with clientToken=%"PRIu32" has been accepted. ", clientToken ) );
+                       "update with clientToken=%"PRIu32" has been accepted. ", pThingState->clientToken ) );
         }
         else
         {
             LogWarn( ( "The received clientToken=%"PRIu32" is not identical with the one=%"PRIu32" we sent "
-                       , receivedToken, clientToken ) );
+                       , receivedToken, pThingState->clientToken ) );
         }
     }
     else
@@ -547,6 +729,138 @@ static void updateAcceptedHandler( MQTTPublishInfo_t * pPublishInfo )
 
 /*-----------------------------------------------------------*/
 
+static void streamedDeltaValueHandler( const char * pPath,
+                                       size_t pathLength,
+                                       const char * pValue,
+                                       size_t valueLength,
+                                       JSONTypes_t valueType,
+                                       void * pUserContext )
+{
+    StreamedDelta_t * pDelta = ( StreamedDelta_t * ) pUserContext;
+    char number[ STREAMED_NUMBER_MAX_LENGTH + 1U ];
+
+    assert( pDelta != NULL );
+
+    if( ( valueType == JSONNumber ) && ( valueLength <= STREAMED_NUMBER_MAX_LENGTH ) )
+    {
+        /* The value is not terminated, so copy it before converting. */
+        ( void ) memcpy( number, pValue, valueLength );
+        number[ valueLength ] = '\0';
+
+        if( ( pathLength == ( sizeof( "version" ) - 1U ) ) &&
+            ( strncmp( pPath, "version", pathLength ) == 0 ) )
+        {
+            pDelta->version = ( uint32_t ) strtoul( number, NULL, 10 );
+            pDelta->versionFound = true;
+        }
+        else if( ( pathLength == ( sizeof( "state.powerOn" ) - 1U ) ) &&
+                 ( strncmp( pPath, "state.powerOn", pathLength ) == 0 ) )
+        {
+            pDelta->powerOnState = ( uint32_t ) strtoul( number, NULL, 10 );
+            pDelta->powerOnFound = true;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void streamingPublishHandler( MqttClient_t * pClient,
+                                     const char * pTopicName,
+                                     uint16_t topicNameLength,
+                                     const uint8_t * pPayloadChunk,
+                                     size_t chunkLength,
+                                     size_t payloadOffset,
+                                     size_t payloadLength )
+{
+    const char * pThingName = NULL;
+    uint8_t thingNameLength = 0U;
+    const char * pShadowName = NULL;
+    uint8_t shadowNameLength = 0U;
+    JsonStreamStatus_t result = JsonStreamSuccess;
+
+    if( payloadOffset == 0U )
+    {
+        LogInfo( ( "Streaming %lu byte payload on %.*s.",
+                   ( unsigned long ) payloadLength,
+                   topicNameLength,
+                   pTopicName ) );
+
+        pStreamedThingState = NULL;
+
+        if( SHADOW_SUCCESS != Shadow_MatchTopicString( pTopicName,
+                                                       topicNameLength,
+                                                       &streamedMessageType,
+                                                       &pThingName,
+                                                       &thingNameLength,
+                                                       &pShadowName,
+                                                       &shadowNameLength ) )
+        {
+            streamedMessageType = ShadowMessageTypeMaxNum;
+        }
+        else
+        {
+            pStreamedThingState = findThingState( pThingName, thingNameLength );
+        }
+
+        ( void ) memset( &streamedDelta, 0x00, sizeof( streamedDelta ) );
+        ( void ) JsonStream_Init( &streamedDocumentParser, streamedDeltaValueHandler, &streamedDelta );
+    }
+
+    result = JsonStream_Feed( &streamedDocumentParser, ( const char * ) pPayloadChunk, chunkLength );
+
+    if( ( payloadOffset + chunkLength ) == payloadLength )
+    {
+        if( result == JsonStreamSuccess )
+        {
+            result = JsonStream_Finish( &streamedDocumentParser );
+        }
+
+        if( result != JsonStreamSuccess )
+        {
+            LogError( ( "The streamed json document is invalid: %d.", result ) );
+
+            if( streamedMessageType == ShadowMessageTypeUpdateDelta )
+            {
+                eventCallbackError = true;
+            }
+        }
+        else if( ( streamedMessageType == ShadowMessageTypeUpdateDelta ) &&
+                 ( pStreamedThingState != NULL ) )
+        {
+            if( ( streamedDelta.versionFound == false ) || ( streamedDelta.powerOnFound == false ) )
+            {
+                LogError( ( "No version or powerOn in streamed json document!!" ) );
+                eventCallbackError = true;
+            }
+            else if( streamedDelta.version > pStreamedThingState->currentVersion )
+            {
+                pStreamedThingState->currentVersion = streamedDelta.version;
+
+                LogInfo( ( "The new power on state newState:%"PRIu32", currentPowerOnState:%"PRIu32" \r\n",
+                           streamedDelta.powerOnState, pStreamedThingState->currentPowerOnState ) );
+
+                if( streamedDelta.powerOnState != pStreamedThingState->currentPowerOnState )
+                {
+                    /* Handled in main(), as for a delta that fits the
+                     * network buffer. */
+                    pStreamedThingState->currentPowerOnState = streamedDelta.powerOnState;
+                    pStreamedThingState->stateChanged = true;
+                }
+            }
+            else
+            {
+                LogWarn( ( "The received version is smaller than current one!!" ) );
+            }
+        }
+        else
+        {
+            LogInfo( ( "Streamed shadow message type:%d processed.", streamedMessageType ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 /* This is the callback function invoked by the MQTT stack when it receives
  * incoming messages. This function demonstrates how to use the Shadow_MatchTopicString
  * function to determine whether the incoming message is a device shadow message
@@ -562,6 +876,7 @@ static void eventCallback( MQTTContext_t * pMqttContext,
     const char * pShadowName = NULL;
     uint8_t shadowNameLength = 0U;
     uint16_t packetIdentifier;
+    ShadowThingState_t * pThingState = NULL;
 
     ( void ) pMqttContext;
 
@@ -587,17 +902,28 @@ static void eventCallback( MQTTContext_t * pMqttContext,
                                                        &thingNameLength,
                                                        &pShadowName,
                                                        &shadowNameLength ) )
+        {
+            /* The thing name parsed from the topic selects the state. */
+            pThingState = findThingState( pThingName, thingNameLength );
+        }
+        else
+        {
+            LogError( ( "Shadow_MatchTopicString parse failed:%s !!", ( const char * ) pDeserializedInfo->pPublishInfo->pTopicName ) );
+            eventCallbackError = true;
+        }
+
+        if( pThingState != NULL )
         {
             /* Upon successful return, the messageType has been filled in. */
             if( messageType == ShadowMessageTypeUpdateDelta )
             {
                 /* Handler function to process payload. */
-                updateDeltaHandler( pDeserializedInfo->pPublishInfo );
+                updateDeltaHandler( pThingState, pDeserializedInfo->pPublishInfo );
             }
             else if( messageType == ShadowMessageTypeUpdateAccepted )
             {
                 /* Handler function to process payload. */
-                updateAcceptedHandler( pDeserializedInfo->pPublishInfo );
+                updateAcceptedHandler( pThingState, pDeserializedInfo->pPublishInfo );
             }
             else if( messageType == ShadowMessageTypeUpdateDocuments )
             {
@@ -610,30 +936,345 @@ static void eventCallback( MQTTContext_t * pMqttContext,
             else if( messageType == ShadowMessageTypeDeleteAccepted )
             {
                 LogInfo( ( "Received an MQTT incoming publish on /delete/accepted topic." ) );
-                shadowDeleted = true;
-                deleteResponseReceived = true;
+                pThingState->shadowDeleted = true;
+                pThingState->deleteResponseReceived = true;
             }
             else if( messageType == ShadowMessageTypeDeleteRejected )
             {
                 /* Handler function to process payload. */
-                deleteRejectedHandler( pDeserializedInfo->pPublishInfo );
-                deleteResponseReceived = true;
+                deleteRejectedHandler( pThingState, pDeserializedInfo->pPublishInfo );
+                pThingState->deleteResponseReceived = true;
             }
             else
             {
                 LogInfo( ( "Other message type:%d !!", messageType ) );
             }
         }
+    }
+    else
+    {
+        HandleOtherIncomingPacket( pMqttContext, pPacketInfo, packetIdentifier );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static ShadowThingState_t * findThingState( const char * pThingName,
+                                            uint8_t thingNameLength )
+{
+    ShadowThingState_t * pThingState = NULL;
+    size_t thingIndex = 0U;
+
+    if( ShadowThingTable_Find( &thingTable, pThingName, thingNameLength, &thingIndex ) == ShadowThingTableSuccess )
+    {
+        pThingState = &thingStates[ thingIndex ];
+    }
+    else
+    {
+        LogWarn( ( "Ignoring shadow message for unknown thing %.*s.",
+                   ( int ) thingNameLength,
+                   pThingName ) );
+    }
+
+    return pThingState;
+}
+
+/*-----------------------------------------------------------*/
+
+static int loadThings( void )
+{
+    int returnStatus = EXIT_SUCCESS;
+    const char * pNames = SHADOW_THING_NAMES;
+    const char * pName = NULL;
+    size_t nameLength = 0U;
+    size_t thingIndex = 0U;
+    ShadowThingTableStatus_t tableStatus = ShadowThingTableSuccess;
+
+    ( void ) ShadowThingTable_Init( &thingTable, SHADOW_NAME, SHADOW_NAME_LENGTH );
+    ( void ) memset( thingStates, 0x00, sizeof( thingStates ) );
+
+    if( *pNames == '\0' )
+    {
+        /* No list given: the device is its own and only thing. */
+        pNames = CLIENT_IDENTIFIER;
+    }
+
+    while( ( *pNames != '\0' ) && ( returnStatus == EXIT_SUCCESS ) )
+    {
+        /* Split on commas, skipping blanks around the names. */
+        while( *pNames == ' ' )
+        {
+            pNames++;
+        }
+
+        pName = pNames;
+        nameLength = strcspn( pName, "," );
+        pNames += nameLength;
+
+        if( *pNames == ',' )
+        {
+            pNames++;
+        }
+
+        while( ( nameLength > 0U ) && ( pName[ nameLength - 1U ] == ' ' ) )
+        {
+            nameLength--;
+        }
+
+        if( nameLength == 0U )
+        {
+            continue;
+        }
+
+        tableStatus = ( nameLength > SHADOW_THINGNAME_LENGTH_MAX ) ? ShadowThingTableBadParameter :
+                      ShadowThingTable_Add( &thingTable, pName, ( uint8_t ) nameLength, &thingIndex );
+
+        if( tableStatus != ShadowThingTableSuccess )
+        {
+            LogError( ( "Cannot serve thing %.*s: status=%d.",
+                        ( int ) nameLength,
+                        pName,
+                        tableStatus ) );
+            returnStatus = EXIT_FAILURE;
+        }
         else
         {
-            LogError( ( "Shadow_MatchTopicString parse failed:%s !!", ( const char * ) pDeserializedInfo->pPublishInfo->pTopicName ) );
-            eventCallbackError = true;
+            LogInfo( ( "Serving the shadow of thing %.*s.",
+                       ( int ) nameLength,
+                       pName ) );
         }
     }
-    else
+
+    if( ShadowThingTable_Count( &thingTable ) == 0U )
+    {
+        LogError( ( "No thing to serve." ) );
+        returnStatus = EXIT_FAILURE;
+    }
+
+    return returnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t subscribeToThingTopic( MqttClient_t * pMqttClient,
+                                      size_t thingIndex,
+                                      ShadowThingTopic_t topic )
+{
+    const char * pTopic = NULL;
+    uint16_t topicLength = 0U;
+
+    ( void ) ShadowThingTable_GetTopic( &thingTable, thingIndex, topic, &pTopic, &topicLength );
+
+    return SubscribeToTopic( pMqttClient, pTopic, topicLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t unsubscribeFromThingTopic( MqttClient_t * pMqttClient,
+                                          size_t thingIndex,
+                                          ShadowThingTopic_t topic )
+{
+    const char * pTopic = NULL;
+    uint16_t topicLength = 0U;
+
+    ( void ) ShadowThingTable_GetTopic( &thingTable, thingIndex, topic, &pTopic, &topicLength );
+
+    return UnsubscribeFromTopic( pMqttClient, pTopic, topicLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t publishToThingTopic( MqttClient_t * pMqttClient,
+                                    size_t thingIndex,
+                                    ShadowThingTopic_t topic,
+                                    const char * pPayload,
+                                    size_t payloadLength )
+{
+    const char * pTopic = NULL;
+    uint16_t topicLength = 0U;
+
+    ( void ) ShadowThingTable_GetTopic( &thingTable, thingIndex, topic, &pTopic, &topicLength );
+
+    return PublishToTopic( pMqttClient, pTopic, topicLength, pPayload, payloadLength );
+}
+
+/*-----------------------------------------------------------*/
+
+static int runShadowDemoForThing( MqttClient_t * pMqttClient,
+                                  size_t thingIndex )
+{
+    int returnStatus = EXIT_SUCCESS;
+    ShadowThingState_t * pThingState = &thingStates[ thingIndex ];
+
+    /* A buffer containing the update document. It has static duration to prevent
+     * it from being placed on the call stack. */
+    static char updateDocument[ SHADOW_REPORTED_JSON_LENGTH + 1 ] = { 0 };
+
+    /* Reset the shadow delete status flags. */
+    pThingState->deleteResponseReceived = false;
+    pThingState->shadowDeleted = false;
+
+    /* First of all, try to delete any Shadow document in the cloud.
+     * Try to subscribe to `/delete/accepted` and `/delete/rejected` topics. */
+    returnStatus = subscribeToThingTopic( pMqttClient, thingIndex, ShadowThingTopicDeleteAccepted );
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        /* Try to subscribe to `/delete/rejected` topic. */
+        returnStatus = subscribeToThingTopic( pMqttClient, thingIndex, ShadowThingTopicDeleteRejected );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        /* Publish to Shadow `delete` topic to attempt to delete the
+         * Shadow document if exists. */
+        returnStatus = publishToThingTopic( pMqttClient,
+                                            thingIndex,
+                                            ShadowThingTopicDelete,
+                                            updateDocument,
+                                            0U );
+    }
+
+    /* Unsubscribe from the `/delete/accepted` and 'delete/rejected` topics.*/
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = unsubscribeFromThingTopic( pMqttClient, thingIndex, ShadowThingTopicDeleteAccepted );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = unsubscribeFromThingTopic( pMqttClient, thingIndex, ShadowThingTopicDeleteRejected );
+    }
+
+    /* Check if an incoming publish on `/delete/accepted` or `/delete/rejected`
+     * topics. If a response is not received, mark the demo execution as a failure.*/
+    if( ( returnStatus == EXIT_SUCCESS ) && ( pThingState->deleteResponseReceived != true ) )
+    {
+        LogError( ( "Failed to receive a response for Shadow delete." ) );
+        returnStatus = EXIT_FAILURE;
+    }
+
+    /* Check if Shadow document delete was successful. A delete can be
+     * successful in cases listed below.
+     *  1. If an incoming publish is received on `/delete/accepted` topic.
+     *  2. If an incoming publish is received on `/delete/rejected` topic
+     *     with an error code 404. This indicates that a delete was
+     *     attempted when a Shadow document is not available for the
+     *     Thing. */
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        if( pThingState->shadowDeleted == false )
+        {
+            LogError( ( "Shadow delete operation failed." ) );
+            returnStatus = EXIT_FAILURE;
+        }
+    }
+
+    /* Successfully connect to MQTT broker, the next step is
+     * to subscribe shadow topics. */
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = subscribeToThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateDelta );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = subscribeToThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateAccepted );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = subscribeToThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateRejected );
+    }
+
+    /* Then we publish a desired state to the /update topic. Since we've deleted
+     * the device shadow at the beginning of the demo, this will cause a delta message
+     * to be published, which we have subscribed to.
+     * In many real applications, the desired state is not published by
+     * the device itself. But for the purpose of making this demo self-contained,
+     * we publish one here so that we can receive a delta message later.
+     */
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        /* desired power on state . */
+        LogInfo( ( "Send desired power state with 1." ) );
+
+        ( void ) memset( updateDocument,
+                         0x00,
+                         sizeof( updateDocument ) );
+
+        /* Keep the client token in global variable used to compare if
+         * the same token in /update/accepted. */
+        pThingState->clientToken = ( Clock_GetTimeMs() % 1000000 );
+
+        snprintf( updateDocument,
+                  SHADOW_DESIRED_JSON_LENGTH + 1,
+                  SHADOW_DESIRED_JSON,
+                  ( int ) 1,
+                  ( long unsigned ) pThingState->clientToken );
+
+        returnStatus = publishToThingTopic( pMqttClient,
+                                            thingIndex,
+                                            ShadowThingTopicUpdate,
+                                            updateDocument,
+                                            ( SHADOW_DESIRED_JSON_LENGTH + 1 ) );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        /* Note that PublishToTopic already called MQTT_ProcessLoop,
+         * therefore responses may have been received and the eventCallback
+         * may have been called, which may have changed the pThingState->stateChanged flag.
+         * Check if the state change flag has been modified or not. If it's modified,
+         * then we publish reported state to update topic.
+         */
+        if( pThingState->stateChanged == true )
+        {
+            /* Report the latest power state back to device shadow. */
+            LogInfo( ( "Report to the state change: %"PRIu32"", pThingState->currentPowerOnState ) );
+            ( void ) memset( updateDocument,
+                             0x00,
+                             sizeof( updateDocument ) );
+
+            /* Keep the client token in global variable used to compare if
+             * the same token in /update/accepted. */
+            pThingState->clientToken = ( Clock_GetTimeMs() % 1000000 );
+
+            snprintf( updateDocument,
+                      SHADOW_REPORTED_JSON_LENGTH + 1,
+                      SHADOW_REPORTED_JSON,
+                      ( int ) pThingState->currentPowerOnState,
+                      ( long unsigned ) pThingState->clientToken );
+
+            returnStatus = publishToThingTopic( pMqttClient,
+                                                thingIndex,
+                                                ShadowThingTopicUpdate,
+                                                updateDocument,
+                                                ( SHADOW_REPORTED_JSON_LENGTH + 1 ) );
+        }
+        else
+        {
+            LogInfo( ( "No change from /update/delta, unsubscribe all shadow topics and disconnect from MQTT.\r\n" ) );
+        }
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        LogInfo( ( "Start to unsubscribe shadow topics and disconnect from MQTT. \r\n" ) );
+        returnStatus = unsubscribeFromThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateDelta );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
+    {
+        returnStatus = unsubscribeFromThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateAccepted );
+    }
+
+    if( returnStatus == EXIT_SUCCESS )
     {
-        HandleOtherIncomingPacket( pPacketInfo, packetIdentifier );
+        returnStatus = unsubscribeFromThingTopic( pMqttClient, thingIndex, ShadowThingTopicUpdateRejected );
     }
+
+    return returnStatus;
 }
 
 /*-----------------------------------------------------------*/
@@ -641,19 +1282,20 @@ static void eventCallback( MQTTContext_t * pMqttContext,
 /**
  * @brief Entry point of shadow demo.
  *
- * This main function demonstrates how to use the macros provided by the
+ * This main function demonstrates how to use #Shadow_AssembleTopicString of the
  * Device Shadow library to assemble strings for the MQTT topics defined
- * by AWS IoT Device Shadow. Named shadow topic strings differ from unnamed
- * ("Classic") topic strings as indicated by the tokens within square brackets.
+ * by AWS IoT Device Shadow, for thing names known only at run time. Named
+ * shadow topic strings differ from unnamed ("Classic") topic strings as
+ * indicated by the tokens within square brackets.
  *
- * The main function uses these macros for topics to subscribe to:
- * - SHADOW_TOPIC_STR_UPDATE_DELTA for "$aws/things/thingName/shadow[/name/shadowname]/update/delta"
- * - SHADOW_TOPIC_STR_UPDATE_ACC for "$aws/things/thingName/shadow[/name/shadowname]/update/accepted"
- * - SHADOW_TOPIC_STR_UPDATE_REJ for "$aws/things/thingName/shadow[/name/shadowname]/update/rejected"
+ * The main function subscribes to these topics of every thing:
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/delta"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/accepted"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update/rejected"
  *
- * It also uses these macros for topics to publish to:
- * - SHADOW_TOPIC_STR_DELETE for "$aws/things/thingName/shadow[/name/shadowname]/delete"
- * - SHADOW_TOPIC_STR_UPDATE for "$aws/things/thingName/shadow[/name/shadowname]/update"
+ * It also publishes to these topics of every thing:
+ * - "$aws/things/thingName/shadow[/name/shadowname]/delete"
+ * - "$aws/things/thingName/shadow[/name/shadowname]/update"
  *
  * The helper functions this demo uses for MQTT operations have internal
  * loops to process incoming messages. Those are not the focus of this demo
@@ -664,17 +1306,38 @@ int aws_iot_demo_main( int argc,
 {
     int returnStatus = EXIT_SUCCESS;
     int demoRunCount = 0;
-
-    /* A buffer containing the update document. It has static duration to prevent
-     * it from being placed on the call stack. */
-    static char updateDocument[ SHADOW_REPORTED_JSON_LENGTH + 1 ] = { 0 };
+    MqttClient_t * pMqttClient = NULL;
+    size_t thingIndex = 0U;
 
     ( void ) argc;
     ( void ) argv;
 
+    /* The topics of every thing are assembled once, here, and reused by
+     * every iteration. */
+    if( loadThings() != EXIT_SUCCESS )
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* The client keeps its round trip time estimate and unacked publishes
+     * across the retries of the demo loop. */
+    pMqttClient = CreateMqttClient( NULL );
+
+    if( pMqttClient == NULL )
+    {
+        return EXIT_FAILURE;
+    }
+
+    #ifdef CONFIG_EXAMPLE_TLS_HANDSHAKE_BENCHMARK
+        ( void ) RunTlsHandshakeBenchmark( pMqttClient, CONFIG_EXAMPLE_TLS_HANDSHAKE_BENCHMARK_COUNT );
+    #endif
+
     do
     {
-        returnStatus = EstablishMqttSession( eventCallback );
+        /* Shadow documents larger than the network buffer are streamed
+         * through the JSON tokenizer instead of being rejected. */
+        SetStreamingPublishHandler( pMqttClient, streamingPublishHandler );
+        returnStatus = EstablishMqttSession( pMqttClient, eventCallback );
 
         if( returnStatus == EXIT_FAILURE )
         {
@@ -683,207 +1346,16 @@ int aws_iot_demo_main( int argc,
         }
         else
         {
-            /* Reset the shadow delete status flags. */
-            deleteResponseReceived = false;
-            shadowDeleted = false;
-
-            /* First of all, try to delete any Shadow document in the cloud.
-             * Try to subscribe to `/delete/accepted` and `/delete/rejected` topics. */
-            returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_DELETE_ACC( THING_NAME, SHADOW_NAME ),
-                                             SHADOW_TOPIC_LEN_DELETE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* Try to subscribe to `/delete/rejected` topic. */
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_DELETE_REJ( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_DELETE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
+            /* All things share the one MQTT session. */
+            for( thingIndex = 0U;
+                 ( thingIndex < ShadowThingTable_Count( &thingTable ) ) && ( returnStatus == EXIT_SUCCESS );
+                 thingIndex++ )
             {
-                /* Publish to Shadow `delete` topic to attempt to delete the
-                 * Shadow document if exists. */
-                returnStatus = PublishToTopic( SHADOW_TOPIC_STR_DELETE( THING_NAME, SHADOW_NAME ),
-                                               SHADOW_TOPIC_LEN_DELETE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
-                                               updateDocument,
-                                               0U );
-            }
-
-            /* Unsubscribe from the `/delete/accepted` and 'delete/rejected` topics.*/
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_DELETE_ACC( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_DELETE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_DELETE_REJ( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_DELETE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            /* Check if an incoming publish on `/delete/accepted` or `/delete/rejected`
-             * topics. If a response is not received, mark the demo execution as a failure.*/
-            if( ( returnStatus == EXIT_SUCCESS ) && ( deleteResponseReceived != true ) )
-            {
-                LogError( ( "Failed to receive a response for Shadow delete." ) );
-                returnStatus = EXIT_FAILURE;
-            }
-
-            /* Check if Shadow document delete was successful. A delete can be
-             * successful in cases listed below.
-             *  1. If an incoming publish is received on `/delete/accepted` topic.
-             *  2. If an incoming publish is received on `/delete/rejected` topic
-             *     with an error code 404. This indicates that a delete was
-             *     attempted when a Shadow document is not available for the
-             *     Thing. */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                if( shadowDeleted == false )
-                {
-                    LogError( ( "Shadow delete operation failed." ) );
-                    returnStatus = EXIT_FAILURE;
-                }
-            }
-
-            /* Successfully connect to MQTT broker, the next step is
-             * to subscribe shadow topics. */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_DELTA( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_DELTA( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_ACC( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = SubscribeToTopic( SHADOW_TOPIC_STR_UPDATE_REJ( THING_NAME, SHADOW_NAME ),
-                                                 SHADOW_TOPIC_LEN_UPDATE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            /* This demo uses a constant #THING_NAME and #SHADOW_NAME known at compile time therefore
-             * we can use macros to assemble shadow topic strings.
-             * If the thing name or shadow name is only known at run time, then we could use the API
-             * #Shadow_AssembleTopicString to assemble shadow topic strings, here is the example for /update/delta:
-             *
-             * For /update/delta:
-             *
-             * #define SHADOW_TOPIC_MAX_LENGTH  (256U)
-             *
-             * ShadowStatus_t shadowStatus = SHADOW_SUCCESS;
-             * char topicBuffer[ SHADOW_TOPIC_MAX_LENGTH ] = { 0 };
-             * uint16_t bufferSize = SHADOW_TOPIC_MAX_LENGTH;
-             * uint16_t outLength = 0;
-             * const char thingName[] = { "TestThingName" };
-             * uint16_t thingNameLength  = ( sizeof( thingName ) - 1U );
-             * const char shadowName[] = { "TestShadowName" };
-             * uint16_t shadowNameLength  = ( sizeof( shadowName ) - 1U );
-             *
-             * shadowStatus = Shadow_AssembleTopicString( ShadowTopicStringTypeUpdateDelta,
-             *                                            thingName,
-             *                                            thingNameLength,
-             *                                            shadowName,
-             *                                            shadowNameLength,
-             *                                            & ( topicBuffer[ 0 ] ),
-             *                                            bufferSize,
-             *                                            & outLength );
-             */
-
-            /* Then we publish a desired state to the /update topic. Since we've deleted
-             * the device shadow at the beginning of the demo, this will cause a delta message
-             * to be published, which we have subscribed to.
-             * In many real applications, the desired state is not published by
-             * the device itself. But for the purpose of making this demo self-contained,
-             * we publish one here so that we can receive a delta message later.
-             */
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* desired power on state . */
-                LogInfo( ( "Send desired power state with 1." ) );
-
-                ( void ) memset( updateDocument,
-                                 0x00,
-                                 sizeof( updateDocument ) );
-
-                /* Keep the client token in global variable used to compare if
-                 * the same token in /update/accepted. */
-                clientToken = ( Clock_GetTimeMs() % 1000000 );
-
-                snprintf( updateDocument,
-                          SHADOW_DESIRED_JSON_LENGTH + 1,
-                          SHADOW_DESIRED_JSON,
-                          ( int ) 1,
-                          ( long unsigned ) clientToken );
-
-                returnStatus = PublishToTopic( SHADOW_TOPIC_STR_UPDATE( THING_NAME, SHADOW_NAME ),
-                                               SHADOW_TOPIC_LEN_UPDATE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
-                                               updateDocument,
-                                               ( SHADOW_DESIRED_JSON_LENGTH + 1 ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                /* Note that PublishToTopic already called MQTT_ProcessLoop,
-                 * therefore responses may have been received and the eventCallback
-                 * may have been called, which may have changed the stateChanged flag.
-                 * Check if the state change flag has been modified or not. If it's modified,
-                 * then we publish reported state to update topic.
-                 */
-                if( stateChanged == true )
-                {
-                    /* Report the latest power state back to device shadow. */
-                    LogInfo( ( "Report to the state change: %"PRIu32"", currentPowerOnState ) );
-                    ( void ) memset( updateDocument,
-                                     0x00,
-                                     sizeof( updateDocument ) );
-
-                    /* Keep the client token in global variable used to compare if
-                     * the same token in /update/accepted. */
-                    clientToken = ( Clock_GetTimeMs() % 1000000 );
-
-                    snprintf( updateDocument,
-                              SHADOW_REPORTED_JSON_LENGTH + 1,
-                              SHADOW_REPORTED_JSON,
-                              ( int ) currentPowerOnState,
-                              ( long unsigned ) clientToken );
-
-                    returnStatus = PublishToTopic( SHADOW_TOPIC_STR_UPDATE( THING_NAME, SHADOW_NAME ),
-                                                   SHADOW_TOPIC_LEN_UPDATE( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ),
-                                                   updateDocument,
-                                                   ( SHADOW_REPORTED_JSON_LENGTH + 1 ) );
-                }
-                else
-                {
-                    LogInfo( ( "No change from /update/delta, unsubscribe all shadow topics and disconnect from MQTT.\r\n" ) );
-                }
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                LogInfo( ( "Start to unsubscribe shadow topics and disconnect from MQTT. \r\n" ) );
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_DELTA( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_DELTA( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_ACC( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_ACC( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
-            }
-
-            if( returnStatus == EXIT_SUCCESS )
-            {
-                returnStatus = UnsubscribeFromTopic( SHADOW_TOPIC_STR_UPDATE_REJ( THING_NAME, SHADOW_NAME ),
-                                                     SHADOW_TOPIC_LEN_UPDATE_REJ( THING_NAME_LENGTH, SHADOW_NAME_LENGTH ) );
+                returnStatus = runShadowDemoForThing( pMqttClient, thingIndex );
             }
 
             /* The MQTT session is always disconnected, even there were prior failures. */
-            returnStatus = DisconnectMqttSession();
+            returnStatus = DisconnectMqttSession( pMqttClient );
         }
 
         /* This demo performs only Device Shadow operations. If matching the Shadow
@@ -915,6 +1387,8 @@ int aws_iot_demo_main( int argc,
         }
     } while( returnStatus != EXIT_SUCCESS );
 
+    ReleaseMqttClient( pMqttClient );
+
     if( returnStatus == EXIT_SUCCESS )
     {
         /* Log message indicating the demo completed successfully. */
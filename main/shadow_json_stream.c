@@ -0,0 +1,822 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202108.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_json_stream.c
+ *
+ * @brief Incremental JSON tokenizer used to process shadow documents as their
+ * payload is received, without buffering the whole document.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "shadow_json_stream.h"
+
+/**
+ * @brief What the tokenizer expects next outside of a token.
+ */
+#define EXPECT_VALUE           ( 0U ) /**< A value, after ':' or ',' in an array, or at the top. */
+#define EXPECT_VALUE_OR_END    ( 1U ) /**< A value or ']', right after '['. */
+#define EXPECT_KEY_OR_END      ( 2U ) /**< A key or '}', right after '{'. */
+#define EXPECT_KEY             ( 3U ) /**< A key, after ',' in an object. */
+#define EXPECT_COLON           ( 4U ) /**< The ':' after a key. */
+#define EXPECT_COMMA_OR_END    ( 5U ) /**< ',' or the end of the container, after a value. */
+#define EXPECT_DONE            ( 6U ) /**< Only whitespace, after the top-level value. */
+
+/**
+ * @brief Lexer state inside a token.
+ */
+#define LEX_NONE               ( 0U ) /**< Not inside a token. */
+#define LEX_STRING             ( 1U ) /**< Inside a string. */
+#define LEX_STRING_ESCAPE      ( 2U ) /**< After a backslash in a string. */
+#define LEX_STRING_UNICODE     ( 3U ) /**< Inside the hex digits of a \u escape. */
+#define LEX_LITERAL            ( 4U ) /**< Inside a number, true, false or null. */
+
+/**
+ * @brief Position in the number grammar of the literal read so far.
+ */
+#define NUMBER_START           ( 0U ) /**< Nothing read. */
+#define NUMBER_SIGN            ( 1U ) /**< After the leading '-'. */
+#define NUMBER_ZERO            ( 2U ) /**< After a leading '0'. */
+#define NUMBER_INTEGER         ( 3U ) /**< In the integer digits. */
+#define NUMBER_POINT           ( 4U ) /**< After the '.'. */
+#define NUMBER_FRACTION        ( 5U ) /**< In the fraction digits. */
+#define NUMBER_EXPONENT        ( 6U ) /**< After 'e' or 'E'. */
+#define NUMBER_EXPONENT_SIGN   ( 7U ) /**< After the exponent sign. */
+#define NUMBER_EXPONENT_DIGITS ( 8U ) /**< In the exponent digits. */
+#define NUMBER_INVALID         ( 9U ) /**< Not a number. */
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Append a character to the current token, marking it truncated if
+ * it no longer fits.
+ *
+ * @param[in] pParser The tokenizer.
+ * @param[in] c The character.
+ */
+static void appendToken( JsonStreamParser_t * pParser,
+                         char c );
+
+/**
+ * @brief Append characters to the current path, marking it invalid if they
+ * do not fit.
+ *
+ * @param[in] pParser The tokenizer.
+ * @param[in] pData The characters.
+ * @param[in] length Number of characters.
+ */
+static void appendPath( JsonStreamParser_t * pParser,
+                        const char * pData,
+                        size_t length );
+
+/**
+ * @brief Set the path of the value that starts at the current position.
+ *
+ * Inside an object the path was already set by the key; inside an array it
+ * is the array path followed by the element index.
+ *
+ * @param[in] pParser The tokenizer.
+ */
+static void beginValue( JsonStreamParser_t * pParser );
+
+/**
+ * @brief Update the expectation after a complete value.
+ *
+ * @param[in] pParser The tokenizer.
+ */
+static void endValue( JsonStreamParser_t * pParser );
+
+/**
+ * @brief Handle the end of a string token, which is either a key or a value.
+ *
+ * @param[in] pParser The tokenizer.
+ */
+static void endString( JsonStreamParser_t * pParser );
+
+/**
+ * @brief Validate and report a complete number, true, false or null.
+ *
+ * @param[in] pParser The tokenizer.
+ *
+ * @return JsonStreamSuccess or JsonStreamIllegalDocument.
+ */
+static JsonStreamStatus_t endLiteral( JsonStreamParser_t * pParser );
+
+/**
+ * @brief Advance the number grammar by one character of a literal.
+ *
+ * The literal is checked as it is read, so that one longer than the token
+ * buffer is still checked.
+ *
+ * @param[in] state The NUMBER_* state before @p c.
+ * @param[in] c The character.
+ *
+ * @return The NUMBER_* state after @p c.
+ */
+static uint8_t nextNumberState( uint8_t state,
+                                char c );
+
+/**
+ * @brief Check that a number grammar state ends a complete number.
+ *
+ * @param[in] state The NUMBER_* state after the last character.
+ *
+ * @return true if the literal is a number; false otherwise.
+ */
+static bool isNumberComplete( uint8_t state );
+
+/**
+ * @brief Open an object or array.
+ *
+ * @param[in] pParser The tokenizer.
+ * @param[in] isArray Whether an array is opened.
+ *
+ * @return JsonStreamSuccess or JsonStreamMaxDepthExceeded.
+ */
+static JsonStreamStatus_t pushFrame( JsonStreamParser_t * pParser,
+                                     bool isArray );
+
+/**
+ * @brief Process one character outside of a string.
+ *
+ * @param[in] pParser The tokenizer.
+ * @param[in] c The character.
+ *
+ * @return JsonStreamSuccess or an error.
+ */
+static JsonStreamStatus_t processStructural( JsonStreamParser_t * pParser,
+                                             char c );
+
+/*-----------------------------------------------------------*/
+
+static void appendToken( JsonStreamParser_t * pParser,
+                         char c )
+{
+    if( pParser->tokenLength < JSON_STREAM_MAX_TOKEN_LENGTH )
+    {
+        pParser->token[ pParser->tokenLength ] = c;
+        pParser->tokenLength++;
+    }
+    else
+    {
+        pParser->tokenTruncated = true;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void appendPath( JsonStreamParser_t * pParser,
+                        const char * pData,
+                        size_t length )
+{
+    if( ( pParser->pathValid == true ) &&
+        ( length <= ( JSON_STREAM_MAX_PATH_LENGTH - pParser->pathLength ) ) )
+    {
+        ( void ) memcpy( &pParser->path[ pParser->pathLength ], pData, length );
+        pParser->pathLength += length;
+    }
+    else
+    {
+        pParser->pathValid = false;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void beginValue( JsonStreamParser_t * pParser )
+{
+    JsonStreamFrame_t * pFrame = NULL;
+    char index[ 12 ];
+    size_t indexLength = sizeof( index );
+    uint32_t value = 0U;
+
+    if( pParser->depth == 0U )
+    {
+        pParser->pathLength = 0U;
+        pParser->pathValid = true;
+    }
+    else if( pParser->frames[ pParser->depth - 1U ].isArray == true )
+    {
+        pFrame = &pParser->frames[ pParser->depth - 1U ];
+        pParser->pathLength = pFrame->basePathLength;
+        pParser->pathValid = pFrame->pathValid;
+
+        /* Format "[<index>]" back to front. */
+        value = pFrame->arrayIndex;
+        indexLength--;
+        index[ indexLength ] = ']';
+
+        do
+        {
+            indexLength--;
+            index[ indexLength ] = ( char ) ( '0' + ( value % 10U ) );
+            value /= 10U;
+        } while( value > 0U );
+
+        indexLength--;
+        index[ indexLength ] = '[';
+
+        appendPath( pParser, &index[ indexLength ], sizeof( index ) - indexLength );
+    }
+    else
+    {
+        /* The path was set when the key ended. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void endValue( JsonStreamParser_t * pParser )
+{
+    pParser->expect = ( pParser->depth == 0U ) ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+}
+
+/*-----------------------------------------------------------*/
+
+static void endString( JsonStreamParser_t * pParser )
+{
+    JsonStreamFrame_t * pFrame = NULL;
+
+    pParser->lexState = LEX_NONE;
+
+    if( ( pParser->expect == EXPECT_KEY ) || ( pParser->expect == EXPECT_KEY_OR_END ) )
+    {
+        pFrame = &pParser->frames[ pParser->depth - 1U ];
+        pParser->pathLength = pFrame->basePathLength;
+        pParser->pathValid = pFrame->pathValid && ( pParser->tokenTruncated == false );
+
+        if( pParser->pathLength > 0U )
+        {
+            appendPath( pParser, ".", 1U );
+        }
+
+        appendPath( pParser, pParser->token, pParser->tokenLength );
+        pParser->expect = EXPECT_COLON;
+    }
+    else
+    {
+        if( ( pParser->pathValid == true ) && ( pParser->tokenTruncated == false ) )
+        {
+            pParser->callback( pParser->path,
+                               pParser->pathLength,
+                               pParser->token,
+                               pParser->tokenLength,
+                               JSONString,
+                               pParser->pUserContext );
+        }
+
+        endValue( pParser );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t nextNumberState( uint8_t state,
+                                char c )
+{
+    uint8_t next = NUMBER_INVALID;
+    bool isDigit = ( c >= '0' ) && ( c <= '9' );
+
+    switch( state )
+    {
+        case NUMBER_START:
+
+            if( c == '-' )
+            {
+                next = NUMBER_SIGN;
+            }
+            else if( c == '0' )
+            {
+                next = NUMBER_ZERO;
+            }
+            else if( isDigit == true )
+            {
+                next = NUMBER_INTEGER;
+            }
+            else
+            {
+                /* Not a number. */
+            }
+
+            break;
+
+        case NUMBER_SIGN:
+
+            if( c == '0' )
+            {
+                next = NUMBER_ZERO;
+            }
+            else if( isDigit == true )
+            {
+                next = NUMBER_INTEGER;
+            }
+            else
+            {
+                /* Not a number. */
+            }
+
+            break;
+
+        case NUMBER_ZERO:
+        case NUMBER_INTEGER:
+
+            /* No leading zeros. */
+            if( ( isDigit == true ) && ( state == NUMBER_INTEGER ) )
+            {
+                next = NUMBER_INTEGER;
+            }
+            else if( c == '.' )
+            {
+                next = NUMBER_POINT;
+            }
+            else if( ( c == 'e' ) || ( c == 'E' ) )
+            {
+                next = NUMBER_EXPONENT;
+            }
+            else
+            {
+                /* Not a number. */
+            }
+
+            break;
+
+        case NUMBER_POINT:
+        case NUMBER_FRACTION:
+
+            if( isDigit == true )
+            {
+                next = NUMBER_FRACTION;
+            }
+            else if( ( state == NUMBER_FRACTION ) && ( ( c == 'e' ) || ( c == 'E' ) ) )
+            {
+                next = NUMBER_EXPONENT;
+            }
+            else
+            {
+                /* Not a number. */
+            }
+
+            break;
+
+        case NUMBER_EXPONENT:
+
+            if( ( c == '+' ) || ( c == '-' ) )
+            {
+                next = NUMBER_EXPONENT_SIGN;
+            }
+            else if( isDigit == true )
+            {
+                next = NUMBER_EXPONENT_DIGITS;
+            }
+            else
+            {
+                /* Not a number. */
+            }
+
+            break;
+
+        case NUMBER_EXPONENT_SIGN:
+        case NUMBER_EXPONENT_DIGITS:
+
+            if( isDigit == true )
+            {
+                next = NUMBER_EXPONENT_DIGITS;
+            }
+
+            break;
+
+        default:
+            /* Once invalid, always invalid. */
+            break;
+    }
+
+    return next;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isNumberComplete( uint8_t state )
+{
+    return ( state == NUMBER_ZERO ) || ( state == NUMBER_INTEGER ) ||
+           ( state == NUMBER_FRACTION ) || ( state == NUMBER_EXPONENT_DIGITS );
+}
+
+/*-----------------------------------------------------------*/
+
+static JsonStreamStatus_t endLiteral( JsonStreamParser_t * pParser )
+{
+    JsonStreamStatus_t status = JsonStreamSuccess;
+    JSONTypes_t type = JSONInvalid;
+
+    pParser->lexState = LEX_NONE;
+
+    if( pParser->tokenTruncated == true )
+    {
+        /* Too long to be true, false or null, and too long to report, but
+         * still checked to be a number. */
+        if( isNumberComplete( pParser->numberState ) == true )
+        {
+            type = JSONNumber;
+        }
+        else
+        {
+            status = JsonStreamIllegalDocument;
+        }
+    }
+    else if( ( pParser->tokenLength == 4U ) && ( memcmp( pParser->token, "true", 4U ) == 0 ) )
+    {
+        type = JSONTrue;
+    }
+    else if( ( pParser->tokenLength == 5U ) && ( memcmp( pParser->token, "false", 5U ) == 0 ) )
+    {
+        type = JSONFalse;
+    }
+    else if( ( pParser->tokenLength == 4U ) && ( memcmp( pParser->token, "null", 4U ) == 0 ) )
+    {
+        type = JSONNull;
+    }
+    else if( isNumberComplete( pParser->numberState ) == true )
+    {
+        type = JSONNumber;
+    }
+    else
+    {
+        status = JsonStreamIllegalDocument;
+    }
+
+    if( status == JsonStreamSuccess )
+    {
+        if( ( pParser->pathValid == true ) && ( pParser->tokenTruncated == false ) )
+        {
+            pParser->callback( pParser->path,
+                               pParser->pathLength,
+                               pParser->token,
+                               pParser->tokenLength,
+                               type,
+                               pParser->pUserContext );
+        }
+
+        endValue( pParser );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static JsonStreamStatus_t pushFrame( JsonStreamParser_t * pParser,
+                                     bool isArray )
+{
+    JsonStreamStatus_t status = JsonStreamSuccess;
+    JsonStreamFrame_t * pFrame = NULL;
+
+    if( pParser->depth >= JSON_STREAM_MAX_DEPTH )
+    {
+        status = JsonStreamMaxDepthExceeded;
+    }
+    else
+    {
+        pFrame = &pParser->frames[ pParser->depth ];
+        pFrame->basePathLength = pParser->pathLength;
+        pFrame->pathValid = pParser->pathValid;
+        pFrame->arrayIndex = 0U;
+        pFrame->isArray = isArray;
+        pParser->depth++;
+        pParser->expect = ( isArray == true ) ? EXPECT_VALUE_OR_END : EXPECT_KEY_OR_END;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static JsonStreamStatus_t processStructural( JsonStreamParser_t * pParser,
+                                             char c )
+{
+    JsonStreamStatus_t status = JsonStreamSuccess;
+    bool valuePosition = ( pParser->expect == EXPECT_VALUE ) ||
+                         ( pParser->expect == EXPECT_VALUE_OR_END );
+    bool inArray = ( pParser->depth > 0U ) &&
+                   ( pParser->frames[ pParser->depth - 1U ].isArray == true );
+
+    if( ( c == ' ' ) || ( c == '\t' ) || ( c == '\r' ) || ( c == '\n' ) )
+    {
+        /* Whitespace between tokens. */
+    }
+    else if( c == '"' )
+    {
+        if( valuePosition == true )
+        {
+            beginValue( pParser );
+        }
+        else if( ( pParser->expect != EXPECT_KEY ) && ( pParser->expect != EXPECT_KEY_OR_END ) )
+        {
+            status = JsonStreamIllegalDocument;
+        }
+
+        pParser->tokenLength = 0U;
+        pParser->tokenTruncated = false;
+        pParser->lexState = LEX_STRING;
+    }
+    else if( ( c == '{' ) || ( c == '[' ) )
+    {
+        if( valuePosition == true )
+        {
+            beginValue( pParser );
+            status = pushFrame( pParser, ( c == '[' ) );
+        }
+        else
+        {
+            status = JsonStreamIllegalDocument;
+        }
+    }
+    else if( c == '}' )
+    {
+        if( ( inArray == false ) && ( pParser->depth > 0U ) &&
+            ( ( pParser->expect == EXPECT_KEY_OR_END ) || ( pParser->expect == EXPECT_COMMA_OR_END ) ) )
+        {
+            pParser->depth--;
+            endValue( pParser );
+        }
+        else
+        {
+            status = JsonStreamIllegalDocument;
+        }
+    }
+    else if( c == ']' )
+    {
+        if( ( inArray == true ) &&
+            ( ( pParser->expect == EXPECT_VALUE_OR_END ) || ( pParser->expect == EXPECT_COMMA_OR_END ) ) )
+        {
+            pParser->depth--;
+            endValue( pParser );
+        }
+        else
+        {
+            status = JsonStreamIllegalDocument;
+        }
+    }
+    else if( c == ',' )
+    {
+        if( pParser->expect != EXPECT_COMMA_OR_END )
+        {
+            status = JsonStreamIllegalDocument;
+        }
+        else if( inArray == true )
+        {
+            pParser->frames[ pParser->depth - 1U ].arrayIndex++;
+            pParser->expect = EXPECT_VALUE;
+        }
+        else
+        {
+            pParser->expect = EXPECT_KEY;
+        }
+    }
+    else if( c == ':' )
+    {
+        if( pParser->expect == EXPECT_COLON )
+        {
+            pParser->expect = EXPECT_VALUE;
+        }
+        else
+        {
+            status = JsonStreamIllegalDocument;
+        }
+    }
+    else if( ( valuePosition == true ) &&
+             ( ( c == '-' ) || ( ( c >= '0' ) && ( c <= '9' ) ) || ( c == 't' ) || ( c == 'f' ) || ( c == 'n' ) ) )
+    {
+        beginValue( pParser );
+        pParser->tokenLength = 0U;
+        pParser->tokenTruncated = false;
+        pParser->lexState = LEX_LITERAL;
+        pParser->numberState = nextNumberState( NUMBER_START, c );
+        appendToken( pParser, c );
+    }
+    else
+    {
+        status = JsonStreamIllegalDocument;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+JsonStreamStatus_t JsonStream_Init( JsonStreamParser_t * pParser,
+                                    JsonStreamValueCallback_t callback,
+                                    void * pUserContext )
+{
+    JsonStreamStatus_t status = JsonStreamSuccess;
+
+    if( ( pParser == NULL ) || ( callback == NULL ) )
+    {
+        status = JsonStreamNullParameter;
+    }
+    else
+    {
+        ( void ) memset( pParser, 0x00, sizeof( JsonStreamParser_t ) );
+        pParser->callback = callback;
+        pParser->pUserContext = pUserContext;
+        pParser->pathValid = true;
+        pParser->expect = EXPECT_VALUE;
+        pParser->lexState = LEX_NONE;
+        pParser->status = JsonStreamSuccess;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+JsonStreamStatus_t JsonStream_Feed( JsonStreamParser_t * pParser,
+                                    const char * pData,
+                                    size_t length )
+{
+    size_t i = 0U;
+    char c = '\0';
+
+    if( pParser == NULL )
+    {
+        /* Nothing to report the error in. */
+        length = 0U;
+    }
+    else if( ( pData == NULL ) && ( length > 0U ) )
+    {
+        pParser->status = JsonStreamNullParameter;
+    }
+
+    while( ( pParser != NULL ) && ( pParser->status == JsonStreamSuccess ) && ( i < length ) )
+    {
+        c = pData[ i ];
+
+        switch( pParser->lexState )
+        {
+            case LEX_STRING:
+
+                if( c == '"' )
+                {
+                    endString( pParser );
+                }
+                else if( ( uint8_t ) c < 0x20U )
+                {
+                    pParser->status = JsonStreamIllegalDocument;
+                }
+                else
+                {
+                    if( c == '\\' )
+                    {
+                        pParser->lexState = LEX_STRING_ESCAPE;
+                    }
+
+                    appendToken( pParser, c );
+                }
+
+                break;
+
+            case LEX_STRING_ESCAPE:
+
+                if( c == 'u' )
+                {
+                    pParser->unicodeDigits = 0U;
+                    pParser->lexState = LEX_STRING_UNICODE;
+                }
+                else if( ( c != '\0' ) && ( strchr( "\"\\/bfnrt", c ) != NULL ) )
+                {
+                    pParser->lexState = LEX_STRING;
+                }
+                else
+                {
+                    pParser->status = JsonStreamIllegalDocument;
+                }
+
+                appendToken( pParser, c );
+                break;
+
+            case LEX_STRING_UNICODE:
+
+                if( ( ( c >= '0' ) && ( c <= '9' ) ) ||
+                    ( ( c >= 'a' ) && ( c <= 'f' ) ) ||
+                    ( ( c >= 'A' ) && ( c <= 'F' ) ) )
+                {
+                    pParser->unicodeDigits++;
+
+                    if( pParser->unicodeDigits == 4U )
+                    {
+                        pParser->lexState = LEX_STRING;
+                    }
+
+                    appendToken( pParser, c );
+                }
+                else
+                {
+                    pParser->status = JsonStreamIllegalDocument;
+                }
+
+                break;
+
+            case LEX_LITERAL:
+
+                if( ( ( c >= '0' ) && ( c <= '9' ) ) ||
+                    ( ( c >= 'a' ) && ( c <= 'z' ) ) ||
+                    ( ( c >= 'A' ) && ( c <= 'Z' ) ) ||
+                    ( c == '.' ) || ( c == '+' ) || ( c == '-' ) )
+                {
+                    pParser->numberState = nextNumberState( pParser->numberState, c );
+                    appendToken( pParser, c );
+
+                    /* Past the buffer only a number can still be accepted. */
+                    if( ( pParser->tokenTruncated == true ) && ( pParser->numberState == NUMBER_INVALID ) )
+                    {
+                        pParser->status = JsonStreamIllegalDocument;
+                    }
+                }
+                else
+                {
+                    /* The character ends the literal and is processed again
+                     * as a structural character. */
+                    pParser->status = endLiteral( pParser );
+
+                    if( pParser->status == JsonStreamSuccess )
+                    {
+                        pParser->status = processStructural( pParser, c );
+                    }
+                }
+
+                break;
+
+            default:
+
+                if( pParser->expect == EXPECT_DONE )
+                {
+                    if( ( c != ' ' ) && ( c != '\t' ) && ( c != '\r' ) && ( c != '\n' ) )
+                    {
+                        pParser->status = JsonStreamIllegalDocument;
+                    }
+                }
+                else
+                {
+                    pParser->status = processStructural( pParser, c );
+                }
+
+                break;
+        }
+
+        i++;
+    }
+
+    return ( pParser == NULL ) ? JsonStreamNullParameter : pParser->status;
+}
+
+/*-----------------------------------------------------------*/
+
+JsonStreamStatus_t JsonStream_Finish( JsonStreamParser_t * pParser )
+{
+    JsonStreamStatus_t status = JsonStreamSuccess;
+
+    if( pParser == NULL )
+    {
+        status = JsonStreamNullParameter;
+    }
+    else
+    {
+        /* A top-level number has no delimiter and only ends with the
+         * document. */
+        if( ( pParser->status == JsonStreamSuccess ) && ( pParser->lexState == LEX_LITERAL ) )
+        {
+            pParser->status = endLiteral( pParser );
+        }
+
+        status = pParser->status;
+
+        if( ( status == JsonStreamSuccess ) &&
+            ( ( pParser->expect != EXPECT_DONE ) || ( pParser->lexState != LEX_NONE ) ) )
+        {
+            status = JsonStreamPartial;
+        }
+    }
+
+    return status;
+}
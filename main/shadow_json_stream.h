@@ -0,0 +1,175 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_json_stream.h
+ *
+ * @brief Incremental JSON tokenizer for documents that arrive in chunks.
+ *
+ * Unlike coreJSON, which needs the whole document in one buffer, the
+ * tokenizer keeps only the current key path and the current scalar token,
+ * so shadow documents larger than the MQTT network buffer can be processed
+ * as their payload is received. Each scalar value is reported together with
+ * its path in coreJSON query syntax, e.g. "state.desired.powerOn" or
+ * "list[2]".
+ */
+
+#ifndef SHADOW_JSON_STREAM_H_
+#define SHADOW_JSON_STREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* coreJSON header for the value types. */
+#include "core_json.h"
+
+/**
+ * @brief Maximum nesting depth of objects and arrays.
+ */
+#ifndef JSON_STREAM_MAX_DEPTH
+    #define JSON_STREAM_MAX_DEPTH           ( 8U )
+#endif
+
+/**
+ * @brief Maximum length of a key path, e.g. "state.desired.powerOn".
+ */
+#ifndef JSON_STREAM_MAX_PATH_LENGTH
+    #define JSON_STREAM_MAX_PATH_LENGTH     ( 128U )
+#endif
+
+/**
+ * @brief Maximum length of a single key or scalar value.
+ */
+#ifndef JSON_STREAM_MAX_TOKEN_LENGTH
+    #define JSON_STREAM_MAX_TOKEN_LENGTH    ( 64U )
+#endif
+
+/**
+ * @brief Return codes of the tokenizer.
+ */
+typedef enum JsonStreamStatus
+{
+    JsonStreamSuccess = 0,      /**< The data was consumed / the document is complete. */
+    JsonStreamPartial,          /**< The document ended before it was complete. */
+    JsonStreamIllegalDocument,  /**< The data is not valid JSON. */
+    JsonStreamMaxDepthExceeded, /**< Nesting is deeper than #JSON_STREAM_MAX_DEPTH. */
+    JsonStreamNullParameter     /**< A required parameter was NULL. */
+} JsonStreamStatus_t;
+
+/**
+ * @brief Callback invoked for every scalar value of the document.
+ *
+ * Values that do not fit #JSON_STREAM_MAX_TOKEN_LENGTH, or whose path does
+ * not fit #JSON_STREAM_MAX_PATH_LENGTH, are skipped. String values are
+ * reported without their quotes and with escapes left in place, like
+ * coreJSON does.
+ *
+ * @param[in] pPath Path of the value in coreJSON query syntax.
+ * @param[in] pathLength Length of @p pPath.
+ * @param[in] pValue The value.
+ * @param[in] valueLength Length of @p pValue.
+ * @param[in] valueType One of JSONString, JSONNumber, JSONTrue, JSONFalse
+ * or JSONNull.
+ * @param[in] pUserContext Context passed to #JsonStream_Init.
+ */
+typedef void ( * JsonStreamValueCallback_t )( const char * pPath,
+                                              size_t pathLength,
+                                              const char * pValue,
+                                              size_t valueLength,
+                                              JSONTypes_t valueType,
+                                              void * pUserContext );
+
+/**
+ * @brief One open object or array.
+ */
+typedef struct JsonStreamFrame
+{
+    size_t basePathLength; /**< @brief Length of the path of the container itself. */
+    uint32_t arrayIndex;   /**< @brief Index of the current element, for arrays. */
+    bool isArray;          /**< @brief Whether the container is an array. */
+    bool pathValid;        /**< @brief Whether the container's path fit the path buffer. */
+} JsonStreamFrame_t;
+
+/**
+ * @brief Tokenizer state. Treat as opaque.
+ */
+typedef struct JsonStreamParser
+{
+    JsonStreamValueCallback_t callback;
+    void * pUserContext;
+    JsonStreamFrame_t frames[ JSON_STREAM_MAX_DEPTH ];
+    size_t depth;
+    char path[ JSON_STREAM_MAX_PATH_LENGTH ];
+    size_t pathLength;
+    bool pathValid;
+    char token[ JSON_STREAM_MAX_TOKEN_LENGTH ];
+    size_t tokenLength;
+    bool tokenTruncated;
+    uint8_t expect;
+    uint8_t lexState;
+    uint8_t numberState;
+    uint8_t unicodeDigits;
+    JsonStreamStatus_t status;
+} JsonStreamParser_t;
+
+/**
+ * @brief Prepare a tokenizer for a new document.
+ *
+ * @param[out] pParser The tokenizer.
+ * @param[in] callback Callback for scalar values.
+ * @param[in] pUserContext Passed to @p callback unchanged.
+ *
+ * @return JsonStreamSuccess; JsonStreamNullParameter if @p pParser or
+ * @p callback is NULL.
+ */
+JsonStreamStatus_t JsonStream_Init( JsonStreamParser_t * pParser,
+                                    JsonStreamValueCallback_t callback,
+                                    void * pUserContext );
+
+/**
+ * @brief Feed the next chunk of the document.
+ *
+ * Chunks may split the document anywhere, including inside tokens. Once an
+ * error is returned, every following call returns the same error.
+ *
+ * @param[in] pParser The tokenizer.
+ * @param[in] pData The chunk.
+ * @param[in] length Length of @p pData.
+ *
+ * @return JsonStreamSuccess if the chunk was consumed; an error otherwise.
+ */
+JsonStreamStatus_t JsonStream_Feed( JsonStreamParser_t * pParser,
+                                    const char * pData,
+                                    size_t length );
+
+/**
+ * @brief Signal the end of the document.
+ *
+ * @param[in] pParser The tokenizer.
+ *
+ * @return JsonStreamSuccess if a complete document was fed;
+ * JsonStreamPartial if it was cut short; an earlier error otherwise.
+ */
+JsonStreamStatus_t JsonStream_Finish( JsonStreamParser_t * pParser );
+
+#endif /* ifndef SHADOW_JSON_STREAM_H_ */
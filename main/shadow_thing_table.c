@@ -0,0 +1,243 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_thing_table.c
+ *
+ * @brief Table of things served over one MQTT connection, with their shadow
+ * topics assembled once into a shared string pool.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+#include "shadow_thing_table.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Device Shadow library topic type of each #ShadowThingTopic_t.
+ */
+static const ShadowTopicStringType_t topicStringTypes[ ShadowThingTopicMax ] =
+{
+    ShadowTopicStringTypeDelete,
+    ShadowTopicStringTypeDeleteAccepted,
+    ShadowTopicStringTypeDeleteRejected,
+    ShadowTopicStringTypeUpdate,
+    ShadowTopicStringTypeUpdateAccepted,
+    ShadowTopicStringTypeUpdateRejected,
+    ShadowTopicStringTypeUpdateDelta
+};
+
+/*-----------------------------------------------------------*/
+
+ShadowThingTableStatus_t ShadowThingTable_Init( ShadowThingTable_t * pTable,
+                                                const char * pShadowName,
+                                                uint8_t shadowNameLength )
+{
+    ShadowThingTableStatus_t status = ShadowThingTableSuccess;
+
+    if( ( pTable == NULL ) || ( pShadowName == NULL ) )
+    {
+        status = ShadowThingTableBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pTable, 0x00, sizeof( ShadowThingTable_t ) );
+        pTable->pShadowName = pShadowName;
+        pTable->shadowNameLength = shadowNameLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowThingTableStatus_t ShadowThingTable_Add( ShadowThingTable_t * pTable,
+                                               const char * pThingName,
+                                               uint8_t thingNameLength,
+                                               size_t * pIndex )
+{
+    ShadowThingTableStatus_t status = ShadowThingTableSuccess;
+    ShadowStatus_t shadowStatus = SHADOW_SUCCESS;
+    ShadowThingEntry_t * pEntry = NULL;
+    size_t poolUsed = 0U;
+    uint16_t topicLength = 0U;
+    uint8_t topic = 0U;
+
+    if( ( pTable == NULL ) || ( pThingName == NULL ) || ( pIndex == NULL ) ||
+        ( thingNameLength == 0U ) || ( thingNameLength > SHADOW_THINGNAME_LENGTH_MAX ) )
+    {
+        status = ShadowThingTableBadParameter;
+    }
+    else if( pTable->thingCount >= SHADOW_THING_TABLE_MAX_THINGS )
+    {
+        status = ShadowThingTableFull;
+    }
+    else
+    {
+        pEntry = &pTable->things[ pTable->thingCount ];
+        poolUsed = pTable->poolUsed;
+
+        for( topic = 0U; ( topic < ( uint8_t ) ShadowThingTopicMax ) && ( status == ShadowThingTableSuccess ); topic++ )
+        {
+            /* Leave room for the terminator, and keep offsets in 16 bits. */
+            if( ( poolUsed + 1U ) >= SHADOW_THING_TABLE_POOL_SIZE )
+            {
+                status = ShadowThingTableFull;
+                continue;
+            }
+
+            shadowStatus = Shadow_AssembleTopicString( topicStringTypes[ topic ],
+                                                       pThingName,
+                                                       thingNameLength,
+                                                       pTable->pShadowName,
+                                                       pTable->shadowNameLength,
+                                                       &pTable->pool[ poolUsed ],
+                                                       ( uint16_t ) ( SHADOW_THING_TABLE_POOL_SIZE - poolUsed - 1U ),
+                                                       &topicLength );
+
+            if( shadowStatus == SHADOW_BUFFER_TOO_SMALL )
+            {
+                status = ShadowThingTableFull;
+            }
+            else if( shadowStatus != SHADOW_SUCCESS )
+            {
+                status = ShadowThingTableBadParameter;
+            }
+            else
+            {
+                pEntry->topicOffset[ topic ] = ( uint16_t ) poolUsed;
+                pEntry->topicLength[ topic ] = topicLength;
+                pTable->pool[ poolUsed + topicLength ] = '\0';
+                poolUsed += ( size_t ) topicLength + 1U;
+            }
+        }
+
+        if( status == ShadowThingTableSuccess )
+        {
+            /* Commit the thing only once all of its topics fit. */
+            pEntry->thingNameLength = thingNameLength;
+            pTable->poolUsed = poolUsed;
+            *pIndex = pTable->thingCount;
+            pTable->thingCount++;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowThingTableStatus_t ShadowThingTable_Find( const ShadowThingTable_t * pTable,
+                                                const char * pThingName,
+                                                uint8_t thingNameLength,
+                                                size_t * pIndex )
+{
+    ShadowThingTableStatus_t status = ShadowThingTableNotFound;
+    const char * pName = NULL;
+    uint8_t nameLength = 0U;
+    size_t index = 0U;
+
+    if( ( pTable == NULL ) || ( pThingName == NULL ) || ( pIndex == NULL ) )
+    {
+        status = ShadowThingTableBadParameter;
+    }
+    else
+    {
+        for( index = 0U; index < pTable->thingCount; index++ )
+        {
+            ( void ) ShadowThingTable_GetThingName( pTable, index, &pName, &nameLength );
+
+            if( ( nameLength == thingNameLength ) &&
+                ( memcmp( pName, pThingName, thingNameLength ) == 0 ) )
+            {
+                *pIndex = index;
+                status = ShadowThingTableSuccess;
+                break;
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowThingTableStatus_t ShadowThingTable_GetTopic( const ShadowThingTable_t * pTable,
+                                                    size_t index,
+                                                    ShadowThingTopic_t topic,
+                                                    const char ** ppTopic,
+                                                    uint16_t * pTopicLength )
+{
+    ShadowThingTableStatus_t status = ShadowThingTableSuccess;
+
+    if( ( pTable == NULL ) || ( ppTopic == NULL ) || ( pTopicLength == NULL ) ||
+        ( index >= pTable->thingCount ) || ( topic >= ShadowThingTopicMax ) )
+    {
+        status = ShadowThingTableBadParameter;
+    }
+    else
+    {
+        *ppTopic = &pTable->pool[ pTable->things[ index ].topicOffset[ topic ] ];
+        *pTopicLength = pTable->things[ index ].topicLength[ topic ];
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+ShadowThingTableStatus_t ShadowThingTable_GetThingName( const ShadowThingTable_t * pTable,
+                                                        size_t index,
+                                                        const char ** ppThingName,
+                                                        uint8_t * pThingNameLength )
+{
+    ShadowThingTableStatus_t status = ShadowThingTableSuccess;
+
+    if( ( pTable == NULL ) || ( ppThingName == NULL ) || ( pThingNameLength == NULL ) ||
+        ( index >= pTable->thingCount ) )
+    {
+        status = ShadowThingTableBadParameter;
+    }
+    else
+    {
+        /* Every topic starts with "$aws/things/<thingName>/", so the name is
+         * not stored separately. */
+        *ppThingName = &pTable->pool[ pTable->things[ index ].topicOffset[ 0 ] + SHADOW_PREFIX_LENGTH ];
+        *pThingNameLength = pTable->things[ index ].thingNameLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t ShadowThingTable_Count( const ShadowThingTable_t * pTable )
+{
+    assert( pTable != NULL );
+
+    return pTable->thingCount;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,211 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file shadow_thing_table.h
+ *
+ * @brief Table of the things whose shadows are served over one MQTT
+ * connection.
+ *
+ * Thing names are given at run time. When a thing is added, every shadow
+ * topic the demo uses for it is assembled once with
+ * #Shadow_AssembleTopicString into a shared string pool, so topics are not
+ * rebuilt for every publish or subscribe and each thing costs only its topic
+ * strings and a few offsets.
+ */
+
+#ifndef SHADOW_THING_TABLE_H_
+#define SHADOW_THING_TABLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* SHADOW API header. */
+#include "shadow.h"
+
+/* Demo configuration. It sets the sizes below from menuconfig, so every file
+ * including this header agrees on the layout of #ShadowThingTable_t. */
+#include "demo_config.h"
+
+/**
+ * @brief Maximum number of things in a table.
+ */
+#ifndef SHADOW_THING_TABLE_MAX_THINGS
+    #define SHADOW_THING_TABLE_MAX_THINGS    ( 8U )
+#endif
+
+/**
+ * @brief Size of the string pool holding the topics of all things.
+ */
+#ifndef SHADOW_THING_TABLE_POOL_SIZE
+    #define SHADOW_THING_TABLE_POOL_SIZE     ( 2048U )
+#endif
+
+/**
+ * @brief Return codes of the table functions.
+ */
+typedef enum ShadowThingTableStatus
+{
+    ShadowThingTableSuccess = 0,    /**< The operation succeeded. */
+    ShadowThingTableBadParameter,   /**< A parameter was NULL or out of range. */
+    ShadowThingTableFull,           /**< No room for another thing or its topics. */
+    ShadowThingTableNotFound        /**< No thing with the given name. */
+} ShadowThingTableStatus_t;
+
+/**
+ * @brief Shadow topics kept for every thing.
+ */
+typedef enum ShadowThingTopic
+{
+    ShadowThingTopicDelete = 0,     /**< "delete" */
+    ShadowThingTopicDeleteAccepted, /**< "delete/accepted" */
+    ShadowThingTopicDeleteRejected, /**< "delete/rejected" */
+    ShadowThingTopicUpdate,         /**< "update" */
+    ShadowThingTopicUpdateAccepted, /**< "update/accepted" */
+    ShadowThingTopicUpdateRejected, /**< "update/rejected" */
+    ShadowThingTopicUpdateDelta,    /**< "update/delta" */
+    ShadowThingTopicMax             /**< Number of topics. */
+} ShadowThingTopic_t;
+
+/**
+ * @brief Interned topics of one thing.
+ */
+typedef struct ShadowThingEntry
+{
+    uint16_t topicOffset[ ShadowThingTopicMax ]; /**< @brief Offsets of the topics in the pool. */
+    uint16_t topicLength[ ShadowThingTopicMax ]; /**< @brief Lengths of the topics. */
+    uint8_t thingNameLength;                     /**< @brief Length of the thing name. */
+} ShadowThingEntry_t;
+
+/**
+ * @brief Table state. Treat as opaque.
+ */
+typedef struct ShadowThingTable
+{
+    const char * pShadowName;
+    uint8_t shadowNameLength;
+    ShadowThingEntry_t things[ SHADOW_THING_TABLE_MAX_THINGS ];
+    size_t thingCount;
+    char pool[ SHADOW_THING_TABLE_POOL_SIZE ];
+    size_t poolUsed;
+} ShadowThingTable_t;
+
+/**
+ * @brief Prepare an empty table.
+ *
+ * @param[out] pTable The table.
+ * @param[in] pShadowName Name of the shadow of every thing, or
+ * SHADOW_NAME_CLASSIC. Not copied.
+ * @param[in] shadowNameLength Length of @p pShadowName.
+ *
+ * @return ShadowThingTableSuccess; ShadowThingTableBadParameter if a pointer
+ * is NULL.
+ */
+ShadowThingTableStatus_t ShadowThingTable_Init( ShadowThingTable_t * pTable,
+                                                const char * pShadowName,
+                                                uint8_t shadowNameLength );
+
+/**
+ * @brief Add a thing and assemble its topics.
+ *
+ * The name is copied into the pool, so it need not outlive the call.
+ *
+ * @param[in] pTable The table.
+ * @param[in] pThingName Name of the thing.
+ * @param[in] thingNameLength Length of @p pThingName.
+ * @param[out] pIndex Index of the thing in the table.
+ *
+ * @return ShadowThingTableSuccess; ShadowThingTableFull if the table or its
+ * pool is full; ShadowThingTableBadParameter if the name is empty, too long
+ * or rejected by the Device Shadow library.
+ */
+ShadowThingTableStatus_t ShadowThingTable_Add( ShadowThingTable_t * pTable,
+                                               const char * pThingName,
+                                               uint8_t thingNameLength,
+                                               size_t * pIndex );
+
+/**
+ * @brief Look up a thing by name, e.g. the name parsed from an incoming
+ * topic by #Shadow_MatchTopicString.
+ *
+ * @param[in] pTable The table.
+ * @param[in] pThingName Name of the thing.
+ * @param[in] thingNameLength Length of @p pThingName.
+ * @param[out] pIndex Index of the thing in the table.
+ *
+ * @return ShadowThingTableSuccess; ShadowThingTableNotFound if no thing has
+ * that name.
+ */
+ShadowThingTableStatus_t ShadowThingTable_Find( const ShadowThingTable_t * pTable,
+                                                const char * pThingName,
+                                                uint8_t thingNameLength,
+                                                size_t * pIndex );
+
+/**
+ * @brief Get an interned topic of a thing.
+ *
+ * The topic is NUL-terminated and stays valid for the lifetime of the table.
+ *
+ * @param[in] pTable The table.
+ * @param[in] index Index of the thing.
+ * @param[in] topic Which topic.
+ * @param[out] ppTopic The topic.
+ * @param[out] pTopicLength Length of the topic.
+ *
+ * @return ShadowThingTableSuccess; ShadowThingTableBadParameter if @p index
+ * or @p topic is out of range.
+ */
+ShadowThingTableStatus_t ShadowThingTable_GetTopic( const ShadowThingTable_t * pTable,
+                                                    size_t index,
+                                                    ShadowThingTopic_t topic,
+                                                    const char ** ppTopic,
+                                                    uint16_t * pTopicLength );
+
+/**
+ * @brief Get the name of a thing.
+ *
+ * The name is not NUL-terminated.
+ *
+ * @param[in] pTable The table.
+ * @param[in] index Index of the thing.
+ * @param[out] ppThingName The name.
+ * @param[out] pThingNameLength Length of the name.
+ *
+ * @return ShadowThingTableSuccess; ShadowThingTableBadParameter if @p index
+ * is out of range.
+ */
+ShadowThingTableStatus_t ShadowThingTable_GetThingName( const ShadowThingTable_t * pTable,
+                                                        size_t index,
+                                                        const char ** ppThingName,
+                                                        uint8_t * pThingNameLength );
+
+/**
+ * @brief Number of things in the table.
+ *
+ * @param[in] pTable The table.
+ *
+ * @return The number of things.
+ */
+size_t ShadowThingTable_Count( const ShadowThingTable_t * pTable );
+
+#endif /* ifndef SHADOW_THING_TABLE_H_ */
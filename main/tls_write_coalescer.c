@@ -0,0 +1,196 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tls_write_coalescer.c
+ *
+ * @brief Batching of small writes into one TLS record.
+ */
+
+/* Standard includes. */
+#include <assert.h>
+#include <string.h>
+
+/* Clock for the coalescing window. */
+#include "clock.h"
+
+#include "tls_write_coalescer.h"
+
+/**
+ * @brief Longest time a flush keeps retrying a transport that accepts no
+ * bytes.
+ */
+#define TLS_WRITE_COALESCER_FLUSH_TIMEOUT_MS    ( 5000U )
+
+/**
+ * @brief Delay before retrying a transport that accepted no bytes.
+ */
+#define TLS_WRITE_COALESCER_RETRY_DELAY_MS      ( 10U )
+
+/*-----------------------------------------------------------*/
+
+void TlsWriteCoalescer_Init( TlsWriteCoalescer_t * pCoalescer,
+                             NetworkContext_t * pNetworkContext,
+                             TlsWriteCoalescerSend_t send,
+                             uint8_t * pBuffer,
+                             size_t bufferSize,
+                             uint32_t windowMs )
+{
+    assert( pCoalescer != NULL );
+    assert( send != NULL );
+    assert( ( pBuffer != NULL ) && ( bufferSize > 0U ) );
+
+    pCoalescer->pNetworkContext = pNetworkContext;
+    pCoalescer->send = send;
+    pCoalescer->pBuffer = pBuffer;
+    pCoalescer->bufferSize = bufferSize;
+    pCoalescer->pendingLength = 0U;
+    pCoalescer->windowMs = windowMs;
+    pCoalescer->firstPendingTimeMs = 0U;
+    pCoalescer->failed = false;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t TlsWriteCoalescer_Send( TlsWriteCoalescer_t * pCoalescer,
+                                const void * pBuffer,
+                                size_t bytesToSend )
+{
+    int32_t result = 0;
+    size_t freeSpace = 0U;
+    size_t taken = 0U;
+
+    assert( pCoalescer != NULL );
+    assert( ( pBuffer != NULL ) || ( bytesToSend == 0U ) );
+
+    if( TlsWriteCoalescer_FlushIfDue( pCoalescer ) != TlsWriteCoalescerSuccess )
+    {
+        result = -1;
+    }
+    else if( ( pCoalescer->pendingLength == 0U ) && ( bytesToSend >= pCoalescer->bufferSize ) )
+    {
+        /* Copying would only split the write into more records. */
+        result = pCoalescer->send( pCoalescer->pNetworkContext, pBuffer, bytesToSend );
+        pCoalescer->failed = ( result < 0 );
+    }
+    else
+    {
+        freeSpace = pCoalescer->bufferSize - pCoalescer->pendingLength;
+        taken = ( bytesToSend < freeSpace ) ? bytesToSend : freeSpace;
+
+        if( ( pCoalescer->pendingLength == 0U ) && ( taken > 0U ) )
+        {
+            pCoalescer->firstPendingTimeMs = Clock_GetTimeMs();
+        }
+
+        ( void ) memcpy( &pCoalescer->pBuffer[ pCoalescer->pendingLength ], pBuffer, taken );
+        pCoalescer->pendingLength += taken;
+
+        if( ( pCoalescer->pendingLength == pCoalescer->bufferSize ) &&
+            ( TlsWriteCoalescer_Flush( pCoalescer ) != TlsWriteCoalescerSuccess ) )
+        {
+            result = -1;
+        }
+        else
+        {
+            result = ( int32_t ) taken;
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+TlsWriteCoalescerStatus_t TlsWriteCoalescer_Flush( TlsWriteCoalescer_t * pCoalescer )
+{
+    size_t sentLength = 0U;
+    int32_t bytesSent = 0;
+    uint32_t lastProgressTimeMs = 0U;
+
+    assert( pCoalescer != NULL );
+
+    lastProgressTimeMs = Clock_GetTimeMs();
+
+    while( ( pCoalescer->failed == false ) && ( sentLength < pCoalescer->pendingLength ) )
+    {
+        bytesSent = pCoalescer->send( pCoalescer->pNetworkContext,
+                                      &pCoalescer->pBuffer[ sentLength ],
+                                      pCoalescer->pendingLength - sentLength );
+
+        if( bytesSent > 0 )
+        {
+            sentLength += ( size_t ) bytesSent;
+            lastProgressTimeMs = Clock_GetTimeMs();
+        }
+        else if( ( bytesSent < 0 ) ||
+                 ( ( Clock_GetTimeMs() - lastProgressTimeMs ) > TLS_WRITE_COALESCER_FLUSH_TIMEOUT_MS ) )
+        {
+            pCoalescer->failed = true;
+        }
+        else
+        {
+            /* The transport is congested. Try again. */
+            Clock_SleepMs( TLS_WRITE_COALESCER_RETRY_DELAY_MS );
+        }
+    }
+
+    pCoalescer->pendingLength = 0U;
+
+    return ( pCoalescer->failed == true ) ? TlsWriteCoalescerSendFailed : TlsWriteCoalescerSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+TlsWriteCoalescerStatus_t TlsWriteCoalescer_FlushIfDue( TlsWriteCoalescer_t * pCoalescer )
+{
+    TlsWriteCoalescerStatus_t status = TlsWriteCoalescerSuccess;
+
+    assert( pCoalescer != NULL );
+
+    if( pCoalescer->failed == true )
+    {
+        status = TlsWriteCoalescerSendFailed;
+    }
+    else if( ( pCoalescer->pendingLength > 0U ) &&
+             ( ( Clock_GetTimeMs() - pCoalescer->firstPendingTimeMs ) >= pCoalescer->windowMs ) )
+    {
+        status = TlsWriteCoalescer_Flush( pCoalescer );
+    }
+    else
+    {
+        /* Nothing is due. */
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool TlsWriteCoalescer_HasPending( const TlsWriteCoalescer_t * pCoalescer )
+{
+    assert( pCoalescer != NULL );
+
+    return( pCoalescer->pendingLength > 0U );
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,146 @@
+/*
+ * AWS IoT Device SDK for Embedded C 202103.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tls_write_coalescer.h
+ *
+ * @brief Batching of small writes into one TLS record.
+ *
+ * Every call to the TLS send function produces at least one TLS record,
+ * with its header, MAC and padding, and one TCP segment. coreMQTT sends a
+ * PUBLISH as separate header, topic and payload writes, and PUBACKs and
+ * PINGREQs are a few bytes each. The coalescer copies writes into a buffer
+ * and sends the buffer as one record when it is full, when its oldest
+ * byte is older than the coalescing window, or when flushed explicitly.
+ * Writes larger than the buffer are passed through.
+ *
+ * Once a flush fails, every later write fails as well, so that the error
+ * reaches coreMQTT although the bytes were accepted earlier.
+ */
+
+#ifndef TLS_WRITE_COALESCER_H_
+#define TLS_WRITE_COALESCER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Transport interface include. */
+#include "network_transport.h"
+
+/**
+ * @brief Return codes of #TlsWriteCoalescer_Flush.
+ */
+typedef enum TlsWriteCoalescerStatus
+{
+    TlsWriteCoalescerSuccess = 0, /**< Nothing is pending. */
+    TlsWriteCoalescerSendFailed   /**< The transport failed or timed out. */
+} TlsWriteCoalescerStatus_t;
+
+/**
+ * @brief Function sending bytes over the transport, like
+ * #espTlsTransportSend.
+ */
+typedef int32_t ( * TlsWriteCoalescerSend_t )( NetworkContext_t * pNetworkContext,
+                                                const void * pBuffer,
+                                                size_t bytesToSend );
+
+/**
+ * @brief Coalescer state. Treat as opaque.
+ */
+typedef struct TlsWriteCoalescer
+{
+    NetworkContext_t * pNetworkContext;
+    TlsWriteCoalescerSend_t send;
+    uint8_t * pBuffer;
+    size_t bufferSize;
+    size_t pendingLength;
+    uint32_t windowMs;
+    uint32_t firstPendingTimeMs;
+    bool failed;
+} TlsWriteCoalescer_t;
+
+/**
+ * @brief Prepare the coalescer for a new connection.
+ *
+ * @param[out] pCoalescer The coalescer.
+ * @param[in] pNetworkContext The connection.
+ * @param[in] send Function sending over @p pNetworkContext.
+ * @param[in] pBuffer Buffer for pending writes. It must outlive the
+ * connection.
+ * @param[in] bufferSize Size of @p pBuffer.
+ * @param[in] windowMs Longest time a write may be held back.
+ */
+void TlsWriteCoalescer_Init( TlsWriteCoalescer_t * pCoalescer,
+                             NetworkContext_t * pNetworkContext,
+                             TlsWriteCoalescerSend_t send,
+                             uint8_t * pBuffer,
+                             size_t bufferSize,
+                             uint32_t windowMs );
+
+/**
+ * @brief Send bytes, holding them back if they fit the buffer.
+ *
+ * Has the signature of TransportSend_t. A write that does not fit the rest
+ * of the buffer fills it, and only the bytes taken are reported, so that
+ * coreMQTT sends the remainder with another call.
+ *
+ * @param[in] pCoalescer The coalescer.
+ * @param[in] pBuffer Bytes to send.
+ * @param[in] bytesToSend Number of bytes.
+ *
+ * @return The number of bytes taken; a negative value once sending failed.
+ */
+int32_t TlsWriteCoalescer_Send( TlsWriteCoalescer_t * pCoalescer,
+                                const void * pBuffer,
+                                size_t bytesToSend );
+
+/**
+ * @brief Send the pending bytes now.
+ *
+ * @param[in] pCoalescer The coalescer.
+ *
+ * @return TlsWriteCoalescerSuccess; TlsWriteCoalescerSendFailed if this or
+ * an earlier flush failed.
+ */
+TlsWriteCoalescerStatus_t TlsWriteCoalescer_Flush( TlsWriteCoalescer_t * pCoalescer );
+
+/**
+ * @brief Send the pending bytes if the oldest of them was held back for
+ * the whole coalescing window.
+ *
+ * @param[in] pCoalescer The coalescer.
+ *
+ * @return As #TlsWriteCoalescer_Flush.
+ */
+TlsWriteCoalescerStatus_t TlsWriteCoalescer_FlushIfDue( TlsWriteCoalescer_t * pCoalescer );
+
+/**
+ * @brief Whether bytes are held back.
+ *
+ * @param[in] pCoalescer The coalescer.
+ *
+ * @return true if a flush would send anything.
+ */
+bool TlsWriteCoalescer_HasPending( const TlsWriteCoalescer_t * pCoalescer );
+
+#endif /* ifndef TLS_WRITE_COALESCER_H_ */
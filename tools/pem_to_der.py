@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+#
+# Convert a PEM credential to DER for embedding into the firmware.
+#
+# A file holding exactly one unencrypted PEM block is written as DER, which
+# the TLS stack parses without decoding base64 first. Anything else, such as
+# a chain of CA certificates or an encrypted key, is copied as PEM with a NUL
+# terminator appended, as mbedTLS requires for PEM input. A file that is
+# already DER is copied unchanged.
+#
+# Usage: pem_to_der.py <input> <output>
+
+import base64
+import re
+import sys
+
+PEM_BLOCK = re.compile(rb'-----BEGIN ([A-Z0-9 ]+)-----\s*(.*?)-----END \1-----', re.DOTALL)
+
+
+def convert(data):
+    blocks = PEM_BLOCK.findall(data)
+
+    if not blocks:
+        # Not PEM, assume DER.
+        return data
+
+    if len(blocks) == 1 and b':' not in blocks[0][1]:
+        # Headers such as "Proc-Type: 4,ENCRYPTED" mark an encrypted key.
+        return base64.b64decode(b''.join(blocks[0][1].split()))
+
+    return data.rstrip(b'\0') + b'\0'
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('Usage: {} <input> <output>'.format(sys.argv[0]), file=sys.stderr)
+        return 1
+
+    with open(sys.argv[1], 'rb') as input_file:
+        data = input_file.read()
+
+    with open(sys.argv[2], 'wb') as output_file:
+        output_file.write(convert(data))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())